@@ -0,0 +1,251 @@
+#ifndef BLOCK_TIMESTEP_H
+#define BLOCK_TIMESTEP_H
+
+#include "nbody.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical power-of-two block timesteps with kick-drift-kick updates.
+// A body on rung r advances with dtMax / 2^r. Time is counted in integer ticks of
+// the finest rung so synchronisation is exact. The packed state is kept sorted by
+// rung (finest first): whenever rung r is due, every finer rung is due too, so the
+// active set is always a contiguous prefix and goes straight to the force backend
+// as its target range.
+template <class Force>
+class BlockTimestepIntegrator {
+public:
+    double dtMax = 1e-2; // Step of rung 0
+    int maxRung = 20;    // Finest rung, dtMax / 2^maxRung
+    double eta = 0.02;   // Accuracy parameter in dt = eta * |a| / |da/dt|
+
+    long long forceTargetEvaluations = 0; // Bodies whose acceleration was recomputed
+    long long fullEvaluationEquivalent = 0; // Same count if everyone sat on the finest occupied rung
+
+    // Advance by a number of whole rung-0 steps; all bodies are synchronised at the end
+    void integrate(BodySystem& s, const Force& force, int blocks) {
+        if (s.size() == 0 || blocks <= 0) {
+            return;
+        }
+        gather(s);
+        const std::uint64_t ticksPerBlock = std::uint64_t(1) << maxRung;
+        const std::uint64_t end = ticksPerBlock * std::uint64_t(blocks);
+
+        // Start: forces on everyone, initial rungs from a short probe, then opening kicks
+        evaluate(force, n);
+        assignInitialRungs(force);
+        sortPrefix(n);
+        halfKick(n);
+
+        std::uint64_t tick = 0;
+        while (tick < end) {
+            std::uint64_t step = ticksForRung(rung[0]);
+            drift(step);
+            tick += step;
+
+            const size_t nActive = activeCount(syncRung(tick));
+            for (size_t i = 0; i < nActive; ++i) {
+                prevAx[i] = ax[i]; prevAy[i] = ay[i]; prevAz[i] = az[i];
+            }
+            evaluate(force, nActive);
+            forceTargetEvaluations += nActive;
+            fullEvaluationEquivalent += n;
+            halfKick(nActive);
+            if (tick == end) {
+                break;
+            }
+            if (updateRungs(nActive, syncRung(tick))) {
+                sortPrefix(nActive);
+            }
+            halfKick(nActive);
+        }
+
+        scatter(s);
+        s.time += dtMax * blocks;
+        s.accelerationsValid = false;
+    }
+
+    // Rung currently assigned to a body, indexed as in the BodySystem
+    int rungOf(size_t body) const {
+        for (size_t i = 0; i < n; ++i) {
+            if (index[i] == body) {
+                return rung[i];
+            }
+        }
+        return -1;
+    }
+
+private:
+    size_t n = 0;
+    std::vector<double> x, y, z, vx, vy, vz, ax, ay, az, m;
+    std::vector<double> prevAx, prevAy, prevAz;
+    std::vector<int> rung;
+    std::vector<size_t> index; // Packed slot -> body index
+    // Scratch used when reordering the active prefix
+    std::vector<size_t> perm;
+    std::vector<double> scratch;
+    std::vector<int> scratchRung;
+    std::vector<size_t> scratchIndex;
+    std::vector<size_t> rungCount;
+
+    std::uint64_t ticksForRung(int r) const { return std::uint64_t(1) << (maxRung - r); }
+
+    // Coarsest rung whose steps end on this tick
+    int syncRung(std::uint64_t tick) const {
+        int r = maxRung;
+        while (r > 0 && tick % ticksForRung(r - 1) == 0) {
+            --r;
+        }
+        return r;
+    }
+
+    // Number of leading bodies on rung >= r
+    size_t activeCount(int r) const {
+        size_t k = 0;
+        while (k < n && rung[k] >= r) {
+            ++k;
+        }
+        return k;
+    }
+
+    double stepForRung(int r) const { return dtMax / double(std::uint64_t(1) << r); }
+
+    // Smallest rung whose step satisfies dt <= dtWanted
+    int rungForStep(double dtWanted) const {
+        if (!(dtWanted > 0.0)) {
+            return maxRung;
+        }
+        int r = 0;
+        double h = dtMax;
+        while (r < maxRung && h > dtWanted) {
+            h *= 0.5;
+            ++r;
+        }
+        return r;
+    }
+
+    void gather(const BodySystem& s) {
+        n = s.size();
+        x = s.x; y = s.y; z = s.z;
+        vx = s.vx; vy = s.vy; vz = s.vz;
+        m = s.mass;
+        ax.resize(n); ay.resize(n); az.resize(n);
+        prevAx.resize(n); prevAy.resize(n); prevAz.resize(n);
+        rung.assign(n, 0);
+        index.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            index[i] = i;
+        }
+        perm.resize(n);
+        scratch.resize(n);
+        scratchRung.resize(n);
+        scratchIndex.resize(n);
+        rungCount.resize(maxRung + 2);
+    }
+
+    void scatter(BodySystem& s) const {
+        for (size_t i = 0; i < n; ++i) {
+            const size_t dst = index[i];
+            s.x[dst] = x[i]; s.y[dst] = y[i]; s.z[dst] = z[i];
+            s.vx[dst] = vx[i]; s.vy[dst] = vy[i]; s.vz[dst] = vz[i];
+            s.ax[dst] = ax[i]; s.ay[dst] = ay[i]; s.az[dst] = az[i];
+        }
+    }
+
+    void evaluate(const Force& force, size_t nTargets) {
+        force(nTargets, n, x.data(), y.data(), z.data(), m.data(), ax.data(), ay.data(), az.data());
+    }
+
+    double wantedStep(size_t i, double da, double interval) const {
+        double a = std::sqrt(ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i]);
+        if (da <= 0.0) {
+            return dtMax;
+        }
+        return eta * a * interval / da;
+    }
+
+    // Estimate the jerk from the acceleration change along a short straight-line probe
+    void assignInitialRungs(const Force& force) {
+        const double probe = stepForRung(maxRung);
+        prevAx = ax; prevAy = ay; prevAz = az;
+        for (size_t i = 0; i < n; ++i) {
+            x[i] += probe * vx[i]; y[i] += probe * vy[i]; z[i] += probe * vz[i];
+        }
+        evaluate(force, n);
+        for (size_t i = 0; i < n; ++i) {
+            x[i] -= probe * vx[i]; y[i] -= probe * vy[i]; z[i] -= probe * vz[i];
+            double dx = ax[i] - prevAx[i], dy = ay[i] - prevAy[i], dz = az[i] - prevAz[i];
+            ax[i] = prevAx[i]; ay[i] = prevAy[i]; az[i] = prevAz[i];
+            rung[i] = rungForStep(wantedStep(i, std::sqrt(dx * dx + dy * dy + dz * dz), probe));
+        }
+    }
+
+    // New rungs for the active prefix; bodies may refine freely but only coarsen one
+    // rung at a time and only onto rungs that are synchronised now. Returns true if any changed.
+    bool updateRungs(size_t nActive, int sync) {
+        bool changed = false;
+        for (size_t i = 0; i < nActive; ++i) {
+            double dx = ax[i] - prevAx[i], dy = ay[i] - prevAy[i], dz = az[i] - prevAz[i];
+            int wanted = rungForStep(wantedStep(i, std::sqrt(dx * dx + dy * dy + dz * dz), stepForRung(rung[i])));
+            int r = wanted;
+            if (r < rung[i] - 1) {
+                r = rung[i] - 1;
+            }
+            if (r < sync) {
+                r = sync;
+            }
+            if (r != rung[i]) {
+                rung[i] = r;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    template <class T>
+    void permute(std::vector<T>& v, std::vector<T>& tmp, size_t count) {
+        for (size_t k = 0; k < count; ++k) {
+            tmp[k] = v[perm[k]];
+        }
+        for (size_t k = 0; k < count; ++k) {
+            v[k] = tmp[k];
+        }
+    }
+
+    // Stable counting sort of the first count slots by descending rung
+    void sortPrefix(size_t count) {
+        std::fill(rungCount.begin(), rungCount.end(), 0);
+        for (size_t i = 0; i < count; ++i) {
+            ++rungCount[maxRung - rung[i] + 1];
+        }
+        for (int r = 1; r <= maxRung + 1; ++r) {
+            rungCount[r] += rungCount[r - 1];
+        }
+        for (size_t i = 0; i < count; ++i) {
+            perm[rungCount[maxRung - rung[i]]++] = i;
+        }
+        permute(x, scratch, count); permute(y, scratch, count); permute(z, scratch, count);
+        permute(vx, scratch, count); permute(vy, scratch, count); permute(vz, scratch, count);
+        permute(ax, scratch, count); permute(ay, scratch, count); permute(az, scratch, count);
+        permute(m, scratch, count);
+        permute(rung, scratchRung, count);
+        permute(index, scratchIndex, count);
+    }
+
+    // Half kick of the active prefix over each body's own step
+    void halfKick(size_t nActive) {
+        for (size_t i = 0; i < nActive; ++i) {
+            const double h = 0.5 * stepForRung(rung[i]);
+            vx[i] += h * ax[i]; vy[i] += h * ay[i]; vz[i] += h * az[i];
+        }
+    }
+
+    void drift(std::uint64_t ticks) {
+        const double h = stepForRung(maxRung) * double(ticks);
+        for (size_t i = 0; i < n; ++i) {
+            x[i] += h * vx[i]; y[i] += h * vy[i]; z[i] += h * vz[i];
+        }
+    }
+};
+
+#endif
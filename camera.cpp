@@ -0,0 +1,28 @@
+#include "camera.h"
+#include "glm/glm/gtc/matrix_transform.hpp"
+#include <algorithm>
+#include <cmath>
+
+glm::dvec3 Camera::position() const {
+    glm::dvec3 offset(std::cos(pitch) * std::sin(yaw), std::sin(pitch), std::cos(pitch) * std::cos(yaw));
+    return target + distance * offset;
+}
+
+glm::dmat4 Camera::viewRotation() const {
+    glm::dvec3 forward = target - position();
+    return glm::lookAt(glm::dvec3(0.0), forward, glm::dvec3(0.0, 1.0, 0.0));
+}
+
+void Camera::zoom(double steps) {
+    distance = std::min(std::max(distance * std::pow(1.1, -steps), minDistance), maxDistance);
+}
+
+void Camera::orbit(double dYaw, double dPitch) {
+    yaw += dYaw;
+    pitch = std::min(std::max(pitch + dPitch, -1.5), 1.5);
+}
+
+glm::mat4 cameraRelativeModelView(const Camera& camera, const glm::dvec3& worldPosition, const glm::dmat4& local) {
+    glm::dmat4 translation = glm::translate(glm::dmat4(1.0), worldPosition - camera.position());
+    return glm::mat4(camera.viewRotation() * translation * local);
+}
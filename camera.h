@@ -0,0 +1,35 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include "glm/glm/glm.hpp"
+
+// Orbiting camera kept in double precision. World positions are kilometres in the
+// scene frame (y toward the north pole), centred on the Earth.
+//
+// Float matrices cannot hold both a planet-sized offset and metre-sized detail, so
+// nothing is ever built in absolute float coordinates: each object's model-view is
+// composed in double with its translation taken relative to the camera, and only
+// the final matrix is rounded to float. Offsets near the camera are then small and
+// precise, and distant objects only lose precision far below a pixel.
+struct Camera {
+    glm::dvec3 target = glm::dvec3(0.0); // Point the camera orbits
+    double distance = 30000.0;           // km from the target
+    double yaw = 0.0;                    // Radians about the y axis
+    double pitch = 0.3;                  // Radians above the equator
+    double minDistance = 6500.0;
+    double maxDistance = 1.0e10;         // Beyond Neptune
+
+    glm::dvec3 position() const;
+    // View rotation without translation; translation is applied per object
+    glm::dmat4 viewRotation() const;
+
+    // Multiplicative zoom so every scale takes the same number of steps
+    void zoom(double steps);
+    void orbit(double dYaw, double dPitch);
+};
+
+// Model-view of an object at worldPosition with local rotation and scale, composed in
+// double relative to the camera and then converted to float for the GPU
+glm::mat4 cameraRelativeModelView(const Camera& camera, const glm::dvec3& worldPosition, const glm::dmat4& local);
+
+#endif
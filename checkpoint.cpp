@@ -0,0 +1,248 @@
+#include "checkpoint.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char checkpointMagic[8] = {'N', 'B', 'O', 'D', 'Y', 'C', 'K', 'P'};
+static const size_t checkpointAlignment = 64;
+
+static size_t alignUp(size_t offset) {
+    return (offset + checkpointAlignment - 1) / checkpointAlignment * checkpointAlignment;
+}
+
+static std::uint64_t fnv1a(const unsigned char* p, size_t count, std::uint64_t hash = 1469598103934665603ull) {
+    for (size_t i = 0; i < count; ++i) {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Lay out the image and copy every section into it. The header is complete except for
+// the checksum, which sealCheckpoint() adds.
+static std::vector<unsigned char> copyCheckpoint(const BodySystem& s, std::uint32_t integratorKind,
+                                                 const std::vector<double>& integratorState, const std::string& rngState) {
+    const size_t n = s.size();
+    const std::vector<double>* arrays[] = {&s.x, &s.y, &s.z, &s.vx, &s.vy, &s.vz, &s.ax, &s.ay, &s.az, &s.mass};
+    const void* sources[CheckpointSectionCount];
+    size_t sizes[CheckpointSectionCount];
+    for (int k = 0; k < CheckpointIntegratorState; ++k) {
+        sources[k] = arrays[k]->data();
+        sizes[k] = n * sizeof(double);
+    }
+    sources[CheckpointIntegratorState] = integratorState.data();
+    sizes[CheckpointIntegratorState] = integratorState.size() * sizeof(double);
+    sources[CheckpointRngState] = rngState.data();
+    sizes[CheckpointRngState] = rngState.size();
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.version = checkpointVersion;
+    header.headerBytes = sizeof(CheckpointHeader);
+    header.byteOrderMark = checkpointByteOrderMark;
+    header.flags = s.accelerationsValid ? CheckpointAccelerationsValid : 0;
+    header.bodyCount = n;
+    header.time = s.time;
+    header.integratorKind = integratorKind;
+    header.sectionCount = CheckpointSectionCount;
+    size_t offset = alignUp(sizeof(CheckpointHeader));
+    for (int k = 0; k < CheckpointSectionCount; ++k) {
+        header.sectionOffset[k] = offset;
+        header.sectionBytes[k] = sizes[k];
+        offset = alignUp(offset + sizes[k]);
+    }
+    header.fileBytes = offset;
+
+    // Zero-filled, so the padding between sections is deterministic
+    std::vector<unsigned char> image(offset, 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    for (int k = 0; k < CheckpointSectionCount; ++k) {
+        if (sizes[k] > 0) {
+            std::memcpy(image.data() + header.sectionOffset[k], sources[k], sizes[k]);
+        }
+    }
+    return image;
+}
+
+// Checksum of a whole image, reading the checksum field as zero so that the header is
+// covered too
+static std::uint64_t checkpointChecksum(const unsigned char* image, size_t bytes) {
+    const size_t field = offsetof(CheckpointHeader, checksum);
+    const unsigned char zero[sizeof(std::uint64_t)] = {};
+    std::uint64_t hash = fnv1a(image, field);
+    hash = fnv1a(zero, sizeof(zero), hash);
+    return fnv1a(image + field + sizeof(zero), bytes - field - sizeof(zero), hash);
+}
+
+static void sealCheckpoint(std::vector<unsigned char>& image) {
+    const std::uint64_t checksum = checkpointChecksum(image.data(), image.size());
+    std::memcpy(image.data() + offsetof(CheckpointHeader, checksum), &checksum, sizeof(checksum));
+}
+
+std::vector<unsigned char> encodeCheckpoint(const BodySystem& s, std::uint32_t integratorKind,
+                                            const std::vector<double>& integratorState, const std::string& rngState) {
+    std::vector<unsigned char> image = copyCheckpoint(s, integratorKind, integratorState, rngState);
+    sealCheckpoint(image);
+    return image;
+}
+
+// Write an image to path via a temporary file and an atomic rename
+static bool writeCheckpointFile(const std::string& path, const std::vector<unsigned char>& image) {
+    const std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to create checkpoint " << temporary << std::endl;
+        return false;
+    }
+    size_t written = 0;
+    while (written < image.size()) {
+        ssize_t count = ::write(fd, image.data() + written, image.size() - written);
+        if (count <= 0) {
+            break;
+        }
+        written += size_t(count);
+    }
+    bool ok = written == image.size() && ::fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write checkpoint " << path << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+void CheckpointWriter::snapshot(const char* path, const BodySystem& s, std::uint32_t integratorKind,
+                                const std::vector<double>& integratorState, const std::string& rngState) {
+    // Only the copy happens here; the checksum pass over the image runs with the write
+    auto image = std::make_shared<std::vector<unsigned char>>(copyCheckpoint(s, integratorKind, integratorState, rngState));
+    std::string target(path);
+    lastWrite = TaskScheduler::instance().submit([this, image, target] {
+        sealCheckpoint(*image);
+        if (writeCheckpointFile(target, *image)) {
+            ++completed;
+        } else {
+            ++failed;
+        }
+    }, {lastWrite});
+}
+
+void CheckpointWriter::flush() {
+    if (lastWrite) {
+        TaskScheduler::instance().wait(lastWrite);
+        lastWrite = nullptr;
+    }
+}
+
+bool CheckpointFile::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open checkpoint " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(CheckpointHeader)) {
+        std::cerr << "Checkpoint " << path << " is truncated" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void* mapping = ::mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map checkpoint " << path << std::endl;
+        return false;
+    }
+    data = static_cast<const unsigned char*>(mapping);
+    length = size_t(info.st_size);
+
+    const CheckpointHeader& h = header();
+    const char* problem = nullptr;
+    if (std::memcmp(h.magic, checkpointMagic, sizeof(h.magic)) != 0) {
+        problem = "is not a checkpoint";
+    } else if (h.byteOrderMark != checkpointByteOrderMark) {
+        problem = "was written with a different byte order";
+    } else if (h.version == 0 || h.version > checkpointVersion) {
+        problem = "has an unsupported version";
+    } else if (h.headerBytes < sizeof(CheckpointHeader) || h.fileBytes > length) {
+        problem = "is truncated";
+    } else if (h.headerBytes > h.fileBytes) {
+        problem = "has a corrupt header";
+    } else {
+        const std::uint32_t sections = std::min(h.sectionCount, checkpointMaxSections);
+        for (std::uint32_t k = 0; k < sections && !problem; ++k) {
+            if (h.sectionOffset[k] % sizeof(double) != 0 || h.sectionOffset[k] < h.headerBytes ||
+                h.sectionOffset[k] > h.fileBytes ||
+                h.sectionBytes[k] > h.fileBytes - h.sectionOffset[k]) {
+                problem = "has a corrupt section table";
+            } else if (k < CheckpointIntegratorState && h.sectionBytes[k] != h.bodyCount * sizeof(double)) {
+                problem = "has body arrays of the wrong size";
+            }
+        }
+        if (!problem && h.sectionCount <= CheckpointMass) {
+            problem = "is missing body arrays";
+        }
+    }
+    if (problem) {
+        std::cerr << "Checkpoint " << path << " " << problem << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CheckpointFile::close() {
+    if (data) {
+        ::munmap(const_cast<unsigned char*>(data), length);
+        data = nullptr;
+        length = 0;
+    }
+}
+
+const unsigned char* CheckpointFile::section(CheckpointSection which) const {
+    if (!data || std::uint32_t(which) >= header().sectionCount) {
+        return nullptr;
+    }
+    return data + header().sectionOffset[which];
+}
+
+bool CheckpointFile::restore(BodySystem& s, std::uint32_t* integratorKind, std::vector<double>* integratorState,
+                             std::string* rngState) const {
+    if (!data) {
+        return false;
+    }
+    const CheckpointHeader& h = header();
+    if (checkpointChecksum(data, size_t(h.fileBytes)) != h.checksum) {
+        std::cerr << "Checkpoint checksum mismatch" << std::endl;
+        return false;
+    }
+    const size_t n = bodyCount();
+    std::vector<double>* arrays[] = {&s.x, &s.y, &s.z, &s.vx, &s.vy, &s.vz, &s.ax, &s.ay, &s.az, &s.mass};
+    for (int k = 0; k < CheckpointIntegratorState; ++k) {
+        const double* source = array(CheckpointSection(k));
+        arrays[k]->assign(source, source + n);
+    }
+    s.time = h.time;
+    s.accelerationsValid = (h.flags & CheckpointAccelerationsValid) != 0;
+
+    if (integratorKind) {
+        *integratorKind = h.integratorKind;
+    }
+    if (integratorState) {
+        const double* state = array(CheckpointIntegratorState);
+        size_t count = state ? size_t(h.sectionBytes[CheckpointIntegratorState]) / sizeof(double) : 0;
+        integratorState->assign(state, state + count);
+    }
+    if (rngState) {
+        const char* text = reinterpret_cast<const char*>(section(CheckpointRngState));
+        rngState->assign(text, text ? size_t(h.sectionBytes[CheckpointRngState]) : 0);
+    }
+    return true;
+}
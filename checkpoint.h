@@ -0,0 +1,135 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "nbody.h"
+#include "task_scheduler.h"
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Binary checkpoint of a running simulation.
+//
+// Layout: a fixed header followed by sections, each starting on a 64-byte boundary so a
+// mapped file can be read in place as double arrays. Every body array is its own
+// section in BodySystem order, followed by the integrator's opaque state (doubles) and
+// the RNG state (text, which round-trips standard engines exactly). Values are stored
+// as raw native doubles, so a restart reproduces the state bit for bit; the byte-order
+// mark rejects files from a machine with the other endianness.
+//
+// Readers reject versions newer than their own. headerBytes and the fixed-size section
+// table leave room for later versions to append header fields and sections while
+// still reading older files.
+enum CheckpointSection {
+    CheckpointX, CheckpointY, CheckpointZ,
+    CheckpointVx, CheckpointVy, CheckpointVz,
+    CheckpointAx, CheckpointAy, CheckpointAz,
+    CheckpointMass,
+    CheckpointIntegratorState,
+    CheckpointRngState,
+    CheckpointSectionCount
+};
+
+const std::uint32_t checkpointVersion = 1;
+const std::uint32_t checkpointMaxSections = 16; // Room in the section table for later versions
+const std::uint32_t checkpointByteOrderMark = 0x01020304;
+
+struct CheckpointHeader {
+    char magic[8];                    // "NBODYCKP"
+    std::uint32_t version;
+    std::uint32_t headerBytes;        // sizeof(CheckpointHeader) of the writer
+    std::uint32_t byteOrderMark;
+    std::uint32_t flags;              // CheckpointAccelerationsValid
+    std::uint64_t bodyCount;
+    double time;
+    std::uint32_t integratorKind;     // Caller-defined, e.g. IntegratorKind
+    std::uint32_t sectionCount;       // Sections the writer knew about
+    std::uint64_t fileBytes;
+    std::uint64_t checksum;           // FNV-1a over the file, this field read as zero
+    std::uint64_t sectionOffset[checkpointMaxSections];
+    std::uint64_t sectionBytes[checkpointMaxSections];
+};
+static_assert(CheckpointSectionCount <= checkpointMaxSections, "checkpoint section table is full");
+
+const std::uint32_t CheckpointAccelerationsValid = 1;
+
+// Serialize a standard random engine (or anything with stream operators) exactly
+template <class Rng>
+inline std::string saveRngState(const Rng& rng) {
+    std::ostringstream out;
+    out << rng;
+    return out.str();
+}
+
+template <class Rng>
+inline bool loadRngState(Rng& rng, const std::string& state) {
+    std::istringstream in(state);
+    Rng restored;
+    if (!(in >> restored)) {
+        return false;
+    }
+    rng = restored;
+    return true;
+}
+
+// Builds the whole file image in memory: the only work done on the simulation thread
+// is this copy, after which the checksum and the writes run on the task scheduler.
+class CheckpointWriter {
+public:
+    ~CheckpointWriter() { flush(); }
+
+    // Copy the state now and write it to path in the background. Writes go to a
+    // temporary file that replaces path once complete, so a crash mid-write keeps the
+    // previous checkpoint. Writes to the same writer happen in submission order.
+    void snapshot(const char* path, const BodySystem& s, std::uint32_t integratorKind = 0,
+                  const std::vector<double>& integratorState = {}, const std::string& rngState = "");
+
+    // Block until every queued write has finished
+    void flush();
+
+    int completedWrites() const { return completed; }
+    int failedWrites() const { return failed; }
+
+private:
+    TaskHandle lastWrite;
+    std::atomic<int> completed{0};
+    std::atomic<int> failed{0};
+};
+
+// Encode a checkpoint image; exposed for writers that handle the I/O themselves
+std::vector<unsigned char> encodeCheckpoint(const BodySystem& s, std::uint32_t integratorKind,
+                                            const std::vector<double>& integratorState, const std::string& rngState);
+
+// Read-only memory mapping of a checkpoint file
+class CheckpointFile {
+public:
+    CheckpointFile() = default;
+    CheckpointFile(const CheckpointFile&) = delete;
+    CheckpointFile& operator=(const CheckpointFile&) = delete;
+    ~CheckpointFile() { close(); }
+
+    // Map the file and validate its header and section bounds
+    bool open(const char* path);
+    void close();
+
+    const CheckpointHeader& header() const { return *reinterpret_cast<const CheckpointHeader*>(data); }
+    size_t bodyCount() const { return size_t(header().bodyCount); }
+    double time() const { return header().time; }
+
+    // Pointers into the mapping; nullptr for sections the writer did not know about
+    const unsigned char* section(CheckpointSection which) const;
+    const double* array(CheckpointSection which) const {
+        return reinterpret_cast<const double*>(section(which));
+    }
+
+    // Verify the checksum and copy everything out
+    bool restore(BodySystem& s, std::uint32_t* integratorKind = nullptr, std::vector<double>* integratorState = nullptr,
+                 std::string* rngState = nullptr) const;
+
+private:
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include "conjunction.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+static const std::uint64_t cellBias = std::uint64_t(1) << 20;
+static const std::uint64_t cellLimit = (std::uint64_t(1) << 21) - 1;
+static const std::uint64_t emptyKey = ~std::uint64_t(0);
+static const size_t cellsPerTask = 64;
+
+// Cell coordinate packed into 21 bits, clamped far out where cells are empty anyway
+static std::uint64_t cellCoordinate(double p, double cellSize) {
+    double c = std::floor(p / cellSize) + double(cellBias);
+    if (c < 0.0) {
+        return 0;
+    }
+    if (c > double(cellLimit)) {
+        return cellLimit;
+    }
+    return std::uint64_t(c);
+}
+
+static std::uint64_t packCell(std::uint64_t ix, std::uint64_t iy, std::uint64_t iz) {
+    return ix | (iy << 21) | (iz << 42);
+}
+
+static size_t hashSlot(std::uint64_t key, std::uint64_t mask) {
+    return size_t((key * 0x9E3779B97F4A7C15ull) >> 17) & mask;
+}
+
+void ConjunctionScreener::filterByRadius(const Sgp4Catalog& catalog) {
+    const size_t n = catalog.size();
+    perigee.resize(n);
+    apogee.resize(n);
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; ++i) {
+        catalog.radiusRange(i, perigee[i], apogee[i]);
+        perigee[i] -= padKm;
+        apogee[i] += padKm;
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return perigee[a] < perigee[b]; });
+
+    // In perigee order an object overlaps an earlier shell if the running apogee maximum
+    // reaches it, and a later one if the next perigee falls inside its own shell
+    screened.clear();
+    double highestApogee = -1.0e300;
+    for (size_t k = 0; k < n; ++k) {
+        const size_t i = order[k];
+        bool overlaps = highestApogee + thresholdKm >= perigee[i];
+        if (k + 1 < n && perigee[order[k + 1]] <= apogee[i] + thresholdKm) {
+            overlaps = true;
+        }
+        if (overlaps) {
+            screened.push_back(i);
+        }
+        highestApogee = std::max(highestApogee, apogee[i]);
+    }
+    std::sort(screened.begin(), screened.end());
+}
+
+void ConjunctionScreener::buildHash(double cellSize) {
+    std::vector<std::pair<std::uint64_t, size_t>> keyed;
+    keyed.reserve(screened.size());
+    for (size_t i : screened) {
+        if (errors[i] != Sgp4Ok) {
+            continue;
+        }
+        keyed.emplace_back(packCell(cellCoordinate(x[i], cellSize), cellCoordinate(y[i], cellSize),
+                                    cellCoordinate(z[i], cellSize)), i);
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    // Gather the state in cell order so every cell is a contiguous run
+    const size_t count = keyed.size();
+    sortedKey.resize(count);
+    sortedObject.resize(count);
+    px.resize(count); py.resize(count); pz.resize(count);
+    pvx.resize(count); pvy.resize(count); pvz.resize(count);
+    cellStarts.clear();
+    for (size_t k = 0; k < count; ++k) {
+        const size_t i = keyed[k].second;
+        sortedKey[k] = keyed[k].first;
+        sortedObject[k] = i;
+        px[k] = x[i]; py[k] = y[i]; pz[k] = z[i];
+        pvx[k] = vx[i]; pvy[k] = vy[i]; pvz[k] = vz[i];
+        if (k == 0 || sortedKey[k] != sortedKey[k - 1]) {
+            cellStarts.push_back(k);
+        }
+    }
+    const size_t cells = cellStarts.size();
+    cellStarts.push_back(count);
+
+    size_t capacity = 16;
+    while (capacity < 2 * cells) {
+        capacity *= 2;
+    }
+    tableMask = capacity - 1;
+    tableKey.assign(capacity, emptyKey);
+    tableStart.resize(capacity);
+    tableCount.resize(capacity);
+    for (size_t c = 0; c < cells; ++c) {
+        const std::uint64_t key = sortedKey[cellStarts[c]];
+        size_t slot = hashSlot(key, tableMask);
+        while (tableKey[slot] != emptyKey) {
+            slot = (slot + 1) & tableMask;
+        }
+        tableKey[slot] = key;
+        tableStart[slot] = std::uint32_t(cellStarts[c]);
+        tableCount[slot] = std::uint32_t(cellStarts[c + 1] - cellStarts[c]);
+    }
+}
+
+bool ConjunctionScreener::findCell(std::uint64_t key, std::uint32_t& start, std::uint32_t& count) const {
+    size_t slot = hashSlot(key, tableMask);
+    while (tableKey[slot] != emptyKey) {
+        if (tableKey[slot] == key) {
+            start = tableStart[slot];
+            count = tableCount[slot];
+            return true;
+        }
+        slot = (slot + 1) & tableMask;
+    }
+    return false;
+}
+
+bool ConjunctionScreener::refine(const Sgp4Catalog& catalog, size_t a, size_t b, double jd, double halfWindowDays,
+                                 Conjunction& out) const {
+    double t = jd;
+    double ra[3], va[3], rb[3], vb[3];
+    double dr[3], dv[3];
+    for (int iter = 0; iter < 12; ++iter) {
+        if (catalog.propagateSatellite(a, t, ra, va) != Sgp4Ok || catalog.propagateSatellite(b, t, rb, vb) != Sgp4Ok) {
+            return false;
+        }
+        for (int k = 0; k < 3; ++k) {
+            dr[k] = rb[k] - ra[k];
+            dv[k] = vb[k] - va[k];
+        }
+        const double vv = dv[0] * dv[0] + dv[1] * dv[1] + dv[2] * dv[2];
+        if (vv < 1e-18) {
+            break;
+        }
+        // Newton on d/dt |dr|^2 = 0, neglecting the relative acceleration
+        const double dtSeconds = -(dr[0] * dv[0] + dr[1] * dv[1] + dr[2] * dv[2]) / vv;
+        double next = t + dtSeconds / 86400.0;
+        next = std::min(std::max(next, jd - 2.0 * halfWindowDays), jd + 2.0 * halfWindowDays);
+        const bool converged = std::fabs(next - t) * 86400.0 < 1e-4;
+        t = next;
+        if (converged) {
+            if (catalog.propagateSatellite(a, t, ra, va) != Sgp4Ok ||
+                catalog.propagateSatellite(b, t, rb, vb) != Sgp4Ok) {
+                return false;
+            }
+            for (int k = 0; k < 3; ++k) {
+                dr[k] = rb[k] - ra[k];
+                dv[k] = vb[k] - va[k];
+            }
+            break;
+        }
+    }
+    out.a = std::min(a, b);
+    out.b = std::max(a, b);
+    out.tcaJd = t;
+    out.missDistanceKm = std::sqrt(dr[0] * dr[0] + dr[1] * dr[1] + dr[2] * dr[2]);
+    out.relativeSpeedKmS = std::sqrt(dv[0] * dv[0] + dv[1] * dv[1] + dv[2] * dv[2]);
+    return true;
+}
+
+void ConjunctionScreener::scanCells(const Sgp4Catalog& catalog, size_t firstCell, size_t endCell, double jd,
+                                    double halfWindowDays, double cellSize, std::vector<Conjunction>& found,
+                                    ConjunctionStats& counts) const {
+    const double halfWindowSeconds = halfWindowDays * 86400.0;
+    const double cellSize2 = cellSize * cellSize;
+    const double linearLimit = thresholdKm + padKm;
+    const double linearLimit2 = linearLimit * linearLimit;
+
+    auto testPair = [&](size_t i, size_t j) {
+        const double dx = px[j] - px[i], dy = py[j] - py[i], dz = pz[j] - pz[i];
+        if (dx * dx + dy * dy + dz * dz > cellSize2) {
+            return;
+        }
+        ++counts.pairTests;
+        const size_t a = sortedObject[i], b = sortedObject[j];
+        if (perigee[a] > apogee[b] + thresholdKm || perigee[b] > apogee[a] + thresholdKm) {
+            ++counts.orbitFilterRejects;
+            return;
+        }
+        // Straight-line closest approach within the window
+        const double dvx = pvx[j] - pvx[i], dvy = pvy[j] - pvy[i], dvz = pvz[j] - pvz[i];
+        const double vv = dvx * dvx + dvy * dvy + dvz * dvz;
+        double t = vv > 0.0 ? -(dx * dvx + dy * dvy + dz * dvz) / vv : 0.0;
+        t = std::min(std::max(t, -halfWindowSeconds), halfWindowSeconds);
+        const double mx = dx + dvx * t, my = dy + dvy * t, mz = dz + dvz * t;
+        if (mx * mx + my * my + mz * mz > linearLimit2) {
+            return;
+        }
+        ++counts.candidates;
+        Conjunction c;
+        if (!refine(catalog, a, b, jd + t / 86400.0, halfWindowDays, c)) {
+            return;
+        }
+        // Only the window holding the TCA reports it, so neighbouring steps do not repeat it
+        if (c.missDistanceKm < thresholdKm && c.tcaJd >= jd - halfWindowDays && c.tcaJd < jd + halfWindowDays) {
+            found.push_back(c);
+        }
+    };
+
+    for (size_t c = firstCell; c < endCell; ++c) {
+        const size_t begin = cellStarts[c], end = cellStarts[c + 1];
+        for (size_t i = begin; i < end; ++i) {
+            for (size_t j = i + 1; j < end; ++j) {
+                testPair(i, j);
+            }
+        }
+        // The 13 neighbours ahead of this cell; the other 13 visit it from their side
+        const std::uint64_t key = sortedKey[begin];
+        const std::int64_t ix = std::int64_t(key & cellLimit);
+        const std::int64_t iy = std::int64_t((key >> 21) & cellLimit);
+        const std::int64_t iz = std::int64_t(key >> 42);
+        for (int ox = -1; ox <= 1; ++ox) {
+            for (int oy = -1; oy <= 1; ++oy) {
+                for (int oz = -1; oz <= 1; ++oz) {
+                    const int order = ox * 9 + oy * 3 + oz;
+                    if (order <= 0) {
+                        continue;
+                    }
+                    const std::int64_t nx = ix + ox, ny = iy + oy, nz = iz + oz;
+                    if (nx < 0 || ny < 0 || nz < 0 || nx > std::int64_t(cellLimit) ||
+                        ny > std::int64_t(cellLimit) || nz > std::int64_t(cellLimit)) {
+                        continue;
+                    }
+                    std::uint32_t start, count;
+                    if (!findCell(packCell(nx, ny, nz), start, count)) {
+                        continue;
+                    }
+                    for (size_t i = begin; i < end; ++i) {
+                        for (size_t j = start; j < start + count; ++j) {
+                            testPair(i, j);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+size_t ConjunctionScreener::screen(Sgp4Catalog& catalog, double startJd, double endJd,
+                                   const std::function<void(const Conjunction&)>& report) {
+    stats = ConjunctionStats();
+    const size_t n = catalog.size();
+    if (n < 2 || endJd < startJd || stepSeconds <= 0.0) {
+        return 0;
+    }
+    x.resize(n); y.resize(n); z.resize(n);
+    vx.resize(n); vy.resize(n); vz.resize(n);
+    errors.resize(n);
+
+    filterByRadius(catalog);
+    stats.objectsScreened = (long long)screened.size();
+
+    const double stepDays = stepSeconds / 86400.0;
+    const double halfWindowDays = 0.5 * stepDays;
+    const double cellSize = thresholdKm + maxRelativeSpeedKmS * 0.5 * stepSeconds + padKm;
+    const long long steps = (long long)std::floor((endJd - startJd) / stepDays) + 1;
+
+    std::vector<std::vector<Conjunction>> found;
+    std::vector<ConjunctionStats> counts;
+    std::vector<Conjunction> merged;
+    size_t total = 0;
+
+    for (long long step = 0; step < steps; ++step) {
+        const double jd = startJd + double(step) * stepDays;
+        catalog.propagateParallel(jd, x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data(), errors.data());
+        buildHash(cellSize);
+
+        // Blocks of cells go to the scheduler; each block keeps its own results and counters
+        const size_t cells = cellStarts.size() - 1;
+        const size_t blocks = (cells + cellsPerTask - 1) / cellsPerTask;
+        found.resize(std::max(found.size(), blocks));
+        counts.resize(std::max(counts.size(), blocks));
+        TaskScheduler::instance().parallelFor(0, blocks, 1, [&](size_t begin, size_t end) {
+            for (size_t block = begin; block < end; ++block) {
+                const size_t first = block * cellsPerTask;
+                scanCells(catalog, first, std::min(first + cellsPerTask, cells), jd, halfWindowDays, cellSize,
+                          found[block], counts[block]);
+            }
+        });
+
+        merged.clear();
+        for (size_t block = 0; block < blocks; ++block) {
+            merged.insert(merged.end(), found[block].begin(), found[block].end());
+            found[block].clear();
+        }
+        std::sort(merged.begin(), merged.end(),
+                  [](const Conjunction& l, const Conjunction& r) { return l.tcaJd < r.tcaJd; });
+        for (const Conjunction& c : merged) {
+            if (c.tcaJd >= startJd && c.tcaJd <= endJd) {
+                report(c);
+                ++total;
+            }
+        }
+        ++stats.steps;
+    }
+
+    for (const ConjunctionStats& c : counts) {
+        stats.pairTests += c.pairTests;
+        stats.orbitFilterRejects += c.orbitFilterRejects;
+        stats.candidates += c.candidates;
+    }
+    stats.conjunctions = (long long)total;
+    return total;
+}
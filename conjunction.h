@@ -0,0 +1,75 @@
+#ifndef CONJUNCTION_H
+#define CONJUNCTION_H
+
+#include "sgp4.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// One close approach between two catalog objects
+struct Conjunction {
+    size_t a = 0, b = 0;
+    double tcaJd = 0.0;            // Time of closest approach
+    double missDistanceKm = 0.0;
+    double relativeSpeedKmS = 0.0;
+};
+
+struct ConjunctionStats {
+    long long steps = 0;
+    long long objectsScreened = 0;      // Objects left after the apogee/perigee filter
+    long long pairTests = 0;            // Pairs compared inside neighbouring hash cells
+    long long orbitFilterRejects = 0;   // Of those, pairs whose radius shells cannot meet
+    long long candidates = 0;           // Pairs passed on to TCA refinement
+    long long conjunctions = 0;
+};
+
+// All-vs-all close-approach screening of an SGP4 catalog over a time window.
+// Stage 1 drops objects whose perigee-apogee shell overlaps no other object's.
+// Stage 2 samples the catalog every stepSeconds and bins positions into a uniform
+// spatial hash whose cells are wide enough that any pair closer than thresholdKm at
+// some time in the step's window sits in neighbouring cells at the sample time.
+// Pairs there are checked against their radius shells and a straight-line closest
+// approach over the window. Stage 3 refines survivors with Newton iterations on
+// the SGP4 positions. Each approach is reported once, from the window containing
+// its refined TCA. Propagation and cell scanning run on the shared TaskScheduler.
+class ConjunctionScreener {
+public:
+    double thresholdKm = 5.0;
+    double stepSeconds = 30.0;
+    double maxRelativeSpeedKmS = 16.0; // Bounds how far a pair can close within half a step
+    double padKm = 10.0;               // Slack for drag, periodic terms and path curvature
+
+    ConjunctionStats stats;
+
+    // Screen [startJd, endJd]. report() is called on the calling thread after every
+    // sample step with that step's conjunctions in TCA order, so results stream out
+    // while the screen runs. Returns the number of conjunctions found.
+    size_t screen(Sgp4Catalog& catalog, double startJd, double endJd,
+                  const std::function<void(const Conjunction&)>& report);
+
+private:
+    // Positions and velocities at the current sample, reordered by hash cell
+    std::vector<double> x, y, z, vx, vy, vz;
+    std::vector<double> px, py, pz, pvx, pvy, pvz;
+    std::vector<std::uint8_t> errors;
+    std::vector<double> perigee, apogee;
+    std::vector<size_t> screened;     // Objects kept by the apogee/perigee filter
+    std::vector<size_t> sortedObject; // Slot in the cell order -> object
+    std::vector<std::uint64_t> sortedKey;
+    // Open-addressing table from cell key to its run of slots
+    std::vector<std::uint64_t> tableKey;
+    std::vector<std::uint32_t> tableStart, tableCount;
+    std::uint64_t tableMask = 0;
+    std::vector<size_t> cellStarts;
+
+    void filterByRadius(const Sgp4Catalog& catalog);
+    void buildHash(double cellSize);
+    bool findCell(std::uint64_t key, std::uint32_t& start, std::uint32_t& count) const;
+    void scanCells(const Sgp4Catalog& catalog, size_t firstCell, size_t endCell, double jd, double halfWindowDays,
+                   double cellSize, std::vector<Conjunction>& found, ConjunctionStats& counts) const;
+    bool refine(const Sgp4Catalog& catalog, size_t a, size_t b, double jd, double halfWindowDays,
+                Conjunction& out) const;
+};
+
+#endif
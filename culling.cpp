@@ -0,0 +1,171 @@
+#include "culling.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <cmath>
+
+// Spheres tested side by side by the culling loops
+static const int lanes = 8;
+// Sets smaller than this are culled on the calling thread
+static const size_t parallelThreshold = 16384;
+// Spheres per parallel piece
+static const size_t pieceSize = 8192;
+
+void BoundingSpheres::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+}
+
+void BoundingSpheres::add(float cx, float cy, float cz, float r) {
+    x.push_back(cx);
+    y.push_back(cy);
+    z.push_back(cz);
+    radius.push_back(r);
+}
+
+void frustumPlanes(const glm::mat4& m, bool zeroToOne, float planes[6][4]) {
+    // Rows of the matrix (glm is column-major); a clip-space bound a <= w becomes the
+    // plane row3 - rowA >= 0, and so on
+    glm::vec4 row[4];
+    for (int r = 0; r < 4; ++r) {
+        row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+    }
+    const glm::vec4 bounds[6] = {row[3] + row[0], row[3] - row[0], row[3] + row[1],
+                                 row[3] - row[1], zeroToOne ? row[2] : row[3] + row[2], row[3] - row[2]};
+    for (int p = 0; p < 6; ++p) {
+        const float length = std::sqrt(bounds[p].x * bounds[p].x + bounds[p].y * bounds[p].y + bounds[p].z * bounds[p].z);
+        // A plane at infinity has no normal left; its offset alone keeps everything
+        const float scale = length > 1.0e-20f ? 1.0f / length : 1.0f;
+        planes[p][0] = bounds[p].x * scale;
+        planes[p][1] = bounds[p].y * scale;
+        planes[p][2] = bounds[p].z * scale;
+        planes[p][3] = bounds[p].w * scale;
+    }
+}
+
+void SphereCuller::addOccluder(float cx, float cy, float cz, float r) {
+    const float distance = std::sqrt(cx * cx + cy * cy + cz * cz);
+    // Shrunk by a few float roundings so a sliver showing at the limb is never dropped
+    r *= 1.0f - 4.0e-6f;
+    if (!(distance > r)) {
+        return;
+    }
+    const float sinHalfAngle = r / distance;
+    const float cos2HalfAngle = 1.0f - sinHalfAngle * sinHalfAngle;
+    occluders.push_back({cx / distance, cy / distance, cz / distance, sinHalfAngle, cos2HalfAngle, distance * cos2HalfAngle});
+}
+
+// With u the unit direction to the occluder, s and c2 the sine and squared cosine of
+// its half-angle and k = c . u, a sphere is inside the cone when its own angular radius
+// fits (r <= s |c|) and the angle between them leaves room for it (k - s r >= 0 and
+// (k - s r)^2 >= c2 (|c|^2 - r^2), the squared form of cos(angle) >= cos(half-angle -
+// its angular radius)), and beyond the silhouette plane when k - r reaches that plane.
+// Lengths are relative to the eye and scaled by nothing larger, so nothing overflows.
+static inline int hiddenBy(const SphereCuller::Occluder& o, float cx, float cy, float cz, float cr) {
+    const float k = cx * o.dx + cy * o.dy + cz * o.dz;
+    const float length2 = cx * cx + cy * cy + cz * cz;
+    const float a = k - o.sinHalfAngle * cr;
+    return (cr * cr <= o.sinHalfAngle * o.sinHalfAngle * length2) & (a >= 0.0f) &
+           (a * a >= o.cos2HalfAngle * (length2 - cr * cr)) & (k - cr >= o.silhouetteDistance);
+}
+
+// Compact the indices of spheres [begin, end) that are inside the frustum and not hidden
+// into out; returns the count and adds the hidden ones to occluded
+size_t SphereCuller::cullRange(const BoundingSpheres& s, size_t begin, size_t end, std::uint32_t* out,
+                               size_t& occluded) const {
+    const float* x = s.x.data();
+    const float* y = s.y.data();
+    const float* z = s.z.data();
+    const float* r = s.radius.data();
+    size_t kept = 0;
+    for (size_t i = begin; i < end; i += lanes) {
+        const int n = int(std::min<size_t>(lanes, end - i));
+        // Smallest distance past any plane, plus the radius; inside when >= 0
+        float margin[lanes];
+        for (int l = 0; l < lanes; ++l) {
+            margin[l] = INFINITY;
+        }
+        for (int p = 0; p < 6; ++p) {
+            const float a = planes[p][0], b = planes[p][1], c = planes[p][2], d = planes[p][3];
+            if (n == lanes) {
+                for (int l = 0; l < lanes; ++l) {
+                    const float distance = a * x[i + l] + b * y[i + l] + c * z[i + l] + d + r[i + l];
+                    margin[l] = margin[l] < distance ? margin[l] : distance;
+                }
+            } else {
+                for (int l = 0; l < n; ++l) {
+                    const float distance = a * x[i + l] + b * y[i + l] + c * z[i + l] + d + r[i + l];
+                    margin[l] = margin[l] < distance ? margin[l] : distance;
+                }
+            }
+        }
+        int hidden[lanes] = {};
+        for (const Occluder& o : occluders) {
+            if (n == lanes) {
+                for (int l = 0; l < lanes; ++l) {
+                    hidden[l] |= hiddenBy(o, x[i + l], y[i + l], z[i + l], r[i + l]);
+                }
+            } else {
+                for (int l = 0; l < n; ++l) {
+                    hidden[l] |= hiddenBy(o, x[i + l], y[i + l], z[i + l], r[i + l]);
+                }
+            }
+        }
+        // Write every index and advance past the kept ones only, so there is no branch
+        for (int l = 0; l < n; ++l) {
+            const bool inside = margin[l] >= 0.0f;
+            out[kept] = std::uint32_t(i + l);
+            kept += inside & !hidden[l];
+            occluded += inside & (hidden[l] != 0);
+        }
+    }
+    return kept;
+}
+
+size_t SphereCuller::cull(const BoundingSpheres& spheres, std::vector<std::uint32_t>& visible) {
+    const size_t n = spheres.size();
+    visible.resize(n);
+    size_t kept, occluded = 0;
+    if (n < parallelThreshold) {
+        kept = cullRange(spheres, 0, n, visible.data(), occluded);
+    } else {
+        const size_t pieces = (n + pieceSize - 1) / pieceSize;
+        std::vector<size_t> counts(pieces), hiddenCounts(pieces);
+        TaskScheduler::instance().parallelFor(0, pieces, 1, [&](size_t first, size_t last) {
+            for (size_t piece = first; piece < last; ++piece) {
+                const size_t begin = piece * pieceSize;
+                hiddenCounts[piece] = 0;
+                counts[piece] = cullRange(spheres, begin, std::min(n, begin + pieceSize),
+                                          visible.data() + begin, hiddenCounts[piece]);
+            }
+        });
+        for (size_t hiddenCount : hiddenCounts) {
+            occluded += hiddenCount;
+        }
+        // Close up the stretches; each moves down, so copying forwards is safe
+        kept = counts[0];
+        for (size_t piece = 1; piece < pieces; ++piece) {
+            const size_t begin = piece * pieceSize;
+            std::copy(visible.begin() + begin, visible.begin() + begin + counts[piece], visible.begin() + kept);
+            kept += counts[piece];
+        }
+    }
+    visible.resize(kept);
+    stats.tested += n;
+    stats.visible += kept;
+    stats.occluded += occluded;
+    stats.culled += n - kept - occluded;
+    return kept;
+}
+
+bool SphereCuller::visible(float cx, float cy, float cz, float r) {
+    bool inside = true;
+    for (int p = 0; p < 6; ++p) {
+        inside = inside && planes[p][0] * cx + planes[p][1] * cy + planes[p][2] * cz + planes[p][3] + r >= 0.0f;
+    }
+    stats.tested += 1;
+    stats.visible += inside;
+    stats.culled += !inside;
+    return inside;
+}
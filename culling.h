@@ -0,0 +1,81 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "glm/glm/glm.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounding spheres as parallel arrays, the layout the culling loops vectorize over.
+// Centres are camera-relative like everything else handed to the GPU.
+struct BoundingSpheres {
+    std::vector<float> x, y, z, radius;
+
+    size_t size() const { return x.size(); }
+    void clear();
+    void add(float cx, float cy, float cz, float r);
+};
+
+// Planes of the clip volume of viewProjection as inward normals and offsets: a point p
+// is inside when n . p + d >= 0 for all six. zeroToOne selects [0, 1] clip depth
+// (glClipControl) rather than [-1, 1]. Planes at infinity, which infinite projections
+// have, accept everything.
+void frustumPlanes(const glm::mat4& viewProjection, bool zeroToOne, float planes[6][4]);
+
+struct CullStats {
+    long long tested = 0;
+    long long visible = 0;
+    long long culled = 0;   // Entirely outside the frustum
+    long long occluded = 0; // Inside it but hidden behind an occluder
+};
+
+// View-frustum culling of bounding spheres.
+//
+// A sphere is kept when it reaches the inner side of all six planes of the clip volume.
+// Spheres are tested in fixed-width lanes the compiler vectorizes (8 floats fill an AVX2
+// register, two NEON ones), keeping for each lane the smallest signed distance to any
+// plane with no branches. Survivors are compacted into an index list in their original
+// order. Large sets are split over the task scheduler, each piece compacting into its
+// own stretch of the output before the stretches are closed up.
+//
+// Spheres in the frustum are also dropped when an occluder sphere, such as a planet,
+// hides them completely. Seen from the eye, an occluder casts a cone of sight lines that
+// hit it; a sphere is hidden when it lies inside that cone and beyond the plane of the
+// occluder's silhouette, since every sight line to it then meets the occluder first.
+// Both tests reduce to comparisons of dot products and squared lengths, so they share
+// the frustum test's lanes with no square roots or branches.
+class SphereCuller {
+public:
+    CullStats stats; // Counts since the last beginFrame()
+
+    void beginFrame() { stats = CullStats(); }
+
+    // Cull against frustumPlanes(viewProjection, zeroToOne), for camera-relative centres
+    void setFrustum(const glm::mat4& viewProjection, bool zeroToOne) { frustumPlanes(viewProjection, zeroToOne, planes); }
+
+    // Replace visible with the indices of the spheres at least partly inside the
+    // frustum and not hidden by an occluder, in order, and return how many there are.
+    // NaN centres are culled.
+    size_t cull(const BoundingSpheres& spheres, std::vector<std::uint32_t>& visible);
+    // A single sphere against the frustum only, counted like the rest
+    bool visible(float cx, float cy, float cz, float r);
+
+    // Occluders for the following cull() calls, camera-relative like the spheres. One
+    // containing the eye hides nothing and is ignored.
+    void clearOccluders() { occluders.clear(); }
+    void addOccluder(float cx, float cy, float cz, float r);
+
+    // An occluder as seen from the eye: the unit direction to its centre, the sine and
+    // squared cosine of its cone's half-angle and the distance to its silhouette plane
+    struct Occluder {
+        float dx, dy, dz, sinHalfAngle, cos2HalfAngle, silhouetteDistance;
+    };
+
+private:
+    float planes[6][4] = {}; // Inward normal and offset: inside when n . p + d >= 0
+    std::vector<Occluder> occluders;
+
+    size_t cullRange(const BoundingSpheres& s, size_t begin, size_t end, std::uint32_t* out, size_t& occluded) const;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "depth_buffer.h"
+#include "glm/glm/gtc/matrix_transform.hpp"
+#include <cmath>
+#include <iostream>
+
+void DepthBuffer::init(int w, int h, double farDistance) {
+    width = w;
+    height = h;
+    logDepthCoef = (float)(2.0 / std::log2(farDistance + 1.0));
+    depthMode = DepthMode::LogarithmicDepth;
+    if (!(GLEW_VERSION_4_5 || GLEW_ARB_clip_control)) {
+        std::cerr << "glClipControl unavailable, using logarithmic depth" << std::endl;
+        return;
+    }
+
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cerr << "Float depth framebuffer incomplete, using logarithmic depth" << std::endl;
+        destroy();
+        return;
+    }
+
+    glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+    depthMode = DepthMode::ReverseZ;
+}
+
+void DepthBuffer::destroy() {
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthRenderbuffer);
+        framebuffer = colorBuffer = depthRenderbuffer = 0;
+    }
+}
+
+const char* DepthBuffer::shaderDefines() const {
+    return depthMode == DepthMode::LogarithmicDepth ? "#define LOG_DEPTH\n" : "";
+}
+
+glm::mat4 DepthBuffer::projection(float fovy, float aspect, float zNear) const {
+    if (depthMode == DepthMode::LogarithmicDepth) {
+        // Only clip-space w matters; the shaders replace depth
+        return glm::infinitePerspective(fovy, aspect, zNear);
+    }
+    // Reverse-Z with the far plane at infinity: z_clip = zNear, w_clip = -z_eye,
+    // so depth = zNear / distance, 1 at the near plane falling to 0 at infinity
+    const float f = 1.0f / std::tan(0.5f * fovy);
+    glm::mat4 m(0.0f);
+    m[0][0] = f / aspect;
+    m[1][1] = f;
+    m[2][3] = -1.0f;
+    m[3][2] = zNear;
+    return m;
+}
+
+void DepthBuffer::beginFrame() const {
+    if (depthMode == DepthMode::ReverseZ) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glClearDepth(0.0);
+        glDepthFunc(GL_GREATER);
+    } else {
+        glClearDepth(1.0);
+        glDepthFunc(GL_LESS);
+    }
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void DepthBuffer::endFrame() const {
+    if (depthMode != DepthMode::ReverseZ) {
+        return;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
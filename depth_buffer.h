@@ -0,0 +1,49 @@
+#ifndef DEPTH_BUFFER_H
+#define DEPTH_BUFFER_H
+
+#include <GL/glew.h>
+#include "glm/glm/glm.hpp"
+
+// How depth is stored for scenes spanning centimetres to astronomical units
+enum class DepthMode {
+    ReverseZ,        // Float depth target, depth 1 at the near plane and 0 at infinity
+    LogarithmicDepth // Shader-written log depth, for contexts without glClipControl
+};
+
+// Single-pass depth for the whole scene.
+// With glClipControl (GL 4.5 or ARB_clip_control) depth maps to [0, 1] directly, and an
+// infinite reverse-Z projection into a 32-bit float depth buffer spreads precision
+// almost uniformly in relative terms: float's dense values near zero land on the far
+// distances that need them. The scene renders into an offscreen framebuffer with that
+// depth format and is blitted to the window.
+// Without clip control the depth range stays [-1, 1], which wastes reverse-Z, so
+// shaders compiled with shaderDefines() write gl_FragDepth = log2(1 + w) scaled to the
+// far distance instead.
+class DepthBuffer {
+public:
+    // Pick the mode and create the offscreen target; farDistance scales log depth
+    void init(int width, int height, double farDistance);
+    void destroy();
+
+    DepthMode mode() const { return depthMode; }
+    // Preprocessor lines to insert after each shader's #version
+    const char* shaderDefines() const;
+    // Value for the logDepthCoef uniform in logarithmic mode
+    float logDepthCoefficient() const { return logDepthCoef; }
+
+    // Infinite projection matching the mode; zNear may be tiny
+    glm::mat4 projection(float fovy, float aspect, float zNear) const;
+
+    // Bind the scene target and clear it with the mode's depth convention
+    void beginFrame() const;
+    // Copy the finished colour to the window's framebuffer
+    void endFrame() const;
+
+private:
+    DepthMode depthMode = DepthMode::LogarithmicDepth;
+    GLuint framebuffer = 0, colorBuffer = 0, depthRenderbuffer = 0;
+    int width = 0, height = 0;
+    float logDepthCoef = 0.0f;
+};
+
+#endif
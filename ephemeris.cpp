@@ -0,0 +1,321 @@
+#include "ephemeris.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Byte offsets of the fields in the header record
+static const size_t spanOffset = 2652;    // double[3]: start JD, end JD, days per record
+static const size_t nconOffset = 2676;    // int32: number of constants
+static const size_t auOffset = 2680;      // double
+static const size_t emratOffset = 2688;   // double
+static const size_t iptOffset = 2696;     // int32[12][3]: offset, coefficients, subintervals
+static const size_t numdeOffset = 2840;   // int32
+static const size_t lptOffset = 2844;     // int32[3]: librations, which share the layout
+static const size_t headerFieldsEnd = 2856;
+// Files with more than 400 constants list the rest of their names next, followed by the
+// lunar mantle (3 components) and TT-TDB (1 component) tables when present
+static const size_t constantNameBytes = 6;
+
+// Times evaluated side by side by the batch Clenshaw loops
+static const int lanes = 8;
+
+static std::uint32_t byteSwap32(std::uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xff00u) | ((v << 8) & 0xff0000u) | (v << 24);
+}
+
+static std::uint64_t byteSwap64(std::uint64_t v) {
+    return (std::uint64_t(byteSwap32(std::uint32_t(v))) << 32) | byteSwap32(std::uint32_t(v >> 32));
+}
+
+static std::int32_t readInt(const unsigned char* p, bool swap) {
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return std::int32_t(swap ? byteSwap32(v) : v);
+}
+
+static double readDouble(const unsigned char* p, bool swap) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    if (swap) {
+        v = byteSwap64(v);
+    }
+    double d;
+    std::memcpy(&d, &v, sizeof(d));
+    return d;
+}
+
+// Sum the Chebyshev series c[0..n) and its derivative at `count` points tc in [-1, 1],
+// position by Clenshaw over T_k and derivative by Clenshaw over k c_k U_{k-1}
+static void clenshaw(const double* c, int n, const double* tc, int count, double* value, double* derivative) {
+    double b1[lanes] = {}, b2[lanes] = {}, d1[lanes] = {}, d2[lanes] = {}, x2[lanes];
+    for (int l = 0; l < lanes; ++l) {
+        x2[l] = 2.0 * (l < count ? tc[l] : 0.0);
+    }
+    for (int k = n - 1; k >= 1; --k) {
+        const double ck = c[k], kck = k * c[k];
+        for (int l = 0; l < lanes; ++l) {
+            const double b = x2[l] * b1[l] - b2[l] + ck;
+            b2[l] = b1[l];
+            b1[l] = b;
+            const double d = x2[l] * d1[l] - d2[l] + kck;
+            d2[l] = d1[l];
+            d1[l] = d;
+        }
+    }
+    for (int l = 0; l < count; ++l) {
+        value[l] = 0.5 * x2[l] * b1[l] - b2[l] + c[0];
+        derivative[l] = d1[l];
+    }
+}
+
+bool ChebyshevEphemeris::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open ephemeris " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || size_t(info.st_size) < headerFieldsEnd) {
+        std::cerr << "Ephemeris " << path << " is truncated" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void* mapping = ::mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map ephemeris " << path << std::endl;
+        return false;
+    }
+    data = static_cast<const unsigned char*>(mapping);
+    length = size_t(info.st_size);
+
+    // The DE number tells the byte order: it is small in the right one
+    swapped = false;
+    deNumber = readInt(data + numdeOffset, false);
+    if (deNumber <= 0 || deNumber >= 10000) {
+        swapped = true;
+        deNumber = readInt(data + numdeOffset, true);
+    }
+    const char* problem = nullptr;
+    if (deNumber <= 0 || deNumber >= 10000) {
+        problem = "is not a JPL DE binary file";
+    }
+
+    // The record length is implied by the furthest coefficient any series uses
+    const int constants = problem ? 0 : readInt(data + nconOffset, swapped);
+    const size_t extraTables = headerFieldsEnd + size_t(std::max(0, std::min(constants, 100000) - 400)) * constantNameBytes;
+    int lastCoefficient = 0;
+    for (int i = 0; i < 15 && !problem; ++i) {
+        const unsigned char* p = i < 12 ? data + iptOffset + 12 * i
+                               : i == 12 ? data + lptOffset : data + extraTables + 12 * (i - 13);
+        if (i >= 13 && size_t(p - data) + 12 > length) {
+            break;
+        }
+        const int offset = readInt(p, swapped), coefficients = readInt(p + 4, swapped), subintervals = readInt(p + 8, swapped);
+        const int components = i == 11 ? 2 : i == 14 ? 1 : 3; // Nutations have two angles, TT-TDB one value
+        if (coefficients <= 0 || subintervals <= 0) {
+            continue; // Series the file does not carry
+        }
+        if (i >= 13 && (offset != lastCoefficient + 1 || coefficients > 1000 || subintervals > 1000)) {
+            continue; // Real optional tables follow straight on; older files have padding here
+        }
+        if (offset < 3 || coefficients < 1 || coefficients > 1000 || subintervals < 1 || subintervals > 1000) {
+            problem = "has a corrupt coefficient table";
+            break;
+        }
+        lastCoefficient = std::max(lastCoefficient, offset - 1 + coefficients * components * subintervals);
+        if (i < 11) {
+            series[i].offset = offset - 1;
+            series[i].coefficients = coefficients;
+            series[i].subintervals = subintervals;
+        }
+    }
+    if (!problem) {
+        span[0] = readDouble(data + spanOffset, swapped);
+        span[1] = readDouble(data + spanOffset + 8, swapped);
+        span[2] = readDouble(data + spanOffset + 16, swapped);
+        auKm = readDouble(data + auOffset, swapped);
+        emrat = readDouble(data + emratOffset, swapped);
+        recordDoubles = size_t(lastCoefficient);
+        const size_t recordBytes = recordDoubles * sizeof(double);
+        recordCount = recordBytes > 0 && length / recordBytes > 2 ? length / recordBytes - 2 : 0;
+        if (recordCount == 0 || !(span[2] > 0.0) || !(span[1] > span[0]) || !(emrat > 0.0)) {
+            problem = "holds no usable records";
+        } else {
+            // Trust the records actually present over the advertised span
+            span[1] = std::min(span[1], span[0] + double(recordCount) * span[2]);
+        }
+    }
+    if (problem) {
+        std::cerr << "Ephemeris " << path << " " << problem << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ChebyshevEphemeris::close() {
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cache.clear();
+    }
+    if (data) {
+        ::munmap(const_cast<unsigned char*>(data), length);
+        data = nullptr;
+        length = 0;
+    }
+    for (Series& s : series) {
+        s = Series();
+    }
+    recordCount = 0;
+}
+
+size_t ChebyshevEphemeris::recordFor(double jd) const {
+    const double index = std::floor((jd - span[0]) / span[2]);
+    return index <= 0.0 ? 0 : std::min(size_t(index), recordCount - 1);
+}
+
+// Native-endian copy of a data record, from the cache when possible
+ChebyshevEphemeris::Record ChebyshevEphemeris::record(size_t index) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    for (size_t i = cache.size(); i-- > 0;) {
+        if (cache[i].first == index) {
+            std::rotate(cache.begin() + i, cache.begin() + i + 1, cache.end());
+            return cache.back().second;
+        }
+    }
+    std::shared_ptr<std::vector<double>> values = std::make_shared<std::vector<double>>(recordDoubles);
+    const unsigned char* p = data + (index + 2) * recordDoubles * sizeof(double);
+    for (size_t k = 0; k < recordDoubles; ++k) {
+        (*values)[k] = readDouble(p + k * sizeof(double), swapped);
+    }
+    ++decoded;
+    if (cache.size() >= std::max<size_t>(cacheRecords, 1)) {
+        cache.erase(cache.begin());
+    }
+    cache.emplace_back(index, values);
+    return values;
+}
+
+size_t ChebyshevEphemeris::accumulateSeries(int index, double weight, const double* jd, size_t count,
+                                            double* x, double* y, double* z, double* vx, double* vy, double* vz) {
+    const Series& s = series[index];
+    if (s.coefficients == 0) {
+        return 0;
+    }
+    const int n = s.coefficients;
+    const double subLength = span[2] / s.subintervals;
+    const double velocityScale = weight * 2.0 / subLength / 86400.0; // d/dtc to km/s
+    double* out[6] = {x, y, z, vx, vy, vz};
+    size_t inside = 0;
+    Record current;
+    size_t currentIndex = 0;
+    size_t i = 0;
+    while (i < count) {
+        if (!(jd[i] >= span[0] && jd[i] <= span[1])) {
+            for (double* o : out) {
+                if (o) {
+                    o[i] = std::numeric_limits<double>::quiet_NaN();
+                }
+            }
+            ++i;
+            continue;
+        }
+        const size_t r = recordFor(jd[i]);
+        if (!current || r != currentIndex) {
+            current = record(r);
+            currentIndex = r;
+        }
+        const double recordStart = (*current)[0];
+        const int sub = std::min(std::max(int((jd[i] - recordStart) / subLength), 0), s.subintervals - 1);
+        const double subStart = recordStart + sub * subLength;
+
+        // Gather the following times that share this subinterval, up to a full set of lanes
+        double tc[lanes];
+        tc[0] = 2.0 * std::min(std::max((jd[i] - subStart) / subLength, 0.0), 1.0) - 1.0;
+        int run = 1;
+        while (run < lanes && i + run < count) {
+            const double t = jd[i + run];
+            const double u = (t - subStart) / subLength;
+            if (!(t >= span[0] && t <= span[1]) || recordFor(t) != r || !(u >= 0.0 && (u < 1.0 || sub == s.subintervals - 1))) {
+                break;
+            }
+            tc[run++] = 2.0 * u - 1.0;
+        }
+
+        const double* coefficients = current->data() + s.offset + size_t(sub) * 3 * n;
+        double value[lanes], derivative[lanes];
+        for (int c = 0; c < 3; ++c) {
+            clenshaw(coefficients + c * n, n, tc, run, value, derivative);
+            for (int l = 0; l < run; ++l) {
+                out[c][i + l] += weight * value[l];
+                if (out[c + 3]) {
+                    out[c + 3][i + l] += velocityScale * derivative[l];
+                }
+            }
+        }
+        inside += run;
+        i += run;
+    }
+    return inside;
+}
+
+size_t ChebyshevEphemeris::accumulate(EphemerisBody body, double weight, const double* jd, size_t count,
+                                      double* x, double* y, double* z, double* vx, double* vy, double* vz) {
+    const int emb = int(EphemerisBody::EarthMoonBarycenter), moon = int(EphemerisBody::Moon);
+    switch (body) {
+    case EphemerisBody::SolarSystemBarycenter:
+        return count;
+    case EphemerisBody::Earth:
+        accumulateSeries(moon, -weight / (1.0 + emrat), jd, count, x, y, z, vx, vy, vz);
+        return accumulateSeries(emb, weight, jd, count, x, y, z, vx, vy, vz);
+    case EphemerisBody::Moon:
+        // The file's Moon is geocentric
+        accumulateSeries(moon, weight * emrat / (1.0 + emrat), jd, count, x, y, z, vx, vy, vz);
+        return accumulateSeries(emb, weight, jd, count, x, y, z, vx, vy, vz);
+    default:
+        return accumulateSeries(int(body), weight, jd, count, x, y, z, vx, vy, vz);
+    }
+}
+
+size_t ChebyshevEphemeris::states(EphemerisBody body, EphemerisBody center, const double* jd, size_t count,
+                                  double* x, double* y, double* z, double* vx, double* vy, double* vz) {
+    if (!data) {
+        return 0;
+    }
+    double* out[6] = {x, y, z, vx, vy, vz};
+    for (double* o : out) {
+        if (o) {
+            std::fill(o, o + count, 0.0);
+        }
+    }
+    // Geocentric Moon is stored directly; skip the round trip through the barycentre
+    if (body == EphemerisBody::Moon && center == EphemerisBody::Earth) {
+        return accumulateSeries(int(EphemerisBody::Moon), 1.0, jd, count, x, y, z, vx, vy, vz);
+    }
+    size_t inside = accumulate(body, 1.0, jd, count, x, y, z, vx, vy, vz);
+    if (center != body) {
+        accumulate(center, -1.0, jd, count, x, y, z, vx, vy, vz);
+    }
+    return inside;
+}
+
+bool ChebyshevEphemeris::state(EphemerisBody body, EphemerisBody center, double jd, double position[3], double velocity[3]) {
+    double vx = 0.0, vy = 0.0, vz = 0.0;
+    if (states(body, center, &jd, 1, &position[0], &position[1], &position[2], &vx, &vy, &vz) != 1) {
+        return false;
+    }
+    if (velocity) {
+        velocity[0] = vx;
+        velocity[1] = vy;
+        velocity[2] = vz;
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Bodies in a JPL DE file. The first eleven are the file's own series in file order
+// (the Moon series is geocentric, the rest barycentric); Earth is derived from the
+// Earth-Moon barycentre and the Moon.
+enum class EphemerisBody {
+    Mercury, Venus, EarthMoonBarycenter, Mars, Jupiter, Saturn, Uranus, Neptune, Pluto, Moon, Sun,
+    Earth,
+    SolarSystemBarycenter
+};
+
+// Reader for JPL DE binary ephemerides (DE405, DE430, DE440, ...), either byte order.
+//
+// The file is a header record, a record of constant values and then fixed-length data
+// records, each covering the same span of days. A record holds, per body, a number of
+// equal subintervals with a block of Chebyshev coefficients per coordinate. The file
+// is memory-mapped; records are converted to native doubles on first use and kept in
+// a small LRU cache shared by all threads.
+//
+// Positions are km in the ICRF (equatorial J2000) frame, velocities km/s, and times
+// are TDB Julian dates. Series are summed with Clenshaw recurrences, position and
+// derivative together; batch queries evaluate runs of times that fall in the same
+// subinterval side by side in fixed-width lanes the compiler vectorizes.
+class ChebyshevEphemeris {
+public:
+    size_t cacheRecords = 16;
+
+    ChebyshevEphemeris() = default;
+    ChebyshevEphemeris(const ChebyshevEphemeris&) = delete;
+    ChebyshevEphemeris& operator=(const ChebyshevEphemeris&) = delete;
+    ~ChebyshevEphemeris() { close(); }
+
+    bool open(const char* path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+
+    int number() const { return deNumber; }  // e.g. 440
+    double startJd() const { return span[0]; }
+    double endJd() const { return span[1]; }
+    double au() const { return auKm; }
+    double earthMoonMassRatio() const { return emrat; }
+
+    // State of body relative to center; false outside the file's span
+    bool state(EphemerisBody body, EphemerisBody center, double jd, double position[3], double velocity[3]);
+
+    // The same for count times; outputs are SoA and velocities may be null. Returns
+    // the number of times inside the file's span; the others come out as NaN.
+    size_t states(EphemerisBody body, EphemerisBody center, const double* jd, size_t count,
+                  double* x, double* y, double* z, double* vx, double* vy, double* vz);
+
+    long long recordsDecoded() const { return decoded; }
+
+private:
+    // Where a series lives in each record
+    struct Series {
+        int offset = 0;          // First coefficient, in doubles from the record start
+        int coefficients = 0;    // Per coordinate
+        int subintervals = 0;
+    };
+    typedef std::shared_ptr<const std::vector<double>> Record;
+
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+    bool swapped = false;
+    int deNumber = 0;
+    double span[3] = {0.0, 0.0, 0.0}; // Start, end, days per record
+    double auKm = 0.0, emrat = 0.0;
+    Series series[11];
+    size_t recordDoubles = 0;
+    size_t recordCount = 0;
+
+    std::mutex cacheMutex;
+    std::vector<std::pair<size_t, Record>> cache; // Most recently used last
+    std::atomic<long long> decoded{0};
+
+    Record record(size_t index);
+    size_t recordFor(double jd) const;
+    // Add weight times the state of one file series (or a derived body) into the outputs
+    size_t accumulate(EphemerisBody body, double weight, const double* jd, size_t count,
+                      double* x, double* y, double* z, double* vx, double* vy, double* vz);
+    size_t accumulateSeries(int index, double weight, const double* jd, size_t count,
+                            double* x, double* y, double* z, double* vx, double* vy, double* vz);
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "gpu_nbody.h"
+#include "shader.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Accelerations, plus a half kick so the closing kick of a step needs no extra pass.
+// Sources past the end are padded with zero mass; a zero separation (the body itself
+// without softening) contributes nothing.
+static const char* forceShaderSource = R"(
+#version 430 core
+layout(local_size_x = 256) in;
+layout(std430, binding = 0) buffer Positions { vec4 positions[]; };
+layout(std430, binding = 1) buffer Velocities { vec4 velocities[]; };
+layout(std430, binding = 2) buffer Accelerations { vec4 accelerations[]; };
+uniform uint bodyCount;
+uniform float G;
+uniform float eps2;
+uniform float halfStep;
+
+shared vec4 tile[256];
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    vec3 p = i < bodyCount ? positions[i].xyz : vec3(0.0);
+    vec3 a = vec3(0.0);
+    for (uint base = 0u; base < bodyCount; base += 256u) {
+        uint j = base + gl_LocalInvocationID.x;
+        tile[gl_LocalInvocationID.x] = j < bodyCount ? positions[j] : vec4(0.0);
+        barrier();
+        for (uint k = 0u; k < 256u; ++k) {
+            vec4 source = tile[k];
+            vec3 d = source.xyz - p;
+            float r2 = dot(d, d) + eps2;
+            float invR = r2 > 0.0 ? inversesqrt(r2) : 0.0;
+            a += (source.w * invR * invR * invR) * d;
+        }
+        barrier();
+    }
+    if (i < bodyCount) {
+        a *= G;
+        accelerations[i] = vec4(a, 0.0);
+        velocities[i].xyz += halfStep * a;
+    }
+}
+)";
+
+// Opening half kick and the drift
+static const char* driftShaderSource = R"(
+#version 430 core
+layout(local_size_x = 256) in;
+layout(std430, binding = 0) buffer Positions { vec4 positions[]; };
+layout(std430, binding = 1) buffer Velocities { vec4 velocities[]; };
+layout(std430, binding = 2) buffer Accelerations { vec4 accelerations[]; };
+uniform uint bodyCount;
+uniform float halfStep;
+uniform float dt;
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= bodyCount) {
+        return;
+    }
+    vec3 v = velocities[i].xyz + halfStep * accelerations[i].xyz;
+    velocities[i].xyz = v;
+    positions[i].xyz += dt * v;
+}
+)";
+
+bool GpuGravity::init() {
+    destroy();
+    if (!GLEW_VERSION_4_3) {
+        std::cerr << "Compute shaders need OpenGL 4.3" << std::endl;
+        return false;
+    }
+    forceProgram = createComputeProgram(forceShaderSource);
+    driftProgram = createComputeProgram(driftShaderSource);
+    if (!forceProgram || !driftProgram) {
+        destroy();
+        return false;
+    }
+    glGenBuffers(3, buffers);
+    return true;
+}
+
+void GpuGravity::destroy() {
+    if (forceProgram) {
+        glDeleteProgram(forceProgram);
+    }
+    if (driftProgram) {
+        glDeleteProgram(driftProgram);
+    }
+    if (buffers[0]) {
+        glDeleteBuffers(3, buffers);
+    }
+    forceProgram = driftProgram = 0;
+    buffers[0] = buffers[1] = buffers[2] = 0;
+    bodies = capacity = 0;
+    accelerationsValid = false;
+}
+
+void GpuGravity::reserve(size_t n) {
+    bodies = n;
+    if (n <= capacity) {
+        return;
+    }
+    capacity = n;
+    for (GLuint buffer : buffers) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * 4 * sizeof(float), NULL, GL_DYNAMIC_COPY);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuGravity::upload(const BodySystem& s) {
+    const size_t n = s.size();
+    reserve(n);
+    std::vector<float> positions(n * 4), velocities(n * 4);
+    for (size_t i = 0; i < n; ++i) {
+        positions[4 * i] = (float)s.x[i];
+        positions[4 * i + 1] = (float)s.y[i];
+        positions[4 * i + 2] = (float)s.z[i];
+        positions[4 * i + 3] = (float)s.mass[i];
+        velocities[4 * i] = (float)s.vx[i];
+        velocities[4 * i + 1] = (float)s.vy[i];
+        velocities[4 * i + 2] = (float)s.vz[i];
+        velocities[4 * i + 3] = 0.0f;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, n * 4 * sizeof(float), positions.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[1]);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, n * 4 * sizeof(float), velocities.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    simTime = s.time;
+    accelerationsValid = false;
+}
+
+void GpuGravity::download(BodySystem& s) const {
+    const size_t n = bodies;
+    std::vector<float> data(n * 4);
+    std::vector<double>* targets[3][3] = {{&s.x, &s.y, &s.z}, {&s.vx, &s.vy, &s.vz}, {&s.ax, &s.ay, &s.az}};
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    for (int b = 0; b < 3; ++b) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[b]);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, n * 4 * sizeof(float), data.data());
+        for (int c = 0; c < 3; ++c) {
+            std::vector<double>& out = *targets[b][c];
+            out.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                out[i] = data[4 * i + c];
+            }
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    s.time = simTime;
+    s.accelerationsValid = accelerationsValid;
+}
+
+void GpuGravity::forcePass(float halfStep) {
+    for (GLuint b = 0; b < 3; ++b) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, buffers[b]);
+    }
+    glUseProgram(forceProgram);
+    glUniform1ui(glGetUniformLocation(forceProgram, "bodyCount"), GLuint(bodies));
+    glUniform1f(glGetUniformLocation(forceProgram, "G"), (float)G);
+    glUniform1f(glGetUniformLocation(forceProgram, "eps2"), (float)(softening * softening));
+    glUniform1f(glGetUniformLocation(forceProgram, "halfStep"), halfStep);
+    glDispatchCompute(GLuint((bodies + tileSize - 1) / tileSize), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    accelerationsValid = true;
+}
+
+void GpuGravity::step(double dt, int steps) {
+    if (bodies == 0) {
+        return;
+    }
+    if (!accelerationsValid) {
+        forcePass(0.0f);
+    }
+    const GLuint groups = GLuint((bodies + tileSize - 1) / tileSize);
+    const GLint countLocation = glGetUniformLocation(driftProgram, "bodyCount");
+    const GLint halfStepLocation = glGetUniformLocation(driftProgram, "halfStep");
+    const GLint dtLocation = glGetUniformLocation(driftProgram, "dt");
+    for (int k = 0; k < steps; ++k) {
+        glUseProgram(driftProgram);
+        glUniform1ui(countLocation, GLuint(bodies));
+        glUniform1f(halfStepLocation, (float)(0.5 * dt));
+        glUniform1f(dtLocation, (float)dt);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        forcePass((float)(0.5 * dt));
+        simTime += dt;
+    }
+    glUseProgram(0);
+}
+
+void GpuGravity::accelerations(size_t n, const double* x, const double* y, const double* z, const double* m,
+                               double* ax, double* ay, double* az) {
+    reserve(n);
+    std::vector<float> data(n * 4);
+    for (size_t i = 0; i < n; ++i) {
+        data[4 * i] = (float)x[i];
+        data[4 * i + 1] = (float)y[i];
+        data[4 * i + 2] = (float)z[i];
+        data[4 * i + 3] = (float)m[i];
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[0]);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, n * 4 * sizeof(float), data.data());
+    forcePass(0.0f);
+    glUseProgram(0);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[2]);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, n * 4 * sizeof(float), data.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    for (size_t i = 0; i < n; ++i) {
+        ax[i] = data[4 * i];
+        ay[i] = data[4 * i + 1];
+        az[i] = data[4 * i + 2];
+    }
+}
+
+void GpuGravity::bindPositionAttribute(GLuint vao, GLuint location) const {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(location);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,69 @@
+#ifndef GPU_NBODY_H
+#define GPU_NBODY_H
+
+#include "nbody.h"
+#include <GL/glew.h>
+#include <cstddef>
+
+// Direct-summation gravity and kick-drift-kick leapfrog in GL compute shaders (GL 4.3).
+//
+// Bodies live in shader storage buffers of vec4s: position and mass, velocity, and the
+// last acceleration. The force pass gives each work group a block of targets and walks
+// the sources a tile at a time: every invocation loads one source into shared memory,
+// then the whole group sums that tile from shared memory before loading the next, so
+// each source is read from the buffer once per group rather than once per target.
+//
+// Arithmetic is single precision on the device; the system time stays double on the
+// host. The position buffer can be bound straight into a vertex array, so a renderer
+// draws the bodies where the last step left them without reading anything back.
+class GpuGravity {
+public:
+    double G = 1.0;
+    double softening = 0.0; // Plummer softening length
+
+    GpuGravity() = default;
+    GpuGravity(const GpuGravity&) = delete;
+    GpuGravity& operator=(const GpuGravity&) = delete;
+    ~GpuGravity() { destroy(); }
+
+    // Compile the compute programs; false without GL 4.3 or if a shader fails
+    bool init();
+    void destroy();
+
+    // Copy a system to the device; the next step starts with a force evaluation
+    void upload(const BodySystem& s);
+    // Copy positions, velocities, accelerations and time back
+    void download(BodySystem& s) const;
+
+    // Advance the uploaded system by steps leapfrog steps of dt
+    void step(double dt, int steps = 1);
+
+    // One force evaluation on the given SoA data, for comparison with DirectGravity.
+    // Replaces the uploaded system's positions and masses.
+    void accelerations(size_t n, const double* x, const double* y, const double* z, const double* m,
+                       double* ax, double* ay, double* az);
+
+    size_t size() const { return bodies; }
+    double time() const { return simTime; }
+    // Buffer of vec4 (x, y, z, mass) per body
+    GLuint positionBuffer() const { return buffers[0]; }
+    // Source a vertex array's attribute from the position buffer; call memoryBarrier()
+    // before drawing after a step
+    void bindPositionAttribute(GLuint vao, GLuint location) const;
+    void memoryBarrier() const { glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT); }
+
+private:
+    static const unsigned tileSize = 256; // Work group size and shared-memory tile, in bodies
+
+    GLuint forceProgram = 0, driftProgram = 0;
+    GLuint buffers[3] = {0, 0, 0}; // Positions and masses, velocities, accelerations
+    size_t bodies = 0, capacity = 0;
+    double simTime = 0.0;
+    bool accelerationsValid = false;
+
+    void reserve(size_t n);
+    // Accelerations at the current positions, with velocities kicked by halfStep
+    void forcePass(float halfStep);
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "ias15.h"
+
+// Build the conversion tables from the Gauss-Radau spacings once
+static Ias15Tables buildIas15Tables() {
+    Ias15Tables t = {};
+    const double h[8] = {0.0,
+                         0.0562625605369221464656521910318,
+                         0.180240691736892364987579942780,
+                         0.352624717113169637373907769648,
+                         0.547153626330555383001448554766,
+                         0.734210177215410531523210605558,
+                         0.885320946839095768090359771030,
+                         0.977520613561287501891174488626};
+    for (int i = 0; i < 8; ++i) {
+        t.h[i] = h[i];
+    }
+
+    // Column k of c holds the monomial coefficients of prod_{m=1..k} (x - h[m])
+    double poly[8] = {1.0};
+    for (int k = 0; k < 7; ++k) {
+        for (int j = 0; j < 7; ++j) {
+            t.c[j][k] = poly[j];
+        }
+        // Multiply by (x - h[k + 1])
+        for (int j = 7; j > 0; --j) {
+            poly[j] = poly[j - 1] - h[k + 1] * poly[j];
+        }
+        poly[0] = -h[k + 1] * poly[0];
+    }
+
+    // Column j of d expresses x^j in the Newton basis N_k = prod_{m=1..k} (x - h[m]),
+    // using x * N_k = N_{k+1} + h[k + 1] * N_k
+    double newton[8] = {1.0};
+    for (int j = 0; j < 7; ++j) {
+        for (int k = 0; k < 7; ++k) {
+            t.d[k][j] = newton[k];
+        }
+        double next[8] = {};
+        for (int k = 0; k < 7; ++k) {
+            next[k + 1] += newton[k];
+            next[k] += h[k + 1] * newton[k];
+        }
+        for (int k = 0; k < 8; ++k) {
+            newton[k] = next[k];
+        }
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        t.binom[i][0] = 1.0;
+        for (int j = 1; j <= i; ++j) {
+            t.binom[i][j] = t.binom[i - 1][j - 1] + (j < i ? t.binom[i - 1][j] : 0.0);
+        }
+    }
+    return t;
+}
+
+const Ias15Tables& ias15Tables() {
+    static const Ias15Tables tables = buildIas15Tables();
+    return tables;
+}
@@ -0,0 +1,392 @@
+#ifndef IAS15_H
+#define IAS15_H
+
+#include "nbody.h"
+#include <cmath>
+#include <vector>
+
+// Spacings and conversion matrices of the 15th-order Gauss-Radau scheme.
+// g holds the divided differences of the acceleration at the substeps, b the
+// equivalent power-series coefficients; c maps g -> b and d maps b -> g.
+struct Ias15Tables {
+    double h[8];
+    double c[7][7]; // b[j] = sum_k c[j][k] * g[k]
+    double d[7][7]; // g[k] = sum_j d[k][j] * b[j]
+    double binom[8][8];
+};
+
+const Ias15Tables& ias15Tables();
+
+// IAS15-style adaptive integrator (Rein & Spiegel 2015) over SoA body storage.
+// State is packed per component (all x, then all y, then all z) into workspaces
+// that only grow in reserve()/gather, so accepted and rejected steps never allocate.
+template <class Force>
+class Ias15Integrator {
+public:
+    double epsilon = 1e-9;  // Relative tolerance on the last series coefficient
+    double minDt = 0.0;     // Steps are never shrunk below this (0 disables the floor)
+    double dt = 0.0;        // Suggested size of the next step; 0 picks one from the state
+    int acceptedSteps = 0;
+    int rejectedSteps = 0;
+    bool failed = false;    // The last call met non-finite forces at every step size and stopped short
+
+    void reserve(size_t n) {
+        const size_t n3 = 3 * n;
+        x0.reserve(n3); v0.reserve(n3); a0.reserve(n3); xs.reserve(n3); as.reserve(n3);
+        mass.reserve(n); order.reserve(n); packing.reserve(n); fieldMark.reserve(n);
+        for (int k = 0; k < 7; ++k) {
+            g[k].reserve(n3); b[k].reserve(n3); e[k].reserve(n3); br[k].reserve(n3); er[k].reserve(n3);
+        }
+    }
+
+    // Integrate every body up to exactly tEnd
+    void integrate(BodySystem& s, const Force& force, double tEnd) {
+        gather(s, nullptr, 0);
+        const double reached = run(s.time, tEnd, force);
+        scatter(s);
+        s.time = failed ? reached : tEnd;
+        s.accelerationsValid = false;
+    }
+
+    // Integrate only the bodies listed in subset (e.g. a close pair during a flyby) up to tEnd.
+    // The remaining bodies act as fixed field sources at their current positions; the caller
+    // is expected to advance them with its main integrator. BodySystem::time is left untouched.
+    void integrateSubset(BodySystem& s, const Force& force, const size_t* subset, size_t count, double tEnd) {
+        gather(s, subset, count);
+        run(s.time, tEnd, force);
+        scatter(s);
+        s.accelerationsValid = false;
+    }
+
+    // Step size, counters and the series predictions carried between calls, flattened for
+    // checkpoints. Restoring them makes the next integrate() continue bit for bit.
+    void saveState(std::vector<double>& out) const {
+        out.clear();
+        out.push_back(double(n)); out.push_back(double(active));
+        out.push_back(dt); out.push_back(dtLastSuccess);
+        out.push_back(double(acceptedSteps)); out.push_back(double(rejectedSteps));
+        for (size_t i = 0; i < n; ++i) {
+            out.push_back(double(order[i]));
+        }
+        for (const std::vector<double>* series : {b, e, br, er}) {
+            for (int k = 0; k < 7; ++k) {
+                out.insert(out.end(), series[k].begin(), series[k].end());
+            }
+        }
+    }
+
+    bool loadState(const std::vector<double>& in) {
+        if (in.size() < 6) {
+            return false;
+        }
+        const size_t count = size_t(in[0]);
+        if (in.size() != 6 + count + 4 * 7 * 3 * count) {
+            return false;
+        }
+        n = count;
+        active = size_t(in[1]);
+        dt = in[2];
+        dtLastSuccess = in[3];
+        acceptedSteps = int(in[4]);
+        rejectedSteps = int(in[5]);
+        const double* p = in.data() + 6;
+        order.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            order[i] = size_t(*p++);
+        }
+        for (std::vector<double>* series : {b, e, br, er}) {
+            for (int k = 0; k < 7; ++k) {
+                series[k].assign(p, p + 3 * n);
+                p += 3 * n;
+            }
+        }
+        return true;
+    }
+
+private:
+    size_t n = 0;      // Bodies in the packed state
+    size_t active = 0; // Leading bodies that are integrated
+    std::vector<size_t> order; // Packed slot -> body index
+    std::vector<size_t> packing;
+    std::vector<char> fieldMark;
+    std::vector<double> mass;
+    std::vector<double> x0, v0, a0, xs, as;
+    std::vector<double> g[7], b[7], e[7], br[7], er[7];
+    double dtLastSuccess = 0.0;
+
+    double* comp(std::vector<double>& v, int c) { return v.data() + c * n; }
+
+    void gather(const BodySystem& s, const size_t* subset, size_t count) {
+        const size_t total = s.size();
+        const size_t newActive = subset ? count : total;
+        // Pack the integrated bodies first, then the field bodies
+        packing.clear();
+        if (subset) {
+            fieldMark.assign(total, 0);
+            for (size_t i = 0; i < count; ++i) {
+                fieldMark[subset[i]] = 1;
+                packing.push_back(subset[i]);
+            }
+            for (size_t i = 0; i < total; ++i) {
+                if (!fieldMark[i]) {
+                    packing.push_back(i);
+                }
+            }
+        } else {
+            for (size_t i = 0; i < total; ++i) {
+                packing.push_back(i);
+            }
+        }
+        const bool sameLayout = newActive == active && packing == order;
+        order.swap(packing);
+
+        n = total;
+        active = subset ? count : total;
+        const size_t n3 = 3 * n;
+        x0.resize(n3); v0.resize(n3); a0.resize(n3); xs.resize(n3); as.resize(n3);
+        mass.resize(n);
+        for (int k = 0; k < 7; ++k) {
+            g[k].resize(n3); b[k].resize(n3); e[k].resize(n3); br[k].resize(n3); er[k].resize(n3);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const size_t src = order[i];
+            mass[i] = s.mass[src];
+            x0[i] = s.x[src]; x0[n + i] = s.y[src]; x0[2 * n + i] = s.z[src];
+            v0[i] = s.vx[src]; v0[n + i] = s.vy[src]; v0[2 * n + i] = s.vz[src];
+        }
+        // Field bodies never move inside a step, so their substep positions are fixed once
+        xs = x0;
+
+        if (!sameLayout) {
+            // Predictions from a different body layout are meaningless
+            for (int k = 0; k < 7; ++k) {
+                std::fill(b[k].begin(), b[k].end(), 0.0);
+                std::fill(e[k].begin(), e[k].end(), 0.0);
+                std::fill(br[k].begin(), br[k].end(), 0.0);
+                std::fill(er[k].begin(), er[k].end(), 0.0);
+            }
+            dtLastSuccess = 0.0;
+        }
+    }
+    void scatter(BodySystem& s) const {
+        for (size_t i = 0; i < active; ++i) {
+            const size_t dst = order[i];
+            s.x[dst] = x0[i]; s.y[dst] = x0[n + i]; s.z[dst] = x0[2 * n + i];
+            s.vx[dst] = v0[i]; s.vy[dst] = v0[n + i]; s.vz[dst] = v0[2 * n + i];
+        }
+    }
+
+    void evaluate(const Force& force, std::vector<double>& pos, std::vector<double>& acc) {
+        force(active, n, comp(pos, 0), comp(pos, 1), comp(pos, 2), mass.data(),
+              comp(acc, 0), comp(acc, 1), comp(acc, 2));
+    }
+
+    // Apply f to the packed index of every integrated component
+    template <class F>
+    void forEachActive(F f) const {
+        for (size_t c = 0; c < 3; ++c) {
+            const size_t o = c * n;
+            for (size_t i = 0; i < active; ++i) {
+                f(o + i);
+            }
+        }
+    }
+
+    double maxAbs(const std::vector<double>& v) const {
+        double m = 0.0;
+        forEachActive([&](size_t i) { m = std::fmax(m, std::fabs(v[i])); });
+        return m;
+    }
+
+    // fmax skips NaN, so non-finite values need a check of their own
+    bool allFinite(const std::vector<double>& v) const {
+        bool finite = true;
+        forEachActive([&](size_t i) { finite = finite && std::isfinite(v[i]); });
+        return finite;
+    }
+
+    double initialStep(const Force& force) {
+        evaluate(force, x0, a0);
+        double d0 = 0.0, d1 = 0.0;
+        forEachActive([&](size_t i) {
+            d0 = std::fmax(d0, std::fabs(v0[i]));
+            d1 = std::fmax(d1, std::fabs(a0[i]));
+        });
+        if (d0 <= 0.0 || d1 <= 0.0) {
+            return 1e-3;
+        }
+        return 0.01 * d0 / d1;
+    }
+
+    // Returns the time reached, which is tEnd unless the integration failed
+    double run(double t, double tEnd, const Force& force) {
+        failed = false;
+        if (active == 0 || tEnd == t) {
+            return t;
+        }
+        const double direction = tEnd > t ? 1.0 : -1.0;
+        if (dt == 0.0 || dt * direction < 0.0) {
+            dt = direction * initialStep(force);
+        }
+        while ((tEnd - t) * direction > 0.0) {
+            double remaining = tEnd - t;
+            bool clamped = std::fabs(dt) > std::fabs(remaining);
+            double suggested = dt;
+            if (clamped) {
+                dt = remaining;
+            }
+            double taken = dt;
+            if (attemptStep(force)) {
+                t += taken;
+                // A step shortened only to land on tEnd says nothing about the natural step size
+                if (clamped && std::fabs(dt) > std::fabs(suggested)) {
+                    dt = suggested;
+                }
+            } else if (t + dt == t) {
+                // Still not finite with a step too small to move the clock
+                failed = true;
+                break;
+            }
+        }
+        return t;
+    }
+
+    // One predictor-corrector step of size dt; adapts dt and returns false on rejection
+    bool attemptStep(const Force& force) {
+        const Ias15Tables& T = ias15Tables();
+        evaluate(force, x0, a0);
+
+        // g follows from the predicted b
+        forEachActive([&](size_t i) {
+            for (int k = 0; k < 7; ++k) {
+                double sum = 0.0;
+                for (int j = k; j < 7; ++j) {
+                    sum += T.d[k][j] * b[j][i];
+                }
+                g[k][i] = sum;
+            }
+        });
+
+        double previousError = 2.0;
+        for (int iteration = 0; iteration < 12; ++iteration) {
+            double maxDelta6 = 0.0;
+            for (int sub = 1; sub < 8; ++sub) {
+                const double hs = T.h[sub];
+                const double hdt = hs * dt;
+                forEachActive([&](size_t i) {
+                    xs[i] = x0[i] + hdt * v0[i] + hdt * hdt * (a0[i] / 2.0 + hs * (b[0][i] / 6.0 + hs * (b[1][i] / 12.0
+                          + hs * (b[2][i] / 20.0 + hs * (b[3][i] / 30.0 + hs * (b[4][i] / 42.0 + hs * (b[5][i] / 56.0
+                          + hs * b[6][i] / 72.0)))))));
+                });
+                evaluate(force, xs, as);
+
+                // Divided difference for this substep, then fold the change into b
+                const int k = sub - 1;
+                forEachActive([&](size_t i) {
+                    double tmp = (as[i] - a0[i]) / hs;
+                    for (int m = 1; m < sub; ++m) {
+                        tmp = (tmp - g[m - 1][i]) / (hs - T.h[m]);
+                    }
+                    double delta = tmp - g[k][i];
+                    g[k][i] = tmp;
+                    for (int j = 0; j <= k; ++j) {
+                        b[j][i] += T.c[j][k] * delta;
+                    }
+                    if (k == 6) {
+                        maxDelta6 = std::fmax(maxDelta6, std::fabs(delta));
+                    }
+                });
+            }
+            double maxA = maxAbs(as);
+            double error = maxA > 0.0 ? maxDelta6 / maxA : 0.0;
+            if (error < 1e-16 || (iteration > 2 && error >= previousError)) {
+                break;
+            }
+            previousError = error;
+        }
+
+        // Step size control from the size of the highest-order term
+        double maxB6 = maxAbs(b[6]);
+        double maxA = maxAbs(as);
+        double integratorError = maxA > 0.0 ? maxB6 / maxA : 0.0;
+        const double safety = 0.25;
+        bool finite = std::isfinite(integratorError) && allFinite(a0) && allFinite(as);
+        for (int k = 0; k < 7 && finite; ++k) {
+            finite = allFinite(b[k]);
+        }
+        double dtNew;
+        if (finite && integratorError > 0.0) {
+            dtNew = dt * std::pow(epsilon / integratorError, 1.0 / 7.0);
+        } else if (finite) {
+            dtNew = dt / safety;
+        } else {
+            dtNew = dt * safety;
+        }
+        if (finite && minDt > 0.0 && std::fabs(dtNew) < minDt) {
+            dtNew = std::copysign(minDt, dtNew);
+        }
+
+        // A non-finite force or series is always rejected, below the minDt floor if need be
+        if (!finite || (std::fabs(dtNew / dt) < safety && std::fabs(dt) > minDt)) {
+            // Reject: retry from the saved predictions with the smaller step
+            dt = dtNew;
+            if (dtLastSuccess != 0.0) {
+                predictNextStep(dt / dtLastSuccess, br, er);
+            } else {
+                for (int k = 0; k < 7; ++k) {
+                    forEachActive([&](size_t i) { b[k][i] = 0.0; });
+                }
+            }
+            ++rejectedSteps;
+            return false;
+        }
+        if (std::fabs(dtNew / dt) > 1.0 / safety) {
+            dtNew = dt / safety;
+        }
+
+        // Accept: evaluate the series at the end of the step
+        const double dtDone = dt;
+        forEachActive([&](size_t i) {
+            x0[i] += dtDone * v0[i] + dtDone * dtDone * (a0[i] / 2.0 + b[0][i] / 6.0 + b[1][i] / 12.0 + b[2][i] / 20.0
+                   + b[3][i] / 30.0 + b[4][i] / 42.0 + b[5][i] / 56.0 + b[6][i] / 72.0);
+            v0[i] += dtDone * (a0[i] + b[0][i] / 2.0 + b[1][i] / 3.0 + b[2][i] / 4.0 + b[3][i] / 5.0
+                   + b[4][i] / 6.0 + b[5][i] / 7.0 + b[6][i] / 8.0);
+        });
+        for (int k = 0; k < 7; ++k) {
+            forEachActive([&](size_t i) {
+                br[k][i] = b[k][i];
+                er[k][i] = e[k][i];
+            });
+        }
+        dtLastSuccess = dtDone;
+        dt = dtNew;
+        predictNextStep(dt / dtDone, b, e);
+        ++acceptedSteps;
+        return true;
+    }
+
+    // Re-expand the acceleration series about the end of the step for a step ratio q
+    void predictNextStep(double q, std::vector<double> (&bOld)[7], std::vector<double> (&eOld)[7]) {
+        const Ias15Tables& T = ias15Tables();
+        forEachActive([&](size_t i) {
+            double prediction[7];
+            double qp = q;
+            for (int j = 0; j < 7; ++j) {
+                double sum = 0.0;
+                for (int k = j; k < 7; ++k) {
+                    sum += T.binom[k + 1][j + 1] * bOld[k][i];
+                }
+                prediction[j] = qp * sum;
+                qp *= q;
+            }
+            for (int j = 0; j < 7; ++j) {
+                // Keep the correction the last predictor-corrector pass applied on top of the prediction
+                double correction = bOld[j][i] - eOld[j][i];
+                e[j][i] = prediction[j];
+                b[j][i] = prediction[j] + correction;
+            }
+        });
+    }
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include "indirect_spheres.h"
+#include "culling.h"
+#include "shader.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Tessellations from near to far, in longitude segments (rings are half as many), and
+// the projected radius in pixels above which each level is used
+static const int lodSegments[IndirectSpheres::lodCount] = {64, 32, 16, 8};
+static const float lodPixels[IndirectSpheres::lodCount - 1] = {48.0f, 16.0f, 5.0f};
+
+// One invocation per sphere: frustum, then the occluder's shadow cone as in
+// SphereCuller, then a level from the projected radius and an append to its stretch
+static const char* cullShaderSource = R"(
+#version 430 core
+layout(local_size_x = 256) in;
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+layout(std430, binding = 0) readonly buffer Spheres { vec4 spheres[]; };
+layout(std430, binding = 1) writeonly buffer Instances { vec4 instances[]; };
+layout(std430, binding = 2) buffer Commands { DrawCommand commands[]; };
+uniform uint first;
+uniform uint count;
+uniform uint capacity;
+uniform vec3 eyeHigh;
+uniform vec3 eyeLow;
+uniform float radiusScale;
+uniform float radiusPower;
+uniform vec4 planes[6];
+uniform bool occluding;
+uniform vec3 occluderDirection;
+uniform float sinHalfAngle;
+uniform float cos2HalfAngle;
+uniform float silhouetteDistance;
+uniform float pixelScale;
+uniform vec3 lodPixels;
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= count) {
+        return;
+    }
+    vec4 sphere = spheres[first + i];
+    vec3 c = (sphere.xyz - eyeHigh) - eyeLow;
+    float r = radiusScale * pow(sphere.w, radiusPower);
+    for (int p = 0; p < 6; ++p) {
+        if (dot(planes[p].xyz, c) + planes[p].w + r < 0.0) {
+            return;
+        }
+    }
+    float length2 = dot(c, c);
+    if (occluding) {
+        float k = dot(c, occluderDirection);
+        float a = k - sinHalfAngle * r;
+        if (r * r <= sinHalfAngle * sinHalfAngle * length2 && a >= 0.0 && a * a >= cos2HalfAngle * (length2 - r * r) &&
+            k - r >= silhouetteDistance) {
+            return;
+        }
+    }
+    float pixels = pixelScale * r / sqrt(max(length2 - r * r, r * r));
+    uint lod = pixels > lodPixels.x ? 0u : pixels > lodPixels.y ? 1u : pixels > lodPixels.z ? 2u : 3u;
+    uint slot = atomicAdd(commands[lod].instanceCount, 1u);
+    instances[lod * capacity + slot] = vec4(c, r);
+}
+)";
+
+// Unit latitude-longitude sphere with a duplicated seam column, appended to the arrays
+// with indices counted from its own first vertex
+static void appendSphereMesh(int segments, int rings, std::vector<float>& vertices, std::vector<GLuint>& indices) {
+    for (int ring = 0; ring <= rings; ++ring) {
+        const double theta = M_PI * ring / rings;
+        for (int segment = 0; segment <= segments; ++segment) {
+            const double phi = 2.0 * M_PI * segment / segments;
+            vertices.push_back((float)(std::sin(theta) * std::cos(phi)));
+            vertices.push_back((float)std::cos(theta));
+            vertices.push_back((float)(std::sin(theta) * std::sin(phi)));
+        }
+    }
+    for (int ring = 0; ring < rings; ++ring) {
+        for (int segment = 0; segment < segments; ++segment) {
+            const GLuint a = ring * (segments + 1) + segment, b = a + segments + 1;
+            indices.insert(indices.end(), {a, b, a + 1, b, b + 1, a + 1});
+        }
+    }
+}
+
+bool IndirectSpheres::init(size_t capacity) {
+    destroy();
+    if (capacity == 0) {
+        return false;
+    }
+    if (!GLEW_VERSION_4_3) {
+        std::cerr << "GPU culling needs OpenGL 4.3" << std::endl;
+        return false;
+    }
+    cullProgram = createComputeProgram(cullShaderSource);
+    if (!cullProgram) {
+        return false;
+    }
+    maxSpheres = capacity;
+
+    // Every level in one vertex and one index buffer, addressed by each command's base vertex and first index
+    std::vector<float> vertices;
+    std::vector<GLuint> indices;
+    for (int lod = 0; lod < lodCount; ++lod) {
+        lodBaseVertex[lod] = GLint(vertices.size() / 3);
+        lodFirstIndex[lod] = GLuint(indices.size());
+        appendSphereMesh(lodSegments[lod], lodSegments[lod] / 2, vertices, indices);
+        lodIndexCounts[lod] = GLuint(indices.size()) - lodFirstIndex[lod];
+    }
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &meshBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, meshBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    // Each command's baseInstance starts its level's stretch of this buffer
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, lodCount * maxSpheres * 4 * sizeof(float), NULL, GL_DYNAMIC_COPY);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, lodCount * 5 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return true;
+}
+
+void IndirectSpheres::destroy() {
+    if (cullProgram) {
+        glDeleteProgram(cullProgram);
+    }
+    if (vao) {
+        glDeleteVertexArrays(1, &vao);
+        GLuint buffers[] = {meshBuffer, indexBuffer, instanceBuffer, commandBuffer};
+        glDeleteBuffers(4, buffers);
+    }
+    cullProgram = vao = meshBuffer = indexBuffer = instanceBuffer = commandBuffer = 0;
+    maxSpheres = 0;
+}
+
+void IndirectSpheres::setOccluder(const glm::dvec3& center, double radius) {
+    occluderCenter = center;
+    occluderRadius = radius;
+}
+
+void IndirectSpheres::cull(GLuint sphereBuffer, size_t first, size_t count, const glm::mat4& viewProjection,
+                           bool zeroToOne, const glm::dvec3& eye, float pixelScale) {
+    if (!cullProgram) {
+        return;
+    }
+    if (count > maxSpheres) {
+        count = maxSpheres;
+    }
+    // Fresh commands with no instances
+    GLuint commands[lodCount][5];
+    for (int lod = 0; lod < lodCount; ++lod) {
+        commands[lod][0] = lodIndexCounts[lod];
+        commands[lod][1] = 0;
+        commands[lod][2] = lodFirstIndex[lod];
+        commands[lod][3] = GLuint(lodBaseVertex[lod]);
+        commands[lod][4] = GLuint(lod * maxSpheres);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(commands), commands);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    if (count == 0) {
+        return;
+    }
+
+    glUseProgram(cullProgram);
+    glUniform1ui(glGetUniformLocation(cullProgram, "first"), GLuint(first));
+    glUniform1ui(glGetUniformLocation(cullProgram, "count"), GLuint(count));
+    glUniform1ui(glGetUniformLocation(cullProgram, "capacity"), GLuint(maxSpheres));
+    const glm::vec3 eyeHigh((float)eye.x, (float)eye.y, (float)eye.z);
+    const glm::vec3 eyeLow((float)(eye.x - eyeHigh.x), (float)(eye.y - eyeHigh.y), (float)(eye.z - eyeHigh.z));
+    glUniform3f(glGetUniformLocation(cullProgram, "eyeHigh"), eyeHigh.x, eyeHigh.y, eyeHigh.z);
+    glUniform3f(glGetUniformLocation(cullProgram, "eyeLow"), eyeLow.x, eyeLow.y, eyeLow.z);
+    glUniform1f(glGetUniformLocation(cullProgram, "radiusScale"), radiusScale);
+    glUniform1f(glGetUniformLocation(cullProgram, "radiusPower"), radiusPower);
+    float planes[6][4];
+    frustumPlanes(viewProjection, zeroToOne, planes);
+    glUniform4fv(glGetUniformLocation(cullProgram, "planes"), 6, planes[0]);
+
+    // The occluder as SphereCuller::addOccluder sees it, shrunk the same way
+    const glm::dvec3 toOccluder = occluderCenter - eye;
+    const double distance = std::sqrt(glm::dot(toOccluder, toOccluder));
+    const double radius = occluderRadius * (1.0 - 4.0e-6);
+    const bool occluding = radius > 0.0 && distance > radius;
+    glUniform1i(glGetUniformLocation(cullProgram, "occluding"), occluding);
+    if (occluding) {
+        const double sinHalfAngle = radius / distance, cos2HalfAngle = 1.0 - sinHalfAngle * sinHalfAngle;
+        glUniform3f(glGetUniformLocation(cullProgram, "occluderDirection"), (float)(toOccluder.x / distance),
+                    (float)(toOccluder.y / distance), (float)(toOccluder.z / distance));
+        glUniform1f(glGetUniformLocation(cullProgram, "sinHalfAngle"), (float)sinHalfAngle);
+        glUniform1f(glGetUniformLocation(cullProgram, "cos2HalfAngle"), (float)cos2HalfAngle);
+        glUniform1f(glGetUniformLocation(cullProgram, "silhouetteDistance"), (float)(distance * cos2HalfAngle));
+    }
+    glUniform1f(glGetUniformLocation(cullProgram, "pixelScale"), pixelScale);
+    glUniform3f(glGetUniformLocation(cullProgram, "lodPixels"), lodPixels[0], lodPixels[1], lodPixels[2]);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, sphereBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    glDispatchCompute(GLuint((count + 255) / 256), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    glUseProgram(0);
+}
+
+void IndirectSpheres::draw(GLuint program) const {
+    if (!cullProgram) {
+        return;
+    }
+    glUseProgram(program);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, lodCount, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void IndirectSpheres::lodCounts(GLuint counts[lodCount]) const {
+    GLuint commands[lodCount][5] = {};
+    if (commandBuffer) {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(commands), commands);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    for (int lod = 0; lod < lodCount; ++lod) {
+        counts[lod] = commands[lod][1];
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef INDIRECT_SPHERES_H
+#define INDIRECT_SPHERES_H
+
+#include <GL/glew.h>
+#include "glm/glm/glm.hpp"
+#include <cstddef>
+
+// Sphere meshes culled, sorted into levels of detail and drawn entirely by the GPU (GL 4.3).
+//
+// Spheres are read from a shader storage buffer of vec4 (world centre, size), such as
+// GpuGravity's positions and masses, so nothing per sphere passes through the CPU. A
+// compute pass gives each sphere one invocation: it drops spheres outside the frustum
+// or hidden behind the occluder, picks a tessellation from the sphere's size on screen
+// and appends the camera-relative centre and radius to that level's stretch of the
+// instance buffer, counting it with an atomic add on the level's instanceCount in a
+// buffer of DrawElementsIndirectCommand records. One glMultiDrawElementsIndirect then
+// draws every level, each command's baseInstance pointing at its stretch. Per frame the
+// CPU resets the counts, dispatches and draws, whatever the number of spheres.
+//
+// Centres are subtracted from the eye split into two floats, so the camera-relative
+// centres keep the precision of the stored float positions.
+class IndirectSpheres {
+public:
+    static const int lodCount = 4;
+
+    // radius = radiusScale * size^radiusPower; 1/3 turns masses of one density into radii
+    float radiusScale = 1.0f;
+    float radiusPower = 1.0f;
+
+    IndirectSpheres() = default;
+    IndirectSpheres(const IndirectSpheres&) = delete;
+    IndirectSpheres& operator=(const IndirectSpheres&) = delete;
+    ~IndirectSpheres() { destroy(); }
+
+    // Build the level meshes and buffers for up to capacity spheres; false without GL 4.3
+    bool init(size_t capacity);
+    void destroy();
+
+    // Occluding sphere in world coordinates, such as the Earth; radius 0 for none
+    void setOccluder(const glm::dvec3& center, double radius);
+    // Cull spheres [first, first + count) of sphereBuffer for this view. viewProjection
+    // takes camera-relative positions; zeroToOne is the clip depth convention and
+    // pixelScale the pixels per unit of tan(angle) (half the viewport height over
+    // tan(fovy / 2)).
+    void cull(GLuint sphereBuffer, size_t first, size_t count, const glm::mat4& viewProjection, bool zeroToOne,
+              const glm::dvec3& eye, float pixelScale);
+    // Draw the last cull's spheres with a program built from the instanced sphere
+    // shaders; the caller has bound its View block and set its colour and depth uniforms
+    void draw(GLuint program) const;
+
+    // Spheres drawn at each level by the last cull. Reads back from the GPU and waits
+    // for it, so only for occasional statistics.
+    void lodCounts(GLuint counts[lodCount]) const;
+
+private:
+    GLuint cullProgram = 0;
+    GLuint vao = 0, meshBuffer = 0, indexBuffer = 0;
+    GLuint instanceBuffer = 0; // lodCount stretches of capacity vec4s
+    GLuint commandBuffer = 0;  // lodCount DrawElementsIndirectCommand records
+    size_t maxSpheres = 0;
+    GLuint lodIndexCounts[lodCount] = {}, lodFirstIndex[lodCount] = {};
+    GLint lodBaseVertex[lodCount] = {};
+    glm::dvec3 occluderCenter = glm::dvec3(0.0);
+    double occluderRadius = 0.0;
+};
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef INTEGRATORS_H
+#define INTEGRATORS_H
+
+#include "nbody.h"
+#include "kepler.h"
+#include <string>
+#include <vector>
+
+// Symplectic integrators, templated on the force backend so that the
+// kick/drift composition is fixed at compile time. Every integrator exposes
+// integrate(system, force, dt, steps); the only runtime dispatch is the
+// switch in IntegratorSet, taken once per call rather than per step.
+
+// Velocity update from the cached accelerations
+inline void kick(BodySystem& s, double h) {
+    const size_t n = s.size();
+    for (size_t i = 0; i < n; ++i) {
+        s.vx[i] += h * s.ax[i];
+        s.vy[i] += h * s.ay[i];
+        s.vz[i] += h * s.az[i];
+    }
+}
+
+// Position update from the current velocities
+inline void drift(BodySystem& s, double h) {
+    const size_t n = s.size();
+    for (size_t i = 0; i < n; ++i) {
+        s.x[i] += h * s.vx[i];
+        s.y[i] += h * s.vy[i];
+        s.z[i] += h * s.vz[i];
+    }
+}
+
+// Second-order kick-drift-kick step; the closing force evaluation is reused by the next step
+template <class Force>
+inline void kickDriftKick(BodySystem& s, const Force& force, double h) {
+    if (!s.accelerationsValid) {
+        computeAccelerations(s, force);
+    }
+    kick(s, 0.5 * h);
+    drift(s, h);
+    computeAccelerations(s, force);
+    kick(s, 0.5 * h);
+}
+
+// Substep weights for composing leapfrog into higher orders (Yoshida 1990)
+struct LeapfrogWeights {
+    static constexpr double weights[] = {1.0};
+};
+
+struct Yoshida4Weights {
+    static constexpr double w1 = 1.3512071919596576340476878089715; // 1 / (2 - 2^(1/3))
+    static constexpr double w0 = -1.7024143839193152680953756179429; // -2^(1/3) * w1
+    static constexpr double weights[] = {w1, w0, w1};
+};
+
+struct Yoshida6Weights {
+    // Solution A of Yoshida's sixth-order composition
+    static constexpr double w1 = -1.17767998417887;
+    static constexpr double w2 = 0.235573213359357;
+    static constexpr double w3 = 0.784513610477560;
+    static constexpr double w0 = 1.0 - 2.0 * (w1 + w2 + w3);
+    static constexpr double weights[] = {w3, w2, w1, w0, w1, w2, w3};
+};
+
+// Leapfrog composed with a fixed weight table; the weight loop unrolls at compile time
+template <class Force, class Weights>
+class CompositionIntegrator {
+public:
+    void step(BodySystem& s, const Force& force, double dt) {
+        for (double w : Weights::weights) {
+            kickDriftKick(s, force, w * dt);
+        }
+        s.time += dt;
+    }
+
+    void integrate(BodySystem& s, const Force& force, double dt, int steps) {
+        for (int i = 0; i < steps; ++i) {
+            step(s, force, dt);
+        }
+    }
+};
+
+template <class Force> using LeapfrogIntegrator = CompositionIntegrator<Force, LeapfrogWeights>;
+template <class Force> using Yoshida4Integrator = CompositionIntegrator<Force, Yoshida4Weights>;
+template <class Force> using Yoshida6Integrator = CompositionIntegrator<Force, Yoshida6Weights>;
+
+// Wisdom-Holman mixed-variable integrator in democratic heliocentric coordinates.
+// Body 0 is the dominant central mass; its Keplerian motion is solved exactly and
+// only the planet-planet interaction goes through the force backend.
+template <class Force>
+class WisdomHolmanIntegrator {
+public:
+    void integrate(BodySystem& s, const Force& force, double dt, int steps) {
+        const size_t n = s.size();
+        if (n < 2) {
+            s.time += dt * steps;
+            return;
+        }
+        toDemocraticHeliocentric(s);
+        for (int i = 0; i < steps; ++i) {
+            interactionKick(force, 0.5 * dt);
+            jump(0.5 * dt);
+            keplerDrift(force.G * s.mass[0], dt);
+            jump(0.5 * dt);
+            interactionKick(force, 0.5 * dt);
+        }
+        fromDemocraticHeliocentric(s, dt * steps);
+        s.time += dt * steps;
+        s.accelerationsValid = false;
+    }
+
+    void step(BodySystem& s, const Force& force, double dt) {
+        integrate(s, force, dt, 1);
+    }
+
+private:
+    // Heliocentric positions and barycentric velocities of bodies 1..n-1
+    std::vector<double> qx, qy, qz, px, py, pz, ax, ay, az, m;
+    double m0 = 0.0, totalMass = 0.0;
+    double cmx = 0.0, cmy = 0.0, cmz = 0.0, cmvx = 0.0, cmvy = 0.0, cmvz = 0.0;
+
+    void toDemocraticHeliocentric(const BodySystem& s) {
+        const size_t k = s.size() - 1;
+        qx.resize(k); qy.resize(k); qz.resize(k);
+        px.resize(k); py.resize(k); pz.resize(k);
+        ax.resize(k); ay.resize(k); az.resize(k);
+        m.resize(k);
+
+        m0 = s.mass[0];
+        totalMass = 0.0;
+        cmx = cmy = cmz = cmvx = cmvy = cmvz = 0.0;
+        for (size_t i = 0; i < s.size(); ++i) {
+            totalMass += s.mass[i];
+            cmx += s.mass[i] * s.x[i]; cmy += s.mass[i] * s.y[i]; cmz += s.mass[i] * s.z[i];
+            cmvx += s.mass[i] * s.vx[i]; cmvy += s.mass[i] * s.vy[i]; cmvz += s.mass[i] * s.vz[i];
+        }
+        cmx /= totalMass; cmy /= totalMass; cmz /= totalMass;
+        cmvx /= totalMass; cmvy /= totalMass; cmvz /= totalMass;
+
+        for (size_t i = 0; i < k; ++i) {
+            qx[i] = s.x[i + 1] - s.x[0]; qy[i] = s.y[i + 1] - s.y[0]; qz[i] = s.z[i + 1] - s.z[0];
+            px[i] = s.vx[i + 1] - cmvx; py[i] = s.vy[i + 1] - cmvy; pz[i] = s.vz[i + 1] - cmvz;
+            m[i] = s.mass[i + 1];
+        }
+    }
+
+    void fromDemocraticHeliocentric(BodySystem& s, double elapsed) {
+        const size_t k = m.size();
+        double sqx = 0.0, sqy = 0.0, sqz = 0.0, spx = 0.0, spy = 0.0, spz = 0.0;
+        for (size_t i = 0; i < k; ++i) {
+            sqx += m[i] * qx[i]; sqy += m[i] * qy[i]; sqz += m[i] * qz[i];
+            spx += m[i] * px[i]; spy += m[i] * py[i]; spz += m[i] * pz[i];
+        }
+        // The barycenter moves uniformly over the interval
+        s.x[0] = cmx + cmvx * elapsed - sqx / totalMass;
+        s.y[0] = cmy + cmvy * elapsed - sqy / totalMass;
+        s.z[0] = cmz + cmvz * elapsed - sqz / totalMass;
+        s.vx[0] = cmvx - spx / m0;
+        s.vy[0] = cmvy - spy / m0;
+        s.vz[0] = cmvz - spz / m0;
+        for (size_t i = 0; i < k; ++i) {
+            s.x[i + 1] = qx[i] + s.x[0]; s.y[i + 1] = qy[i] + s.y[0]; s.z[i + 1] = qz[i] + s.z[0];
+            s.vx[i + 1] = px[i] + cmvx; s.vy[i + 1] = py[i] + cmvy; s.vz[i + 1] = pz[i] + cmvz;
+        }
+    }
+
+    void interactionKick(const Force& force, double h) {
+        const size_t k = m.size();
+        force(k, qx.data(), qy.data(), qz.data(), m.data(), ax.data(), ay.data(), az.data());
+        for (size_t i = 0; i < k; ++i) {
+            px[i] += h * ax[i];
+            py[i] += h * ay[i];
+            pz[i] += h * az[i];
+        }
+    }
+
+    // Drift of the heliocentric positions due to the central body's momentum
+    void jump(double h) {
+        const size_t k = m.size();
+        double spx = 0.0, spy = 0.0, spz = 0.0;
+        for (size_t i = 0; i < k; ++i) {
+            spx += m[i] * px[i]; spy += m[i] * py[i]; spz += m[i] * pz[i];
+        }
+        const double scale = h / m0;
+        for (size_t i = 0; i < k; ++i) {
+            qx[i] += scale * spx;
+            qy[i] += scale * spy;
+            qz[i] += scale * spz;
+        }
+    }
+
+    void keplerDrift(double mu, double h) {
+        const size_t k = m.size();
+        for (size_t i = 0; i < k; ++i) {
+            keplerStep(mu, qx[i], qy[i], qz[i], px[i], py[i], pz[i], h);
+        }
+    }
+};
+
+enum class IntegratorKind {
+    Leapfrog,
+    Yoshida4,
+    Yoshida6,
+    WisdomHolman
+};
+
+inline const char* integratorName(IntegratorKind kind) {
+    switch (kind) {
+    case IntegratorKind::Leapfrog: return "leapfrog";
+    case IntegratorKind::Yoshida4: return "yoshida4";
+    case IntegratorKind::Yoshida6: return "yoshida6";
+    case IntegratorKind::WisdomHolman: return "wh";
+    }
+    return "unknown";
+}
+
+// Function to parse an integrator name such as "yoshida4"
+inline bool parseIntegratorKind(const std::string& name, IntegratorKind& kind) {
+    const IntegratorKind all[] = {IntegratorKind::Leapfrog, IntegratorKind::Yoshida4,
+                                  IntegratorKind::Yoshida6, IntegratorKind::WisdomHolman};
+    for (IntegratorKind k : all) {
+        if (name == integratorName(k)) {
+            kind = k;
+            return true;
+        }
+    }
+    if (name == "verlet") {
+        kind = IntegratorKind::Leapfrog;
+        return true;
+    }
+    return false;
+}
+
+// Holds one instance of every variant for a force backend and picks one at runtime
+template <class Force>
+class IntegratorSet {
+public:
+    IntegratorKind kind = IntegratorKind::Leapfrog;
+
+    void integrate(BodySystem& s, const Force& force, double dt, int steps) {
+        switch (kind) {
+        case IntegratorKind::Leapfrog: leapfrog.integrate(s, force, dt, steps); break;
+        case IntegratorKind::Yoshida4: yoshida4.integrate(s, force, dt, steps); break;
+        case IntegratorKind::Yoshida6: yoshida6.integrate(s, force, dt, steps); break;
+        case IntegratorKind::WisdomHolman: wisdomHolman.integrate(s, force, dt, steps); break;
+        }
+    }
+
+private:
+    LeapfrogIntegrator<Force> leapfrog;
+    Yoshida4Integrator<Force> yoshida4;
+    Yoshida6Integrator<Force> yoshida6;
+    WisdomHolmanIntegrator<Force> wisdomHolman;
+};
+
+#endif
@@ -0,0 +1,366 @@
+#include "kepler.h"
+#include <algorithm>
+#include <cmath>
+
+void stumpff(double z, double& c2, double& c3) {
+    if (z > 0.1) {
+        double s = std::sqrt(z);
+        c2 = (1.0 - std::cos(s)) / z;
+        c3 = (s - std::sin(s)) / (z * s);
+    } else if (z < -0.1) {
+        double s = std::sqrt(-z);
+        c2 = (std::cosh(s) - 1.0) / (-z);
+        c3 = (std::sinh(s) - s) / (-z * s);
+    } else {
+        // Taylor series near the parabolic limit avoids cancellation
+        c2 = 1.0 / 2.0 - z * (1.0 / 24.0 - z * (1.0 / 720.0 - z * (1.0 / 40320.0 - z / 3628800.0)));
+        c3 = 1.0 / 6.0 - z * (1.0 / 120.0 - z * (1.0 / 5040.0 - z * (1.0 / 362880.0 - z / 39916800.0)));
+    }
+}
+
+bool keplerStep(double mu, double& x, double& y, double& z, double& vx, double& vy, double& vz, double dt) {
+    const double r0 = std::sqrt(x * x + y * y + z * z);
+    const double v2 = vx * vx + vy * vy + vz * vz;
+    const double sqrtMu = std::sqrt(mu);
+    const double sigma0 = (x * vx + y * vy + z * vz) / sqrtMu;
+    const double alpha = 2.0 / r0 - v2 / mu; // Reciprocal semi-major axis
+
+    // Whole elliptic periods do not change the state, so drop them to keep chi small
+    double t = dt;
+    if (alpha > 0.0) {
+        double period = 2.0 * M_PI / std::sqrt(mu * alpha * alpha * alpha);
+        t = std::fmod(dt, period);
+    }
+
+    // Starting guess per conic (Vallado); a guess that is too large overflows cosh on hyperbolae
+    double chi;
+    if (alpha * r0 > 1e-6) {
+        chi = sqrtMu * t * alpha;
+    } else if (alpha * r0 < -1e-6) {
+        double a = 1.0 / alpha;
+        double sign = t >= 0.0 ? 1.0 : -1.0;
+        double arg = -2.0 * mu * alpha * t / (sigma0 * sqrtMu + sign * std::sqrt(-mu * a) * (1.0 - r0 * alpha));
+        chi = arg > 0.0 ? sign * std::sqrt(-a) * std::log(arg) : sqrtMu * t / r0;
+    } else {
+        // Barker's equation for the parabola with the same angular momentum
+        double hx = y * vz - z * vy, hy = z * vx - x * vz, hz = x * vy - y * vx;
+        double p = (hx * hx + hy * hy + hz * hz) / mu;
+        double s = 0.5 * std::atan(1.0 / (3.0 * std::sqrt(mu / (p * p * p)) * t));
+        double w = std::atan(std::cbrt(std::tan(s)));
+        chi = std::sqrt(p) * 2.0 / std::tan(2.0 * w);
+    }
+
+    // Laguerre-Conway iteration on the universal Kepler equation. The equation is monotonic
+    // in chi, so every evaluation tightens a bracket; steps that leave it (or overflow on a
+    // hyperbola) fall back to expanding the bracket or bisecting it.
+    double c2 = 0.5, c3 = 1.0 / 6.0, r = r0;
+    double lo = -HUGE_VAL, hi = HUGE_VAL;
+    bool converged = false;
+    for (int iter = 0; iter < 200; ++iter) {
+        double psi = alpha * chi * chi;
+        stumpff(psi, c2, c3);
+        double chi2 = chi * chi;
+        double f = sigma0 * chi2 * c2 + (1.0 - alpha * r0) * chi2 * chi * c3 + r0 * chi - sqrtMu * t;
+        double df = chi2 * c2 + sigma0 * chi * (1.0 - psi * c3) + r0 * (1.0 - psi * c2);
+        double ddf = sigma0 * (1.0 - psi * c2) + (1.0 - alpha * r0) * chi * (1.0 - psi * c3);
+        if (f < 0.0) {
+            lo = chi;
+        } else {
+            hi = chi;
+        }
+        double disc = std::sqrt(std::fabs(16.0 * df * df - 20.0 * f * ddf));
+        double delta = 5.0 * f / (df + (df >= 0.0 ? disc : -disc));
+        double next = chi - delta;
+        if (!(next > lo && next < hi)) {
+            if (lo == -HUGE_VAL) {
+                next = hi - std::fmax(1.0, std::fabs(hi));
+            } else if (hi == HUGE_VAL) {
+                next = lo + std::fmax(1.0, std::fabs(lo));
+            } else {
+                next = 0.5 * (lo + hi);
+            }
+        }
+        delta = chi - next;
+        chi = next;
+        if (std::fabs(delta) <= 1e-14 * std::fabs(chi) + 1e-300 || hi - lo <= 1e-15 * std::fabs(chi)) {
+            converged = true;
+            break;
+        }
+    }
+
+    double psi = alpha * chi * chi;
+    stumpff(psi, c2, c3);
+    double chi2 = chi * chi;
+    r = chi2 * c2 + sigma0 * chi * (1.0 - psi * c3) + r0 * (1.0 - psi * c2);
+
+    // Lagrange f and g coefficients
+    double f = 1.0 - chi2 * c2 / r0;
+    double g = t - chi2 * chi * c3 / sqrtMu;
+    double fdot = sqrtMu * chi * (psi * c3 - 1.0) / (r * r0);
+    double gdot = 1.0 - chi2 * c2 / r;
+
+    double nx = f * x + g * vx, ny = f * y + g * vy, nz = f * z + g * vz;
+    vx = fdot * x + gdot * vx;
+    vy = fdot * y + gdot * vy;
+    vz = fdot * z + gdot * vz;
+    x = nx; y = ny; z = nz;
+    return converged;
+}
+
+void stateToElements(double mu, double x, double y, double z, double vx, double vy, double vz, double elements[6]) {
+    const double r = std::sqrt(x * x + y * y + z * z);
+    const double v2 = vx * vx + vy * vy + vz * vz;
+    const double rv = x * vx + y * vy + z * vz;
+    const double hx = y * vz - z * vy, hy = z * vx - x * vz, hz = x * vy - y * vx;
+    const double h = std::sqrt(hx * hx + hy * hy + hz * hz);
+    const double ex = ((v2 - mu / r) * x - rv * vx) / mu;
+    const double ey = ((v2 - mu / r) * y - rv * vy) / mu;
+    const double ez = ((v2 - mu / r) * z - rv * vz) / mu;
+    const double ecc = std::sqrt(ex * ex + ey * ey + ez * ez);
+    const double W[3] = {hx / h, hy / h, hz / h};
+
+    // Node direction n and the in-plane direction 90 degrees ahead of it, W x n
+    const double nodeLength = std::sqrt(W[0] * W[0] + W[1] * W[1]);
+    const double raan = nodeLength > 1e-12 ? std::atan2(W[0], -W[1]) : 0.0;
+    const double n[3] = {std::cos(raan), std::sin(raan), 0.0};
+    const double m[3] = {-W[2] * n[1], W[2] * n[0], W[0] * n[1] - W[1] * n[0]};
+    double P[3];
+    if (ecc > 1e-12) {
+        P[0] = ex / ecc; P[1] = ey / ecc; P[2] = ez / ecc;
+    } else {
+        P[0] = x / r; P[1] = y / r; P[2] = z / r;
+    }
+    const double argPeriapsis = std::atan2(P[0] * m[0] + P[1] * m[1] + P[2] * m[2], P[0] * n[0] + P[1] * n[1]);
+    const double Q[3] = {W[1] * P[2] - W[2] * P[1], W[2] * P[0] - W[0] * P[2], W[0] * P[1] - W[1] * P[0]};
+
+    elements[0] = h * h / mu / (1.0 + ecc);
+    elements[1] = ecc;
+    elements[2] = std::acos(std::min(1.0, std::max(-1.0, W[2])));
+    elements[3] = raan;
+    elements[4] = argPeriapsis;
+    elements[5] = std::atan2(x * Q[0] + y * Q[1] + z * Q[2], x * P[0] + y * P[1] + z * P[2]);
+}
+
+// Eccentricities closer to 1 than this go through the universal-variable path
+static const double nearParabolicBand = 0.02;
+// Halley iterations needed for full double precision from the starters below
+static const int ellipticIterations = 5;
+static const int hyperbolicIterations = 5;
+
+void KeplerBatch::reserve(size_t n) {
+    px.reserve(n); py.reserve(n); pz.reserve(n);
+    qx.reserve(n); qy.reserve(n); qz.reserve(n);
+    e.reserve(n); q.reserve(n); tp.reserve(n);
+    meanMotion.reserve(n); semiA.reserve(n); semiB.reserve(n); velA.reserve(n); velB.reserve(n);
+}
+
+size_t KeplerBatch::add(double periapsis, double ecc, double inc, double raan, double argPeriapsis, double periapsisTime) {
+    const double cO = std::cos(raan), sO = std::sin(raan);
+    const double cw = std::cos(argPeriapsis), sw = std::sin(argPeriapsis);
+    const double ci = std::cos(inc), si = std::sin(inc);
+    const double P[3] = {cO * cw - sO * sw * ci, sO * cw + cO * sw * ci, sw * si};
+    const double Q[3] = {-cO * sw - sO * cw * ci, -sO * sw + cO * cw * ci, cw * si};
+    return addPerifocal(periapsis, ecc, P, Q, periapsisTime);
+}
+
+size_t KeplerBatch::addFromState(double x, double y, double z, double vx, double vy, double vz, double t) {
+    const double r = std::sqrt(x * x + y * y + z * z);
+    const double v2 = vx * vx + vy * vy + vz * vz;
+    const double rv = x * vx + y * vy + z * vz;
+    // Angular momentum and eccentricity vector
+    const double hx = y * vz - z * vy, hy = z * vx - x * vz, hz = x * vy - y * vx;
+    const double h = std::sqrt(hx * hx + hy * hy + hz * hz);
+    const double ex = ((v2 - mu / r) * x - rv * vx) / mu;
+    const double ey = ((v2 - mu / r) * y - rv * vy) / mu;
+    const double ez = ((v2 - mu / r) * z - rv * vz) / mu;
+    const double ecc = std::sqrt(ex * ex + ey * ey + ez * ez);
+    const double periapsis = h * h / mu / (1.0 + ecc);
+
+    // Periapsis direction; circular orbits measure from the current position instead
+    double P[3];
+    if (ecc > 1e-12) {
+        P[0] = ex / ecc; P[1] = ey / ecc; P[2] = ez / ecc;
+    } else {
+        P[0] = x / r; P[1] = y / r; P[2] = z / r;
+    }
+    const double W[3] = {hx / h, hy / h, hz / h};
+    const double Q[3] = {W[1] * P[2] - W[2] * P[1], W[2] * P[0] - W[0] * P[2], W[0] * P[1] - W[1] * P[0]};
+
+    // Time since periapsis from the true anomaly
+    const double nu = std::atan2(x * Q[0] + y * Q[1] + z * Q[2], x * P[0] + y * P[1] + z * P[2]);
+    double sincePeriapsis;
+    if (std::fabs(ecc - 1.0) < 1e-8) {
+        // Barker's equation
+        const double D = std::tan(0.5 * nu);
+        const double p = 2.0 * periapsis;
+        sincePeriapsis = 0.5 * std::sqrt(p * p * p / mu) * (D + D * D * D / 3.0);
+    } else if (ecc < 1.0) {
+        const double a = periapsis / (1.0 - ecc);
+        const double E = 2.0 * std::atan(std::sqrt((1.0 - ecc) / (1.0 + ecc)) * std::tan(0.5 * nu));
+        sincePeriapsis = (E - ecc * std::sin(E)) / std::sqrt(mu / (a * a * a));
+    } else {
+        const double a = periapsis / (ecc - 1.0);
+        const double H = 2.0 * std::atanh(std::sqrt((ecc - 1.0) / (ecc + 1.0)) * std::tan(0.5 * nu));
+        sincePeriapsis = (ecc * std::sinh(H) - H) / std::sqrt(mu / (a * a * a));
+    }
+    return addPerifocal(periapsis, ecc, P, Q, t - sincePeriapsis);
+}
+
+size_t KeplerBatch::addPerifocal(double periapsis, double ecc, const double P[3], const double Q[3], double periapsisTime) {
+    const size_t index = e.size();
+    px.push_back(P[0]); py.push_back(P[1]); pz.push_back(P[2]);
+    qx.push_back(Q[0]); qy.push_back(Q[1]); qz.push_back(Q[2]);
+    e.push_back(ecc);
+    q.push_back(periapsis);
+    tp.push_back(periapsisTime);
+
+    double a = 0.0, shape = 0.0;
+    if (std::fabs(ecc - 1.0) < nearParabolicBand) {
+        nearParabolic.push_back(index);
+    } else if (ecc < 1.0) {
+        a = periapsis / (1.0 - ecc);
+        shape = std::sqrt(1.0 - ecc * ecc);
+        elliptic.push_back(index);
+    } else {
+        a = periapsis / (ecc - 1.0); // |a| of the hyperbola
+        shape = std::sqrt(ecc * ecc - 1.0);
+        hyperbolic.push_back(index);
+    }
+    meanMotion.push_back(a > 0.0 ? std::sqrt(mu / (a * a * a)) : 0.0);
+    semiA.push_back(a);
+    semiB.push_back(a * shape);
+    velA.push_back(std::sqrt(mu * a));
+    velB.push_back(std::sqrt(mu * a) * shape);
+    return index;
+}
+
+static size_t chunksFor(size_t count) {
+    return (count + KeplerBatch::chunkSize - 1) / KeplerBatch::chunkSize;
+}
+
+size_t KeplerBatch::chunkCount() const {
+    return chunksFor(elliptic.size()) + chunksFor(hyperbolic.size()) + chunksFor(nearParabolic.size());
+}
+
+void KeplerBatch::propagateChunk(size_t chunk, double t, double* x, double* y, double* z,
+                                 double* vx, double* vy, double* vz) const {
+    const size_t nEll = chunksFor(elliptic.size());
+    const size_t nHyp = chunksFor(hyperbolic.size());
+    const std::vector<size_t>* group = &elliptic;
+    if (chunk >= nEll + nHyp) {
+        group = &nearParabolic;
+        chunk -= nEll + nHyp;
+    } else if (chunk >= nEll) {
+        group = &hyperbolic;
+        chunk -= nEll;
+    }
+    const size_t begin = chunk * chunkSize;
+    const size_t count = std::min(chunkSize, group->size() - begin);
+    const size_t* idx = group->data() + begin;
+    if (group == &elliptic) {
+        propagateElliptic(idx, count, t, x, y, z, vx, vy, vz);
+    } else if (group == &hyperbolic) {
+        propagateHyperbolic(idx, count, t, x, y, z, vx, vy, vz);
+    } else {
+        propagateNearParabolic(idx, count, t, x, y, z, vx, vy, vz);
+    }
+}
+
+void KeplerBatch::propagate(double t, double* x, double* y, double* z, double* vx, double* vy, double* vz) const {
+    const size_t chunks = chunkCount();
+    for (size_t c = 0; c < chunks; ++c) {
+        propagateChunk(c, t, x, y, z, vx, vy, vz);
+    }
+}
+
+// Rotate a perifocal position/velocity into the output frame
+void KeplerBatch::writeState(size_t i, double xp, double yp, double vxp, double vyp, double* x, double* y, double* z,
+                             double* vx, double* vy, double* vz) const {
+    x[i] = xp * px[i] + yp * qx[i];
+    y[i] = xp * py[i] + yp * qy[i];
+    z[i] = xp * pz[i] + yp * qz[i];
+    vx[i] = vxp * px[i] + vyp * qx[i];
+    vy[i] = vxp * py[i] + vyp * qy[i];
+    vz[i] = vxp * pz[i] + vyp * qz[i];
+}
+
+void KeplerBatch::propagateElliptic(const size_t* idx, size_t count, double t, double* x, double* y, double* z,
+                                    double* vx, double* vy, double* vz) const {
+    const double twoPi = 2.0 * M_PI;
+    double M[chunkSize], ecc[chunkSize], E[chunkSize];
+    for (size_t k = 0; k < count; ++k) {
+        const size_t i = idx[k];
+        double m = meanMotion[i] * (t - tp[i]);
+        M[k] = m - twoPi * std::floor(m / twoPi + 0.5); // Reduce to [-pi, pi)
+        ecc[k] = e[i];
+    }
+    // Starting guess: second-order series for moderate e, Danby's guess for high e
+    for (size_t k = 0; k < count; ++k) {
+        double s = std::sin(M[k]);
+        double series = M[k] + ecc[k] * s * (1.0 + ecc[k] * std::cos(M[k]));
+        double danby = M[k] + 0.85 * ecc[k] * (s >= 0.0 ? 1.0 : -1.0);
+        E[k] = ecc[k] < 0.8 ? series : danby;
+    }
+    // Fixed number of Halley steps keeps the loop free of data-dependent exits
+    for (int iter = 0; iter < ellipticIterations; ++iter) {
+        for (size_t k = 0; k < count; ++k) {
+            double se = ecc[k] * std::sin(E[k]);
+            double ce = ecc[k] * std::cos(E[k]);
+            double f = E[k] - se - M[k];
+            double fp = 1.0 - ce;
+            E[k] -= f / (fp - 0.5 * f * se / fp);
+        }
+    }
+    for (size_t k = 0; k < count; ++k) {
+        const size_t i = idx[k];
+        double cE = std::cos(E[k]), sE = std::sin(E[k]);
+        double r = semiA[i] * (1.0 - ecc[k] * cE);
+        double xp = semiA[i] * (cE - ecc[k]);
+        double yp = semiB[i] * sE;
+        double vxp = -velA[i] * sE / r;
+        double vyp = velB[i] * cE / r;
+        writeState(i, xp, yp, vxp, vyp, x, y, z, vx, vy, vz);
+    }
+}
+
+void KeplerBatch::propagateHyperbolic(const size_t* idx, size_t count, double t, double* x, double* y, double* z,
+                                      double* vx, double* vy, double* vz) const {
+    double M[chunkSize], ecc[chunkSize], H[chunkSize];
+    for (size_t k = 0; k < count; ++k) {
+        const size_t i = idx[k];
+        M[k] = meanMotion[i] * (t - tp[i]);
+        ecc[k] = e[i];
+        H[k] = std::asinh(M[k] / ecc[k]);
+    }
+    for (int iter = 0; iter < hyperbolicIterations; ++iter) {
+        for (size_t k = 0; k < count; ++k) {
+            double sh = ecc[k] * std::sinh(H[k]);
+            double ch = ecc[k] * std::cosh(H[k]);
+            double f = sh - H[k] - M[k];
+            double fp = ch - 1.0;
+            H[k] -= f / (fp - 0.5 * f * sh / fp);
+        }
+    }
+    for (size_t k = 0; k < count; ++k) {
+        const size_t i = idx[k];
+        double cH = std::cosh(H[k]), sH = std::sinh(H[k]);
+        double r = semiA[i] * (ecc[k] * cH - 1.0);
+        double xp = semiA[i] * (ecc[k] - cH);
+        double yp = semiB[i] * sH;
+        double vxp = -velA[i] * sH / r;
+        double vyp = velB[i] * cH / r;
+        writeState(i, xp, yp, vxp, vyp, x, y, z, vx, vy, vz);
+    }
+}
+
+void KeplerBatch::propagateNearParabolic(const size_t* idx, size_t count, double t, double* x, double* y, double* z,
+                                         double* vx, double* vy, double* vz) const {
+    // Start from periapsis in the perifocal frame and let the universal-variable step do the rest
+    for (size_t k = 0; k < count; ++k) {
+        const size_t i = idx[k];
+        double xp = q[i], yp = 0.0, zp = 0.0;
+        double vxp = 0.0, vyp = std::sqrt(mu * (1.0 + e[i]) / q[i]), vzp = 0.0;
+        keplerStep(mu, xp, yp, zp, vxp, vyp, vzp, t - tp[i]);
+        writeState(i, xp, yp, vxp, vyp, x, y, z, vx, vy, vz);
+    }
+}
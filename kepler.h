@@ -0,0 +1,68 @@
+#ifndef KEPLER_H
+#define KEPLER_H
+
+#include <cstddef>
+#include <vector>
+
+// Stumpff functions c2(z) and c3(z) used by the universal-variable formulation
+void stumpff(double z, double& c2, double& c3);
+
+// Advance a two-body orbit (relative position/velocity, gravitational parameter mu) by dt.
+// Uses universal variables so elliptic, parabolic and hyperbolic orbits share one path.
+// Returns false if the universal anomaly iteration failed to converge.
+bool keplerStep(double mu, double& x, double& y, double& z, double& vx, double& vy, double& vz, double dt);
+
+// Classical elements of a relative state: periapsis distance q, eccentricity,
+// inclination, longitude of the ascending node, argument of periapsis and true anomaly,
+// angles in radians. Equatorial orbits put the node on the x axis; circular ones put
+// periapsis at the current position.
+void stateToElements(double mu, double x, double y, double z, double vx, double vy, double vz, double elements[6]);
+
+// Batch of Keplerian orbits about one central body, propagated analytically.
+// Orbits are described by periapsis distance q, eccentricity e, orientation and
+// time of periapsis passage, so elliptic, parabolic and hyperbolic orbits share one
+// description. add() precomputes the perifocal basis and per-orbit constants, leaving
+// only the anomaly solve and two vector combinations per orbit per propagate().
+class KeplerBatch {
+public:
+    static constexpr size_t chunkSize = 256;
+
+    explicit KeplerBatch(double mu = 1.0) : mu(mu) {}
+
+    void reserve(size_t n);
+    size_t size() const { return e.size(); }
+
+    // Angles in radians; returns the orbit index used for the outputs
+    size_t add(double q, double ecc, double inc, double raan, double argPeriapsis, double periapsisTime);
+    // Osculating orbit of a relative state vector at time t
+    size_t addFromState(double x, double y, double z, double vx, double vy, double vz, double t);
+
+    // Positions and velocities of every orbit at time t, written at each orbit's index
+    void propagate(double t, double* x, double* y, double* z, double* vx, double* vy, double* vz) const;
+
+    // Independent slices of the work for callers that spread propagation over threads
+    size_t chunkCount() const;
+    void propagateChunk(size_t chunk, double t, double* x, double* y, double* z,
+                        double* vx, double* vy, double* vz) const;
+
+private:
+    double mu;
+    // Per-orbit constants, indexed by orbit
+    std::vector<double> px, py, pz, qx, qy, qz; // Perifocal basis: periapsis direction and 90 degrees ahead
+    std::vector<double> e, q, tp;
+    std::vector<double> meanMotion, semiA, semiB, velA, velB;
+    // Orbit indices grouped by solver so each group runs a branch-free loop
+    std::vector<size_t> elliptic, hyperbolic, nearParabolic;
+
+    size_t addPerifocal(double q, double ecc, const double P[3], const double Q[3], double periapsisTime);
+    void writeState(size_t i, double xp, double yp, double vxp, double vyp, double* x, double* y, double* z,
+                    double* vx, double* vy, double* vz) const;
+    void propagateElliptic(const size_t* idx, size_t count, double t, double* x, double* y, double* z,
+                           double* vx, double* vy, double* vz) const;
+    void propagateHyperbolic(const size_t* idx, size_t count, double t, double* x, double* y, double* z,
+                             double* vx, double* vy, double* vz) const;
+    void propagateNearParabolic(const size_t* idx, size_t count, double t, double* x, double* y, double* z,
+                                double* vx, double* vy, double* vz) const;
+};
+
+#endif
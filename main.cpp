@@ -6,23 +6,68 @@
 #include "glm/glm/glm.hpp"
 #include "glm/glm/gtc/matrix_transform.hpp"
 #include "glm/glm/gtc/type_ptr.hpp"
+#include <algorithm>
 #include <cmath>
 #include <vector>
 #include <iostream>
 #include <random>
+#include <cstring>
+#include <string>
+#include "sgp4.h"
+#include "conjunction.h"
+#include "task_scheduler.h"
+#include "camera.h"
+#include "depth_buffer.h"
+#include "trajectory.h"
+#include "ephemeris.h"
+#include "orbit_trails.h"
+#include "orbit_curves.h"
+#include "sphere_impostors.h"
+#include "kepler.h"
+#include "orbital_particles.h"
+#include "culling.h"
+#include "indirect_spheres.h"
+#include "render_queue.h"
+#include "stream_buffer.h"
+#include "gpu_nbody.h"
+#include "integrators.h"
+#include "checkpoint.h"
+#include "ias15.h"
+#include "block_timestep.h"
+#include "shader.h"
+#include <chrono>
 
-// Vertex Shader Source
+// Vertex Shader Source. The unit sphere is pulled from gl_VertexID alone: vertex v is
+// corner v % 6 of quad v / 6 in a grid of segments x rings quads, split into two
+// triangles the way an indexed latitude-longitude mesh would be. No vertex buffers
+// are bound, so the tessellation can change per draw for free.
 const char* vertexShaderSource = R"(
 #version 330 core
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec2 texCoord;
+uniform int segments;
+uniform int rings;
 
 out vec2 fragTexCoord;
 uniform mat4 mvp;
+#ifdef LOG_DEPTH
+out float logDepthW;
+#endif
+
+const float pi = 3.14159265;
+// Grid offsets of the six corners of a quad
+const ivec2 corners[6] = ivec2[6](ivec2(0, 0), ivec2(0, 1), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1), ivec2(1, 0));
 
 void main() {
+    int quad = gl_VertexID / 6;
+    ivec2 grid = ivec2(quad % segments, quad / segments) + corners[gl_VertexID % 6];
+    float xSegment = float(grid.x) / float(segments);
+    float ySegment = float(grid.y) / float(rings);
+    vec3 position = vec3(cos(xSegment * 2.0 * pi) * sin(ySegment * pi), cos(ySegment * pi),
+                         sin(xSegment * 2.0 * pi) * sin(ySegment * pi));
     gl_Position = mvp * vec4(position, 1.0);
-    fragTexCoord = texCoord; // Pass texture coordinates to fragment shader
+    fragTexCoord = vec2(1.0 - xSegment, ySegment); // S, east increases counterclockwise seen from the north pole
+#ifdef LOG_DEPTH
+    logDepthW = 1.0 + gl_Position.w;
+#endif
 }
 )";
 
@@ -33,47 +78,381 @@ out vec4 color;
 
 in vec2 fragTexCoord;
 uniform sampler2D texture1;
+#ifdef LOG_DEPTH
+in float logDepthW;
+uniform float logDepthCoef;
+#endif
 
 void main() {
     color = texture(texture1, fragTexCoord); // Use the texture color
+#ifdef LOG_DEPTH
+    gl_FragDepth = log2(logDepthW) * logDepthCoef * 0.5;
+#endif
 }
 )";
 
-// Function to generate sphere vertices and texture coordinates
-void generateSphere(float radius, int segments, int rings, std::vector<float>& vertices, std::vector<unsigned int>& indices) {
-    for (int y = 0; y <= rings; ++y) {
-        for (int x = 0; x <= segments; ++x) {
-            float xSegment = (float)x / (float)segments;
-            float ySegment = (float)y / (float)rings;
+// Satellite point shaders
+const char* pointVertexShaderSource = R"(
+#version 330 core
+layout(location = 0) in vec3 position;
+uniform mat4 mvp;
+#ifdef LOG_DEPTH
+out float logDepthW;
+#endif
 
-            float xPos = radius * cos(xSegment * 2.0f * M_PI) * sin(ySegment * M_PI);
-            float yPos = radius * cos(ySegment * M_PI);
-            float zPos = radius * sin(xSegment * 2.0f * M_PI) * sin(ySegment * M_PI);
+void main() {
+    gl_Position = mvp * vec4(position, 1.0);
+#ifdef LOG_DEPTH
+    logDepthW = 1.0 + gl_Position.w;
+#endif
+}
+)";
 
-            vertices.push_back(xPos);
-            vertices.push_back(yPos);
-            vertices.push_back(zPos);
+const char* pointFragmentShaderSource = R"(
+#version 330 core
+out vec4 color;
+uniform vec3 pointColor;
+#ifdef LOG_DEPTH
+in float logDepthW;
+uniform float logDepthCoef;
+#endif
 
-            // Texture coordinates
-            vertices.push_back(xSegment); // S
-            vertices.push_back(ySegment); // T
-        }
+void main() {
+    color = vec4(pointColor, 1.0);
+#ifdef LOG_DEPTH
+    gl_FragDepth = log2(logDepthW) * logDepthCoef * 0.5;
+#endif
+}
+)";
+
+// The frame's projection and camera rotation, streamed once a frame into a uniform
+// block slice that every program declaring it reads
+const GLuint viewBlockBinding = 0;
+
+// GPU-culled sphere meshes: the unit mesh scaled and moved to each instance's
+// camera-relative centre, lit from the eye
+const char* instancedSphereVertexShaderSource = R"(
+#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 sphere; // Camera-relative centre and radius
+layout(std140) uniform View {
+    mat4 projection;
+    mat4 viewRotation;
+};
+out vec3 normal;
+out vec3 toEye;
+#ifdef LOG_DEPTH
+out float logDepthW;
+#endif
+
+void main() {
+    vec3 p = sphere.xyz + sphere.w * position;
+    gl_Position = projection * (viewRotation * vec4(p, 1.0));
+    normal = position;
+    toEye = -p;
+#ifdef LOG_DEPTH
+    logDepthW = 1.0 + gl_Position.w;
+#endif
+}
+)";
+
+const char* instancedSphereFragmentShaderSource = R"(
+#version 330 core
+in vec3 normal;
+in vec3 toEye;
+out vec4 color;
+uniform vec3 sphereColor;
+#ifdef LOG_DEPTH
+in float logDepthW;
+uniform float logDepthCoef;
+#endif
+
+void main() {
+    float light = max(dot(normalize(normal), normalize(toEye)), 0.0);
+    color = vec4(sphereColor * (0.3 + 0.7 * light), 1.0);
+#ifdef LOG_DEPTH
+    gl_FragDepth = log2(logDepthW) * logDepthCoef * 0.5;
+#endif
+}
+)";
+
+// Ring and debris particle sprites: round, soft-edged points summed additively
+const char* particleVertexShaderSource = R"(
+#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in float brightness;
+uniform mat4 mvp;
+uniform float pointSize;
+out float particleBrightness;
+#ifdef LOG_DEPTH
+out float logDepthW;
+#endif
+
+void main() {
+    gl_Position = mvp * vec4(position, 1.0);
+    gl_PointSize = pointSize;
+    particleBrightness = brightness;
+#ifdef LOG_DEPTH
+    logDepthW = 1.0 + gl_Position.w;
+#endif
+}
+)";
+
+const char* particleFragmentShaderSource = R"(
+#version 330 core
+in float particleBrightness;
+out vec4 color;
+uniform vec3 particleColor;
+#ifdef LOG_DEPTH
+in float logDepthW;
+uniform float logDepthCoef;
+#endif
+
+void main() {
+    vec2 d = 2.0 * gl_PointCoord - 1.0;
+    float r2 = dot(d, d);
+    if (r2 > 1.0) {
+        discard;
     }
+    color = vec4(particleColor * (particleBrightness * (1.0 - r2)), 1.0);
+#ifdef LOG_DEPTH
+    gl_FragDepth = log2(logDepthW) * logDepthCoef * 0.5;
+#endif
+}
+)";
 
-    for (int y = 0; y < rings; ++y) {
-        for (int x = 0; x < segments; ++x) {
-            int first = (y * (segments + 1)) + x;
-            int second = first + segments + 1;
+// Orbit trail shaders. Positions are pulled from the trail buffer texture: each trail
+// is a line strip whose vertex index picks the ring slot, oldest first.
+const char* trailVertexShaderSource = R"(
+#version 330 core
+uniform samplerBuffer trailPoints;
+uniform int bodyCount;
+uniform int ringSlots;
+uniform int oldestSlot;
+uniform int trailCount;
+uniform mat4 mvp;
+out float trailAge;
+out float trailValid;
+#ifdef LOG_DEPTH
+out float logDepthW;
+#endif
 
-            indices.push_back(first);
-            indices.push_back(second);
-            indices.push_back(first + 1);
+void main() {
+    int body = gl_VertexID / ringSlots;
+    int step = gl_VertexID - body * ringSlots;
+    int texel = (((oldestSlot + step) % ringSlots) * bodyCount + body) * 3;
+    vec3 position = vec3(texelFetch(trailPoints, texel).r, texelFetch(trailPoints, texel + 1).r,
+                         texelFetch(trailPoints, texel + 2).r);
+    trailAge = float(step + 1) / float(trailCount); // Newest sample is 1
+    trailValid = isnan(position.x) || isinf(position.x) ? 0.0 : 1.0;
+    gl_Position = trailValid > 0.0 ? mvp * vec4(position, 1.0) : vec4(0.0, 0.0, 0.0, 1.0);
+#ifdef LOG_DEPTH
+    logDepthW = 1.0 + gl_Position.w;
+#endif
+}
+)";
 
-            indices.push_back(second);
-            indices.push_back(second + 1);
-            indices.push_back(first + 1);
-        }
+const char* trailFragmentShaderSource = R"(
+#version 330 core
+out vec4 color;
+in float trailAge;
+in float trailValid;
+uniform vec3 trailColor;
+#ifdef LOG_DEPTH
+in float logDepthW;
+uniform float logDepthCoef;
+#endif
+
+void main() {
+    // Segments reaching a non-finite sample interpolate below 1 and are dropped
+    if (trailValid < 0.999) {
+        discard;
+    }
+    color = vec4(trailColor, 0.6 * trailAge * trailAge);
+#ifdef LOG_DEPTH
+    gl_FragDepth = log2(logDepthW) * logDepthCoef * 0.5;
+#endif
+}
+)";
+
+// Orbit curve shaders. Each instance is one orbit's elements; vertex gl_VertexID is
+// placed on its conic at evenly spaced tangent directions, so every segment turns by
+// the same angle and periapsis stays smooth however eccentric the orbit.
+const char* orbitVertexShaderSource = R"(
+#version 330 core
+layout(location = 0) in vec3 shape;       // Periapsis distance, eccentricity, inclination
+layout(location = 1) in vec3 orientation; // Ascending node, argument of periapsis, true anomaly now
+uniform mat4 mvp;
+uniform int segments;
+uniform float maxRadius;
+out float orbitFade;
+#ifdef LOG_DEPTH
+out float logDepthW;
+#endif
+
+const float twoPi = 6.28318531;
+
+void main() {
+    float q = shape.x;
+    float s = float(gl_VertexID) / float(segments);
+    vec2 perifocal;
+    float lag; // How far behind the body the vertex is, 0 to 1 along the drawn curve
+    if (shape.y < 1.0) {
+        float e = shape.y;
+        float a = q / (1.0 - e);
+        float b = a * sqrt(1.0 - e * e);
+        // The tangent at eccentric anomaly E points along (-a sin E, b cos E)
+        float psi = twoPi * s;
+        float E = atan(b * sin(psi), a * cos(psi));
+        perifocal = vec2(a * (cos(E) - e), b * sin(E));
+        float nowE = 2.0 * atan(sqrt((1.0 - e) / (1.0 + e)) * tan(0.5 * orientation.z));
+        lag = fract(((nowE - e * sin(nowE)) - (E - e * sin(E))) / twoPi);
+    } else {
+        float e = max(shape.y, 1.0001); // Parabolas as barely open hyperbolas
+        float a = q / (e - 1.0);
+        float b = a * sqrt(e * e - 1.0);
+        // The tangent at hyperbolic anomaly F points along (-a sinh F, b cosh F)
+        float maxF = acosh(max((maxRadius / a + 1.0) / e, 1.0));
+        float theta = atan(a / b * tanh(maxF)) * (2.0 * s - 1.0);
+        float F = atanh(b / a * tan(theta));
+        perifocal = vec2(a * (e - cosh(F)), b * sinh(F));
+        float nowF = 2.0 * atanh(sqrt((e - 1.0) / (e + 1.0)) * tan(0.5 * orientation.z));
+        float behind = (e * sinh(nowF) - nowF) - (e * sinh(F) - F);
+        lag = behind >= 0.0 ? behind / (2.0 * (e * sinh(maxF) - maxF)) : 1.0;
+    }
+    float cO = cos(orientation.x), sO = sin(orientation.x);
+    float cw = cos(orientation.y), sw = sin(orientation.y);
+    float ci = cos(shape.z), si = sin(shape.z);
+    vec3 P = vec3(cO * cw - sO * sw * ci, sO * cw + cO * sw * ci, sw * si);
+    vec3 Q = vec3(-cO * sw - sO * cw * ci, -sO * sw + cO * cw * ci, cw * si);
+    orbitFade = 1.0 - 0.85 * lag;
+    // Unused orbits land outside the clip volume
+    gl_Position = q > 0.0 ? mvp * vec4(perifocal.x * P + perifocal.y * Q, 1.0) : vec4(2.0, 2.0, 2.0, 1.0);
+#ifdef LOG_DEPTH
+    logDepthW = 1.0 + gl_Position.w;
+#endif
+}
+)";
+
+const char* orbitFragmentShaderSource = R"(
+#version 330 core
+out vec4 color;
+in float orbitFade;
+uniform vec3 orbitColor;
+#ifdef LOG_DEPTH
+in float logDepthW;
+uniform float logDepthCoef;
+#endif
+
+void main() {
+    color = vec4(orbitColor, 0.5 * orbitFade);
+#ifdef LOG_DEPTH
+    gl_FragDepth = log2(logDepthW) * logDepthCoef * 0.5;
+#endif
+}
+)";
+
+// Sphere impostor shaders. Each instance is a quad through the sphere's centre facing
+// the camera, sized to the cone of grazing sight lines; fragments ray-trace the sphere
+// relative to its centre, write the hit's depth and texture it like the sphere mesh.
+const char* impostorVertexShaderSource = R"(
+#version 330 core
+layout(location = 0) in vec4 centerRadius;  // Camera-relative scene centre, radius
+layout(location = 1) in vec4 colorTexture;  // Colour, texture weight
+layout(location = 2) in float spin;
+layout(std140) uniform View {
+    mat4 projection;
+    mat4 viewRotation;
+};
+flat out vec3 sphereCenter; // View space
+flat out float sphereRadius;
+flat out vec4 sphereColor;
+flat out float sphereSpin;
+out vec3 quadOffset;        // From the centre, view space
+
+void main() {
+    vec3 center = (viewRotation * vec4(centerRadius.xyz, 0.0)).xyz;
+    float radius = centerRadius.w;
+    float distance = length(center);
+    sphereCenter = center;
+    sphereRadius = radius;
+    sphereColor = colorTexture;
+    sphereSpin = spin;
+    if (distance <= radius * 1.0001) {
+        quadOffset = vec3(0.0);
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0); // Camera inside; outside the clip volume
+        return;
     }
+    // The grazing cone meets the plane through the centre in a circle of this radius
+    float halfSize = radius * distance / sqrt((distance - radius) * (distance + radius));
+    vec3 w = center / distance;
+    vec3 u = normalize(abs(w.y) < 0.99 ? cross(w, vec3(0.0, 1.0, 0.0)) : cross(w, vec3(1.0, 0.0, 0.0)));
+    vec3 v = cross(u, w);
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    quadOffset = (corner.x * u + corner.y * v) * halfSize;
+    gl_Position = projection * vec4(center + quadOffset, 1.0);
+}
+)";
+
+const char* impostorFragmentShaderSource = R"(
+#version 330 core
+out vec4 color;
+flat in vec3 sphereCenter;
+flat in float sphereRadius;
+flat in vec4 sphereColor;
+flat in float sphereSpin;
+in vec3 quadOffset;
+layout(std140) uniform View {
+    mat4 projection;
+    mat4 viewRotation;
+};
+uniform sampler2D texture1;
+#ifdef LOG_DEPTH
+uniform float logDepthCoef;
+#endif
+
+const float pi = 3.14159265;
+
+void main() {
+    // Sight line through this fragment, solved from the quad point so every term is
+    // on the scale of the radius rather than the distance
+    vec3 direction = normalize(sphereCenter + quadOffset);
+    float b = dot(quadOffset, direction);
+    float c = dot(quadOffset, quadOffset) - sphereRadius * sphereRadius;
+    float discriminant = b * b - c;
+    if (discriminant < 0.0) {
+        discard;
+    }
+    vec3 hit = quadOffset - (b + sqrt(discriminant)) * direction;
+    vec4 clip = projection * vec4(sphereCenter + hit, 1.0);
+#ifdef LOG_DEPTH
+    gl_FragDepth = log2(1.0 + clip.w) * logDepthCoef * 0.5;
+#else
+    gl_FragDepth = clip.z / clip.w;
+#endif
+
+    // Normal in the body's frame: undo the view rotation, then the spin about y
+    vec3 n = transpose(mat3(viewRotation)) * (hit / sphereRadius);
+    float cs = cos(sphereSpin), ss = sin(sphereSpin);
+    n = vec3(cs * n.x - ss * n.z, n.y, ss * n.x + cs * n.z);
+    // Longitude from atan wraps at the seam; take whichever of the two continuous
+    // versions has the smaller screen derivative so the mip level stays right
+    float longitude = atan(n.z, n.x) / (2.0 * pi);
+    float wrapped = fract(longitude);
+    float centered = fract(longitude + 0.5) - 0.5;
+    float s = fwidth(wrapped) <= fwidth(centered) + 1e-6 ? wrapped : centered;
+    vec3 surface = texture(texture1, vec2(1.0 - s, acos(clamp(n.y, -1.0, 1.0)) / pi)).rgb;
+    color = vec4(sphereColor.rgb * mix(vec3(1.0), surface, sphereColor.a), 1.0);
+}
+)";
+
+// Tessellation of the procedural sphere for a given on-screen radius in pixels. The
+// chord sagitta of a segment is about radius * (pi / segments)^2 / 2, so pi * sqrt(radius)
+// segments keep it under half a pixel.
+void sphereTessellation(double pixelRadius, int& segments, int& rings) {
+    int needed = (int)std::ceil(M_PI * std::sqrt(std::max(pixelRadius, 0.0)));
+    segments = std::min(std::max((needed + 7) / 8 * 8, 16), 512);
+    rings = segments / 2;
 }
 
 // Function to generate random star positions
@@ -89,32 +468,28 @@ void generateStars(int numStars, std::vector<glm::vec3>& stars) {
     }
 }
 
-// Function to compile shaders
-GLuint compileShader(GLenum type, const char* source) {
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, NULL);
-    glCompileShader(shader);
-    // Check for compilation errors
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        GLchar infoLog[512];
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
-    }
-    return shader;
+// Function to compile shaders; defines are inserted after the #version line
+// Image decoded off the GL thread, waiting to be uploaded
+struct DecodedImage {
+    int width = 0, height = 0, channels = 0;
+    unsigned char* data = nullptr;
+};
+
+// Decode an image file on the task scheduler; the GL upload stays on the context thread
+TaskHandle decodeTexture(const char* path, DecodedImage& image) {
+    return TaskScheduler::instance().submit([path, &image] {
+        image.data = stbi_load(path, &image.width, &image.height, &image.channels, 0);
+    });
 }
 
-// Function to load texture
-GLuint loadTexture(const char* path) {
+// Function to load texture from a decoded image; frees the pixels once uploaded
+GLuint loadTexture(DecodedImage& image) {
     GLuint textureID;
     glGenTextures(1, &textureID);
     
-    int width, height, channels;
-    unsigned char* data = stbi_load(path, &width, &height, &channels, 0);
-    if (data) {
+    if (image.data) {
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data);
         glGenerateMipmap(GL_TEXTURE_2D);
         
         // Set texture parameters
@@ -125,14 +500,719 @@ GLuint loadTexture(const char* path) {
     } else {
         std::cerr << "Failed to load texture" << std::endl;
     }
-    stbi_image_free(data);
+    stbi_image_free(image.data);
+    image.data = nullptr;
     
     return textureID;
 }
 
-int main() {
+// Simulation clock for the satellite view; arrows scrub, up/down change rate, space pauses
+struct SimClock {
+    double jd = 0.0;
+    double timeScale = 60.0; // Simulated seconds per real second
+    bool paused = false;
+    bool upWasDown = false, downWasDown = false, spaceWasDown = false;
+
+    void update(GLFWwindow* window, double realDt) {
+        bool up = glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS;
+        bool down = glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS;
+        bool space = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+        if (up && !upWasDown) {
+            timeScale *= 2.0;
+        }
+        if (down && !downWasDown) {
+            timeScale *= 0.5;
+        }
+        if (space && !spaceWasDown) {
+            paused = !paused;
+        }
+        upWasDown = up;
+        downWasDown = down;
+        spaceWasDown = space;
+
+        double rate = paused ? 0.0 : timeScale;
+        // Scrubbing runs 30x the current rate in either direction, also while paused
+        if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
+            rate = 30.0 * timeScale;
+        } else if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
+            rate = -30.0 * timeScale;
+        }
+        jd += realDt * rate / 86400.0;
+    }
+};
+
+// Mouse wheel zooms the camera stored in the window's user pointer
+void scrollCallback(GLFWwindow* window, double, double yOffset) {
+    Camera* camera = static_cast<Camera*>(glfwGetWindowUserPointer(window));
+    if (camera) {
+        camera->zoom(yOffset);
+    }
+}
+
+// W/S and A/D orbit the camera around its target
+void updateCamera(GLFWwindow* window, Camera& camera, double realDt) {
+    const double rate = 1.0; // Radians per second
+    double dYaw = 0.0, dPitch = 0.0;
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+        dYaw -= rate * realDt;
+    }
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+        dYaw += rate * realDt;
+    }
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+        dPitch += rate * realDt;
+    }
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+        dPitch -= rate * realDt;
+    }
+    camera.orbit(dYaw, dPitch);
+}
+
+// Solar system bodies drawn from the ephemeris, with their colours, point sizes and radii
+struct EphemerisMarker {
+    EphemerisBody body;
+    float r, g, b, size;
+    double radiusKm;
+};
+
+const EphemerisMarker ephemerisMarkers[] = {
+    {EphemerisBody::Sun, 1.0f, 0.95f, 0.6f, 8.0f, 695700.0},    {EphemerisBody::Moon, 0.8f, 0.8f, 0.8f, 5.0f, 1737.4},
+    {EphemerisBody::Mercury, 0.7f, 0.6f, 0.5f, 3.0f, 2439.7},   {EphemerisBody::Venus, 1.0f, 0.9f, 0.7f, 4.0f, 6051.8},
+    {EphemerisBody::Mars, 1.0f, 0.4f, 0.2f, 4.0f, 3389.5},      {EphemerisBody::Jupiter, 0.9f, 0.8f, 0.6f, 5.0f, 69911.0},
+    {EphemerisBody::Saturn, 0.9f, 0.85f, 0.55f, 5.0f, 58232.0}, {EphemerisBody::Uranus, 0.6f, 0.9f, 1.0f, 4.0f, 25362.0},
+    {EphemerisBody::Neptune, 0.4f, 0.5f, 1.0f, 4.0f, 24622.0},
+};
+
+// Queue the Sun, Moon and planets at their geocentric positions for a UTC Julian date.
+// Each gets a point, which keeps it visible below a pixel, and a sphere impostor that
+// covers the point once the disc is larger. Points are written to the stream, which the
+// vertex array reads from its start.
+void submitEphemerisBodies(ChebyshevEphemeris& ephemeris, double jdUtc, const Camera& camera, const glm::mat4& projection,
+                           GLuint program, GLuint vao, StreamBuffer& stream, RenderQueue& queue,
+                           std::vector<SphereImpostor>& impostors) {
+    // DE files run on TDB, about 69 s ahead of UTC since 2017
+    const double jdTdb = jdUtc + 69.184 / 86400.0;
+    const glm::dvec3 eye = camera.position();
+    const glm::mat4 mvp = projection * glm::mat4(camera.viewRotation());
+    for (const EphemerisMarker& marker : ephemerisMarkers) {
+        double p[3];
+        if (!ephemeris.state(marker.body, EphemerisBody::Earth, jdTdb, p, nullptr)) {
+            continue;
+        }
+        // ICRF to scene axes as for TEME, camera-relative before rounding to float
+        const glm::vec3 point((float)(-p[0] - eye.x), (float)(p[2] - eye.y), (float)(p[1] - eye.z));
+        const float distance = (float)std::sqrt(glm::dot(point, point));
+        GLintptr offset;
+        float* slice = static_cast<float*>(stream.allocate(sizeof(point), sizeof(point), offset));
+        if (slice) {
+            std::memcpy(slice, &point.x, sizeof(point));
+            const GLint first = GLint(offset / GLintptr(sizeof(point)));
+            queue.submit(RenderLayer::Opaque, program, 0, vao, distance, [=, &marker]() {
+                glUniformMatrix4fv(glGetUniformLocation(program, "mvp"), 1, GL_FALSE, glm::value_ptr(mvp));
+                glUniform3f(glGetUniformLocation(program, "pointColor"), marker.r, marker.g, marker.b);
+                glPointSize(marker.size);
+                glDrawArrays(GL_POINTS, first, 1);
+            });
+        }
+        impostors.push_back({{point.x, point.y, point.z}, (float)marker.radiusKm,
+                             {marker.r, marker.g, marker.b}, 0.0f, 0.0f});
+    }
+}
+
+// Giant planets on circular orbits for the offline integrator runs: mass in solar
+// masses, radius in AU, inclination and phase in degrees
+const double outerPlanets[][4] = {
+    {9.548e-4, 5.203, 1.30, 34.4}, {2.858e-4, 9.537, 2.49, 50.1},
+    {4.366e-5, 19.19, 0.77, 314.1}, {5.151e-5, 30.07, 1.77, 304.3},
+};
+
+// The Sun and the giant planets in AU, years and solar masses (G = 4 pi^2), about the
+// barycenter. The Sun is body 0, as the Wisdom-Holman integrator expects.
+void addOuterPlanets(BodySystem& s, double G) {
+    s.addBody(1.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+    for (const auto& planet : outerPlanets) {
+        const double inclination = glm::radians(planet[2]), phase = glm::radians(planet[3]);
+        const double r = planet[1], speed = std::sqrt(G * (1.0 + planet[0]) / r);
+        const double c = std::cos(phase), sn = std::sin(phase);
+        s.addBody(planet[0], r * c, r * sn * std::cos(inclination), r * sn * std::sin(inclination),
+                  -speed * sn, speed * c * std::cos(inclination), speed * c * std::sin(inclination));
+    }
+    moveToCenterOfMass(s);
+}
+
+int main(int argc, char** argv) {
+    // Optional TLE catalog; without one only the Earth and stars are drawn
+    const char* catalogPath = argc > 1 ? argv[1] : "catalog.tle";
+    Sgp4Catalog catalog;
+    catalog.loadTleFile(catalogPath);
+
+    // "--screen [hours]" runs a conjunction screen from the latest epoch and exits
+    if (argc > 2 && std::strcmp(argv[2], "--screen") == 0) {
+        double hours = argc > 3 ? std::atof(argv[3]) : 24.0;
+        ConjunctionScreener screener;
+        double start = catalog.latestEpoch();
+        screener.screen(catalog, start, start + hours / 24.0, [&](const Conjunction& c) {
+            std::cout << catalog.name(c.a) << " / " << catalog.name(c.b) << "  TCA +" << (c.tcaJd - start) * 24.0
+                      << " h  miss " << c.missDistanceKm << " km  speed " << c.relativeSpeedKmS << " km/s" << std::endl;
+        });
+        std::cout << screener.stats.conjunctions << " conjunctions, " << screener.stats.candidates
+                  << " candidates refined, " << screener.stats.pairTests << " pair tests over "
+                  << screener.stats.steps << " steps" << std::endl;
+        return 0;
+    }
+
+    // "--record file [hours] [step seconds]" propagates the catalog from the latest epoch
+    // and writes a compressed trajectory (seconds from the epoch, TEME km) then exits
+    if (argc > 3 && std::strcmp(argv[2], "--record") == 0) {
+        double hours = argc > 4 ? std::atof(argv[4]) : 24.0;
+        double stepSeconds = argc > 5 ? std::atof(argv[5]) : 60.0;
+        const size_t count = catalog.size();
+        std::vector<double> x(count), y(count), z(count), vx(count), vy(count), vz(count);
+        std::vector<std::uint8_t> errors(count);
+        TrajectoryRecorder recorder;
+        recorder.positionQuantum = 1.0e-3; // 1 m
+        recorder.velocityQuantum = 1.0e-6; // 1 mm/s
+        recorder.epoch = catalog.latestEpoch();
+        recorder.blocking = true; // Nothing runs alongside, so wait on the encoder rather than drop samples
+        if (!recorder.open(argv[3], count)) {
+            return -1;
+        }
+        for (double t = 0.0; t <= hours * 3600.0; t += stepSeconds) {
+            catalog.propagateParallel(recorder.epoch + t / 86400.0, x.data(), y.data(), z.data(), vx.data(), vy.data(),
+                                      vz.data(), errors.data());
+            // Failed satellites are stored as NaN so playback can leave them out
+            for (size_t i = 0; i < count; ++i) {
+                if (errors[i] != Sgp4Ok) {
+                    x[i] = y[i] = z[i] = vx[i] = vy[i] = vz[i] = NAN;
+                }
+            }
+            recorder.record(t, x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data());
+        }
+        recorder.close();
+        std::cout << recorder.samplesRecorded() << " samples (" << recorder.samplesDropped() << " dropped), "
+                  << recorder.compressedBytes() << " bytes, ratio "
+                  << double(recorder.rawBytes()) / std::max(1LL, recorder.compressedBytes()) << std::endl;
+        return recorder.failed() ? -1 : 0;
+    }
+
+    // "--gpu-benchmark [bodies] [steps]" races the compute-shader backend against the CPU
+    // kernel on one random cluster and exits. The window stays hidden, so software GL
+    // such as Mesa's llvmpipe under a virtual display is enough.
+    if (argc > 2 && std::strcmp(argv[2], "--gpu-benchmark") == 0) {
+        const size_t bodies = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 16384;
+        const int steps = argc > 4 ? std::atoi(argv[4]) : 10;
+        if (!glfwInit()) {
+            return -1;
+        }
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        GLFWwindow* window = glfwCreateWindow(64, 64, "N-body benchmark", NULL, NULL);
+        if (!window) {
+            std::cerr << "No OpenGL 4.3 context" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glewExperimental = GL_TRUE;
+        GpuGravity gpu;
+        if (glewInit() != GLEW_OK || !gpu.init()) {
+            glfwTerminate();
+            return -1;
+        }
+        std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+        // Uniform ball of equal masses with small random velocities
+        BodySystem cluster;
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+        while (cluster.size() < bodies) {
+            double px = uniform(rng), py = uniform(rng), pz = uniform(rng);
+            if (px * px + py * py + pz * pz <= 1.0) {
+                cluster.addBody(1.0 / bodies, px, py, pz, 0.1 * uniform(rng), 0.1 * uniform(rng), 0.1 * uniform(rng));
+            }
+        }
+        DirectGravity cpu;
+        cpu.softening = gpu.softening = 0.01;
+        auto seconds = [](std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        // One force evaluation each, the GPU's including its transfers
+        std::vector<double> gx(bodies), gy(bodies), gz(bodies);
+        gpu.accelerations(bodies, cluster.x.data(), cluster.y.data(), cluster.z.data(), cluster.mass.data(),
+                          gx.data(), gy.data(), gz.data()); // Warm-up
+        auto start = std::chrono::steady_clock::now();
+        computeAccelerations(cluster, cpu);
+        const double cpuForce = seconds(start);
+        start = std::chrono::steady_clock::now();
+        gpu.accelerations(bodies, cluster.x.data(), cluster.y.data(), cluster.z.data(), cluster.mass.data(),
+                          gx.data(), gy.data(), gz.data());
+        const double gpuForce = seconds(start);
+        double worst = 0.0;
+        for (size_t i = 0; i < bodies; ++i) {
+            double a = std::sqrt(cluster.ax[i] * cluster.ax[i] + cluster.ay[i] * cluster.ay[i] + cluster.az[i] * cluster.az[i]);
+            double d = std::sqrt((gx[i] - cluster.ax[i]) * (gx[i] - cluster.ax[i]) + (gy[i] - cluster.ay[i]) * (gy[i] - cluster.ay[i]) +
+                                 (gz[i] - cluster.az[i]) * (gz[i] - cluster.az[i]));
+            worst = std::max(worst, d / a);
+        }
+
+        // Leapfrog steps; the GPU keeps everything on the device until the end
+        const double dt = 1.0e-3;
+        const double energy = totalEnergy(cluster, cpu.G, cpu.softening);
+        BodySystem gpuCluster = cluster;
+        gpu.upload(gpuCluster);
+        start = std::chrono::steady_clock::now();
+        for (int k = 0; k < steps; ++k) {
+            kickDriftKick(cluster, cpu, dt);
+        }
+        const double cpuSteps = seconds(start);
+        start = std::chrono::steady_clock::now();
+        gpu.step(dt, steps);
+        glFinish();
+        const double gpuSteps = seconds(start);
+        gpu.download(gpuCluster);
+
+        std::cout << bodies << " bodies, " << TaskScheduler::instance().concurrency() << " CPU threads" << std::endl;
+        std::cout << "Force evaluation: CPU " << cpuForce * 1e3 << " ms, GPU " << gpuForce * 1e3
+                  << " ms with transfers, worst relative difference " << worst << std::endl;
+        std::cout << steps << " steps: CPU " << cpuSteps * 1e3 / steps << " ms/step, GPU " << gpuSteps * 1e3 / steps
+                  << " ms/step" << std::endl;
+        std::cout << "Relative energy change: CPU " << (totalEnergy(cluster, cpu.G, cpu.softening) - energy) / std::fabs(energy)
+                  << ", GPU " << (totalEnergy(gpuCluster, cpu.G, cpu.softening) - energy) / std::fabs(energy) << std::endl;
+        gpu.destroy();
+        glfwTerminate();
+        return 0;
+    }
+
+    // "--reduction-benchmark [bodies] [evaluations]" times DirectGravity's fast,
+    // deterministic and compensated reductions on one random cluster under the current
+    // TASK_THREADS, and prints a hash of each mode's accelerations. The deterministic
+    // and compensated hashes must not change with the thread count.
+    if (argc > 2 && std::strcmp(argv[2], "--reduction-benchmark") == 0) {
+        const size_t bodies = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 8192;
+        const int evaluations = argc > 4 ? std::atoi(argv[4]) : 5;
+        BodySystem cluster;
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+        while (cluster.size() < bodies) {
+            double px = uniform(rng), py = uniform(rng), pz = uniform(rng);
+            if (px * px + py * py + pz * pz <= 1.0) {
+                cluster.addBody(1.0 / bodies, px, py, pz, 0.0, 0.0, 0.0);
+            }
+        }
+        std::cout << bodies << " bodies, " << TaskScheduler::instance().concurrency() << " threads" << std::endl;
+        const ReductionMode modes[] = {ReductionMode::Fast, ReductionMode::Deterministic, ReductionMode::Compensated};
+        const char* names[] = {"fast", "deterministic", "compensated"};
+        double fastSeconds = 0.0;
+        for (int k = 0; k < 3; ++k) {
+            DirectGravity gravity;
+            gravity.softening = 0.01;
+            gravity.reduction = modes[k];
+            computeAccelerations(cluster, gravity); // Warm-up, and sizes the scratch
+            const auto start = std::chrono::steady_clock::now();
+            for (int e = 0; e < evaluations; ++e) {
+                computeAccelerations(cluster, gravity);
+            }
+            const double seconds =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / std::max(evaluations, 1);
+            if (k == 0) {
+                fastSeconds = seconds;
+            }
+            // FNV-1a over the bytes of ax, ay and az
+            std::uint64_t hash = 1469598103934665603ull;
+            for (const std::vector<double>* a : {&cluster.ax, &cluster.ay, &cluster.az}) {
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(a->data());
+                for (size_t i = 0; i < a->size() * sizeof(double); ++i) {
+                    hash = (hash ^ bytes[i]) * 1099511628211ull;
+                }
+            }
+            std::cout << names[k] << ": " << seconds * 1000.0 << " ms per evaluation, " << seconds / fastSeconds
+                      << "x fast, hash " << std::hex << hash << std::dec << std::endl;
+        }
+        return 0;
+    }
+
+    // "--integrate name [steps] [checkpoint]" runs one of the symplectic integrators
+    // (leapfrog, yoshida4, yoshida6 or wh) over the Sun and giant planets with 0.05-year
+    // steps, reports the energy drift and exits. With a checkpoint path the state is saved
+    // halfway, and a fresh integrator restored from the file must finish bit for bit
+    // where the uninterrupted run did.
+    if (argc > 3 && std::strcmp(argv[2], "--integrate") == 0) {
+        IntegratorSet<DirectGravity> integrator;
+        if (!parseIntegratorKind(argv[3], integrator.kind)) {
+            std::cerr << "Unknown integrator " << argv[3] << std::endl;
+            return -1;
+        }
+        const int steps = argc > 4 ? std::atoi(argv[4]) : 10000;
+        const double dt = 0.05;
+        DirectGravity gravity;
+        gravity.G = 4.0 * M_PI * M_PI;
+        BodySystem planets;
+        addOuterPlanets(planets, gravity.G);
+        const double energy = totalEnergy(planets, gravity.G);
+
+        const char* checkpointPath = argc > 5 ? argv[5] : nullptr;
+        const int firstLeg = checkpointPath ? steps / 2 : steps;
+        CheckpointWriter checkpoints;
+
+        auto start = std::chrono::steady_clock::now();
+        integrator.integrate(planets, gravity, dt, firstLeg);
+        if (checkpointPath) {
+            checkpoints.snapshot(checkpointPath, planets, std::uint32_t(integrator.kind));
+            integrator.integrate(planets, gravity, dt, steps - firstLeg);
+        }
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << integratorName(integrator.kind) << ": " << steps << " steps to t = " << planets.time << " years in "
+                  << elapsed * 1e3 << " ms, relative energy change "
+                  << (totalEnergy(planets, gravity.G) - energy) / std::fabs(energy) << std::endl;
+        if (!checkpointPath) {
+            return 0;
+        }
+
+        checkpoints.flush();
+        CheckpointFile file;
+        BodySystem restarted;
+        std::uint32_t kind = 0;
+        if (checkpoints.failedWrites() > 0 || !file.open(checkpointPath) || !file.restore(restarted, &kind)) {
+            return -1;
+        }
+        IntegratorSet<DirectGravity> resumed;
+        resumed.kind = IntegratorKind(kind);
+        resumed.integrate(restarted, gravity, dt, steps - firstLeg);
+        bool identical = restarted.size() == planets.size() &&
+                         std::memcmp(&restarted.time, &planets.time, sizeof(double)) == 0;
+        const std::vector<double>* original[] = {&planets.x, &planets.y, &planets.z, &planets.vx, &planets.vy, &planets.vz};
+        const std::vector<double>* resumedArrays[] = {&restarted.x, &restarted.y, &restarted.z,
+                                                      &restarted.vx, &restarted.vy, &restarted.vz};
+        for (int k = 0; k < 6 && identical; ++k) {
+            identical = std::memcmp(original[k]->data(), resumedArrays[k]->data(), planets.size() * sizeof(double)) == 0;
+        }
+        std::cout << "Restart from " << checkpointPath << " at t = " << file.time() << " years "
+                  << (identical ? "matches the uninterrupted run bit for bit" : "DIVERGES from the uninterrupted run")
+                  << std::endl;
+        return identical ? 0 : -1;
+    }
+
+    // "--ias15 [years]" integrates the Sun and giant planets with IAS15 and reports the
+    // energy drift and step counts. It then checks the encounter-subset path: one more year
+    // of the Sun and Jupiter alone, with the other planets as fixed field sources, against
+    // the same year of the full system. Exits afterwards.
+    if (argc > 2 && std::strcmp(argv[2], "--ias15") == 0) {
+        const double years = argc > 3 ? std::atof(argv[3]) : 1000.0;
+        DirectGravity gravity;
+        gravity.G = 4.0 * M_PI * M_PI;
+        BodySystem planets;
+        addOuterPlanets(planets, gravity.G);
+        const double energy = totalEnergy(planets, gravity.G);
+
+        Ias15Integrator<DirectGravity> ias15;
+        ias15.reserve(planets.size());
+        auto start = std::chrono::steady_clock::now();
+        ias15.integrate(planets, gravity, years);
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "IAS15: t = " << planets.time << " years in " << elapsed * 1e3 << " ms, " << ias15.acceptedSteps
+                  << " steps (" << ias15.rejectedSteps << " rejected), relative energy change "
+                  << (totalEnergy(planets, gravity.G) - energy) / std::fabs(energy) << std::endl;
+        if (ias15.failed) {
+            std::cerr << "IAS15 stopped on non-finite forces" << std::endl;
+            return -1;
+        }
+
+        BodySystem full = planets, pair = planets;
+        Ias15Integrator<DirectGravity> fullRun, pairRun;
+        const double tEnd = planets.time + 1.0;
+        fullRun.integrate(full, gravity, tEnd);
+        const size_t sunAndJupiter[] = {0, 1};
+        pairRun.integrateSubset(pair, gravity, sunAndJupiter, 2, tEnd);
+        const double miss = std::sqrt((pair.x[1] - full.x[1]) * (pair.x[1] - full.x[1]) +
+                                      (pair.y[1] - full.y[1]) * (pair.y[1] - full.y[1]) +
+                                      (pair.z[1] - full.z[1]) * (pair.z[1] - full.z[1]));
+        std::cout << "Subset of 2 bodies over one year: " << pairRun.acceptedSteps << " steps, Jupiter within "
+                  << miss << " AU of the full run (" << fullRun.acceptedSteps << " steps)" << std::endl;
+        return 0;
+    }
+
+    // "--block-timestep [blocks]" adds a 0.1 AU planet to the Sun and giant planets, so a
+    // few bodies need far shorter steps than the rest, integrates whole 0.05-year blocks
+    // with block timesteps, reports each body's rung, the force evaluations saved over a
+    // shared step at the finest rung and the energy drift, and exits
+    if (argc > 2 && std::strcmp(argv[2], "--block-timestep") == 0) {
+        const int blocks = argc > 3 ? std::atoi(argv[3]) : 2000;
+        DirectGravity gravity;
+        gravity.G = 4.0 * M_PI * M_PI;
+        BodySystem planets;
+        addOuterPlanets(planets, gravity.G);
+        planets.addBody(3.0e-6, 0.1, 0.0, 0.0, 0.0, std::sqrt(gravity.G / 0.1), 0.0);
+        moveToCenterOfMass(planets);
+        const double energy = totalEnergy(planets, gravity.G);
+
+        BlockTimestepIntegrator<DirectGravity> integrator;
+        integrator.dtMax = 0.05;
+        integrator.maxRung = 12;
+        auto start = std::chrono::steady_clock::now();
+        integrator.integrate(planets, gravity, blocks);
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Rungs:";
+        for (size_t i = 0; i < planets.size(); ++i) {
+            std::cout << " " << integrator.rungOf(i);
+        }
+        std::cout << std::endl;
+        std::cout << blocks << " blocks to t = " << planets.time << " years in " << elapsed * 1e3 << " ms: "
+                  << integrator.forceTargetEvaluations << " target evaluations instead of "
+                  << integrator.fullEvaluationEquivalent << " ("
+                  << 100.0 * (1.0 - double(integrator.forceTargetEvaluations) /
+                              double(std::max(1LL, integrator.fullEvaluationEquivalent)))
+                  << "% saved), relative energy change " << (totalEnergy(planets, gravity.G) - energy) / std::fabs(energy)
+                  << std::endl;
+        return 0;
+    }
+
+    // "--kepler-check" propagates elliptic, near-parabolic, parabolic and hyperbolic orbits
+    // with KeplerBatch and compares each, forwards and backwards in time, with the
+    // universal-variable keplerStep from its periapsis state. It also rebuilds every orbit
+    // with addFromState from a later state. Exits non-zero if any position is off by more
+    // than 1e-9 of its radius.
+    if (argc > 2 && std::strcmp(argv[2], "--kepler-check") == 0) {
+        const double eccentricities[] = {0.0, 0.3, 0.9, 0.99, 1.0, 1.01, 1.5, 5.0};
+        const size_t count = sizeof(eccentricities) / sizeof(eccentricities[0]);
+        const double times[] = {-40.0, -3.0, -0.4, 0.7, 5.0, 60.0};
+        KeplerBatch batch(1.0), rebuilt(1.0);
+        for (size_t k = 0; k < count; ++k) {
+            batch.add(1.0, eccentricities[k], 0.3 + 0.1 * k, 0.7 * k, 1.1 * k, 0.0);
+        }
+        std::vector<double> x0(count), y0(count), z0(count), vx0(count), vy0(count), vz0(count);
+        std::vector<double> x(count), y(count), z(count), vx(count), vy(count), vz(count);
+        batch.propagate(0.0, x0.data(), y0.data(), z0.data(), vx0.data(), vy0.data(), vz0.data());
+        std::vector<double> worst(count, 0.0);
+        for (double t : times) {
+            batch.propagate(t, x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data());
+            for (size_t k = 0; k < count; ++k) {
+                double rx = x0[k], ry = y0[k], rz = z0[k], rvx = vx0[k], rvy = vy0[k], rvz = vz0[k];
+                if (!keplerStep(1.0, rx, ry, rz, rvx, rvy, rvz, t)) {
+                    worst[k] = HUGE_VAL;
+                    continue;
+                }
+                const double r = std::sqrt(rx * rx + ry * ry + rz * rz);
+                const double d = std::sqrt((x[k] - rx) * (x[k] - rx) + (y[k] - ry) * (y[k] - ry) + (z[k] - rz) * (z[k] - rz));
+                worst[k] = std::max(worst[k], d / r);
+                if (t == times[4]) {
+                    rebuilt.addFromState(x[k], y[k], z[k], vx[k], vy[k], vz[k], t);
+                }
+            }
+        }
+        // The rebuilt orbits must come back to the same periapsis states
+        rebuilt.propagate(0.0, x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data());
+        bool ok = true;
+        for (size_t k = 0; k < count; ++k) {
+            const double d = std::sqrt((x[k] - x0[k]) * (x[k] - x0[k]) + (y[k] - y0[k]) * (y[k] - y0[k]) +
+                                       (z[k] - z0[k]) * (z[k] - z0[k]));
+            const bool good = worst[k] < 1e-9 && d < 1e-9;
+            ok = ok && good;
+            std::cout << "e = " << eccentricities[k] << ": worst relative difference from keplerStep " << worst[k]
+                      << ", rebuilt from state " << d << (good ? "" : "  FAILED") << std::endl;
+        }
+        return ok ? 0 : -1;
+    }
+
+    // "--sgp4-check" propagates three of Vallado's SGP4-VER cases (00005 near-earth, 08195
+    // deep-space with the half-day resonance, 28626 geosynchronous) and compares them with
+    // the published tcppver.out states. Exits non-zero if any position is off by more than
+    // 10 m or velocity by more than 1 mm/s.
+    if (argc > 2 && std::strcmp(argv[2], "--sgp4-check") == 0) {
+        const char* const cases[][3] = {
+            {"00005", "1 00005U 58002B   00179.78495062  .00000023  00000-0  28098-4 0  4753",
+             "2 00005  34.2682 348.7242 1859667 331.7664  19.3264 10.82419157413667"},
+            {"08195", "1 08195U 75081A   06176.33215444  .00000099  00000-0  11873-3 0   813",
+             "2 08195  64.1586 279.0717 6877146 264.7651  20.2257  2.00491383225656"},
+            {"28626", "1 28626U 05008A   06176.46683397 -.00000205  00000-0  10000-3 0  2190",
+             "2 28626   0.0019 286.9433 0000335  13.7918  55.6504  1.00270176  4891"}};
+        // Case, minutes from epoch, TEME position (km) and velocity (km/s)
+        const double expected[][8] = {
+            {0, 0.0, 7022.46529266, -1400.08296755, 0.03995155, 1.893841015, 6.405893759, 4.534807250},
+            {0, 360.0, -7154.03120202, -3783.17682504, -3536.19412294, 4.741887409, -4.151817765, -2.093935425},
+            {0, 720.0, -7134.59340119, 6531.68641334, 3260.27186483, -4.113793027, -2.911922039, -2.557327851},
+            {0, 1080.0, 5568.53901181, 4492.06992591, 3863.87641983, -4.209106476, 5.159719888, 2.744852980},
+            {0, 1440.0, -938.55923943, -6268.18748831, -4294.02924751, 7.536105209, -0.427127707, 0.989878080},
+            {1, 0.0, 2349.89483350, -14785.93811562, 0.02119378, 2.721488096, -3.256811655, 4.498416672},
+            {1, 120.0, 15223.91713658, -17852.95020002, 25280.39550973, 1.079041732, 0.875187372, 2.485682813},
+            {2, 0.0, 42080.71852213, -2646.86387436, 0.81851294, 0.193105177, 3.068688251, 0.000438449},
+            {2, 120.0, 37740.00085593, 18802.76872687, 3.45512511, -1.371035206, 2.752105932, 0.000336883},
+            {2, 240.0, 23232.82515486, 35187.33981749, 4.98927759, -2.565776620, 1.694193132, 0.000163365}};
+        Sgp4Catalog verification;
+        double epochs[3];
+        for (int k = 0; k < 3; ++k) {
+            TleElements tle;
+            if (!parseTle(cases[k][0], cases[k][1], cases[k][2], tle) || !verification.add(tle)) {
+                std::cerr << "SGP4-VER case " << cases[k][0] << " failed to initialise" << std::endl;
+                return -1;
+            }
+            epochs[k] = tle.epochJd;
+        }
+        bool ok = true;
+        for (const auto& row : expected) {
+            const size_t k = size_t(row[0]);
+            double r[3], v[3];
+            const std::uint8_t error = verification.propagateSatellite(k, epochs[k] + row[1] / 1440.0, r, v);
+            const double dr = std::sqrt((r[0] - row[2]) * (r[0] - row[2]) + (r[1] - row[3]) * (r[1] - row[3]) +
+                                        (r[2] - row[4]) * (r[2] - row[4]));
+            const double dv = std::sqrt((v[0] - row[5]) * (v[0] - row[5]) + (v[1] - row[6]) * (v[1] - row[6]) +
+                                        (v[2] - row[7]) * (v[2] - row[7]));
+            const bool good = error == Sgp4Ok && dr < 1e-2 && dv < 1e-6;
+            ok = ok && good;
+            std::cout << verification.name(k) << " +" << row[1] << " min: position off by " << dr * 1000.0
+                      << " m, velocity by " << dv * 1e6 << " mm/s" << (good ? "" : "  FAILED") << std::endl;
+        }
+        return ok ? 0 : -1;
+    }
+
+    // "--replay-check [file]" records a synthetic run (smooth orbits, noise, constants,
+    // huge values and NaN gaps) to file, then walks every chunk with a
+    // TrajectoryChunkCursor (forwards, backwards, random jumps and short steps either
+    // way) and compares each sample bit for bit with decodeTrajectoryChunk. Exits
+    // non-zero on any mismatch.
+    if (argc > 2 && std::strcmp(argv[2], "--replay-check") == 0) {
+        const char* path = argc > 3 ? argv[3] : "replay-check.trj";
+        const size_t bodies = 2000, samples = 150;
+        TrajectoryRecorder recorder;
+        recorder.samplesPerChunk = 32;
+        recorder.blocking = true;
+        if (!recorder.open(path, bodies)) {
+            return -1;
+        }
+        std::mt19937 rng(3);
+        std::normal_distribution<double> noise(0.0, 1.0);
+        std::vector<double> walk(bodies, 0.0);
+        std::vector<double> x(bodies), y(bodies), z(bodies), vx(bodies), vy(bodies), vz(bodies);
+        for (size_t k = 0; k < samples; ++k) {
+            const double t = 60.0 * k;
+            for (size_t i = 0; i < bodies; ++i) {
+                const double r = 7000.0 + 10.0 * i, w = std::sqrt(sgp4Mu / (r * r * r)), phase = w * t + i;
+                switch (i % 5) {
+                case 0: // Circular orbit
+                    x[i] = r * std::cos(phase);
+                    y[i] = r * std::sin(phase);
+                    z[i] = 0.01 * i;
+                    vx[i] = -r * w * std::sin(phase);
+                    vy[i] = r * w * std::cos(phase);
+                    vz[i] = 0.0;
+                    break;
+                case 1: // Random walk
+                    walk[i] += noise(rng);
+                    x[i] = y[i] = z[i] = walk[i];
+                    vx[i] = vy[i] = vz[i] = noise(rng);
+                    break;
+                case 2: // Constant
+                    x[i] = y[i] = z[i] = 42.0;
+                    vx[i] = vy[i] = vz[i] = 0.0;
+                    break;
+                case 3: // Far out and fast
+                    x[i] = 1.0e9 * std::cos(1e-3 * t * i);
+                    y[i] = z[i] = -1.0e9;
+                    vx[i] = vy[i] = vz[i] = 1.0e6 * std::sin(1e-3 * t * i);
+                    break;
+                default: // A straight line with NaN gaps
+                    x[i] = y[i] = z[i] = 3.0 * k;
+                    vx[i] = vy[i] = vz[i] = 0.05;
+                    if ((k / 5 + i) % 7 == 0) {
+                        x[i] = vy[i] = NAN;
+                    }
+                    break;
+                }
+            }
+            recorder.record(t, x.data(), y.data(), z.data(), vx.data(), vy.data(), vz.data());
+        }
+        recorder.close();
+        TrajectoryReader reader;
+        if (recorder.failed() || !reader.open(path)) {
+            return -1;
+        }
+        long long seeks = 0, mismatches = 0;
+        for (size_t chunk = 0; chunk < reader.chunkCount(); ++chunk) {
+            TrajectoryChunkHeader chunkHeader;
+            size_t payloadBytes = 0;
+            const unsigned char* payload = reader.chunkPayload(chunk, chunkHeader, payloadBytes);
+            const size_t count = chunkHeader.sampleCount;
+            TrajectoryChunk full;
+            TrajectoryChunkCursor cursor;
+            if (!decodeTrajectoryChunk(payload, payloadBytes, count, bodies, reader.positionQuantum(),
+                                       reader.velocityQuantum(), full) ||
+                !cursor.open(payload, payloadBytes, count, bodies, reader.positionQuantum(), reader.velocityQuantum())) {
+                std::cerr << "Chunk " << chunk << " failed to decode" << std::endl;
+                return -1;
+            }
+            std::vector<size_t> order;
+            for (size_t k = 0; k < count; ++k) {
+                order.push_back(k);
+            }
+            for (size_t k = count; k-- > 0;) {
+                order.push_back(k);
+            }
+            size_t k = 0;
+            for (int jump = 0; jump < 100; ++jump) {
+                // Alternate random jumps with a few short steps forwards or backwards
+                if (jump % 2 == 0) {
+                    k = rng() % count;
+                } else {
+                    k = size_t(std::min(std::max(long(k) + long(rng() % 7) - 3, 0L), long(count) - 1));
+                }
+                order.push_back(k);
+            }
+            for (size_t sample : order) {
+                ++seeks;
+                if (!cursor.seek(sample)) {
+                    std::cerr << "Chunk " << chunk << " seek to " << sample << " failed" << std::endl;
+                    return -1;
+                }
+                const size_t next = std::min(sample + 1, count - 1);
+                for (int c = 0; c < trajectoryComponents; ++c) {
+                    mismatches += std::memcmp(cursor.component(0, c), full.component(sample, c), bodies * sizeof(double)) != 0;
+                    mismatches += std::memcmp(cursor.component(1, c), full.component(next, c), bodies * sizeof(double)) != 0;
+                }
+            }
+        }
+        std::remove(path);
+        std::cout << reader.chunkCount() << " chunks, " << seeks << " seeks, " << mismatches
+                  << " components differing from decodeTrajectoryChunk" << std::endl;
+        return mismatches == 0 ? 0 : -1;
+    }
+
+    // "--replay file" plays back a --record file instead of propagating the catalog
+    TrajectoryReader replay;
+    const bool replaying = argc > 3 && std::strcmp(argv[2], "--replay") == 0;
+    if (replaying && !replay.open(argv[3])) {
+        return -1;
+    }
+
+    // "--ephemeris file" anywhere on the command line adds the Sun, Moon and planets from a JPL DE file
+    ChebyshevEphemeris ephemeris;
+    for (int i = 2; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--ephemeris") == 0 && !ephemeris.open(argv[i + 1])) {
+            return -1;
+        }
+    }
+
+    // "--debris count" fills low Earth orbit and the geostationary belt with particles;
+    // "--gpu-bodies count" adds a swarm of moonlets integrated, culled and drawn on the GPU
+    size_t debrisCount = 0, gpuBodyCount = 0;
+    for (int i = 2; i + 1 < argc; ++i) {
+        if (std::strcmp(argv[i], "--debris") == 0) {
+            debrisCount = std::strtoul(argv[i + 1], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--gpu-bodies") == 0) {
+            gpuBodyCount = std::strtoul(argv[i + 1], nullptr, 10);
+        }
+    }
+
+    // Decode the texture on the scheduler while the window comes up
+    DecodedImage earthImage;
+    TaskHandle textureTask = decodeTexture("earth_texture.jpg", earthImage); // Ensure you have the Earth texture image in the same directory
+    // Early exits must not leave tasks writing into this frame's locals
+    TaskHandle assetsTask = textureTask;
+
     // Initialize GLFW
     if (!glfwInit()) {
+        TaskScheduler::instance().wait(assetsTask);
         return -1;
     }
 
@@ -145,6 +1225,7 @@ int main() {
     GLFWwindow* window = glfwCreateWindow(800, 600, "OpenGL Textured Sphere with Stars", NULL, NULL);
     if (!window) {
         glfwTerminate();
+        TaskScheduler::instance().wait(assetsTask);
         return -1;
     }
 
@@ -154,110 +1235,506 @@ int main() {
     // Initialize GLEW
     glewExperimental = GL_TRUE;
     if (glewInit() != GLEW_OK) {
+        TaskScheduler::instance().wait(assetsTask);
         return -1;
     }
 
     // Set viewport
     glViewport(0, 0, 800, 600);
     glEnable(GL_DEPTH_TEST); // Enable depth testing
+    // One depth pass from the 1 cm near plane out past the solar system
+    DepthBuffer depth;
+    depth.init(800, 600, 1.0e12);
 
-    // Generate sphere vertices and indices
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-    generateSphere(1.0f, 64, 32, vertices, indices);
-
-    // Create Vertex Array Object and Vertex Buffer Objects
-    GLuint VAO, VBO, EBO;
+    // The sphere shader reads no attributes, but core profiles still need a vertex array
+    GLuint VAO;
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    // Compile and link shaders
+    GLuint shaderProgram = createProgram(vertexShaderSource, fragmentShaderSource, depth.shaderDefines());
+    GLuint pointProgram = createProgram(pointVertexShaderSource, pointFragmentShaderSource, depth.shaderDefines());
+    GLuint trailProgram = createProgram(trailVertexShaderSource, trailFragmentShaderSource, depth.shaderDefines());
+    GLuint orbitProgram = createProgram(orbitVertexShaderSource, orbitFragmentShaderSource, depth.shaderDefines());
+    GLuint impostorProgram = createProgram(impostorVertexShaderSource, impostorFragmentShaderSource, depth.shaderDefines());
+    GLuint particleProgram = createProgram(particleVertexShaderSource, particleFragmentShaderSource, depth.shaderDefines());
+    GLuint instancedSphereProgram =
+        createProgram(instancedSphereVertexShaderSource, instancedSphereFragmentShaderSource, depth.shaderDefines());
+    if (depth.mode() == DepthMode::LogarithmicDepth) {
+        glUseProgram(shaderProgram);
+        glUniform1f(glGetUniformLocation(shaderProgram, "logDepthCoef"), depth.logDepthCoefficient());
+        glUseProgram(pointProgram);
+        glUniform1f(glGetUniformLocation(pointProgram, "logDepthCoef"), depth.logDepthCoefficient());
+        glUseProgram(trailProgram);
+        glUniform1f(glGetUniformLocation(trailProgram, "logDepthCoef"), depth.logDepthCoefficient());
+        glUseProgram(orbitProgram);
+        glUniform1f(glGetUniformLocation(orbitProgram, "logDepthCoef"), depth.logDepthCoefficient());
+        glUseProgram(impostorProgram);
+        glUniform1f(glGetUniformLocation(impostorProgram, "logDepthCoef"), depth.logDepthCoefficient());
+        glUseProgram(particleProgram);
+        glUniform1f(glGetUniformLocation(particleProgram, "logDepthCoef"), depth.logDepthCoefficient());
+        glUseProgram(instancedSphereProgram);
+        glUniform1f(glGetUniformLocation(instancedSphereProgram, "logDepthCoef"), depth.logDepthCoefficient());
+        glUseProgram(0);
+    }
+    glUniformBlockBinding(impostorProgram, glGetUniformBlockIndex(impostorProgram, "View"), viewBlockBinding);
+    glUniformBlockBinding(instancedSphereProgram, glGetUniformBlockIndex(instancedSphereProgram, "View"), viewBlockBinding);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    const size_t satelliteCount = replaying ? replay.bodyCount() : catalog.size();
+    std::vector<double> satX(satelliteCount), satY(satelliteCount), satZ(satelliteCount);
+    std::vector<double> satVx(satelliteCount), satVy(satelliteCount), satVz(satelliteCount);
+    std::vector<std::uint8_t> satErrors(satelliteCount);
 
-    // Define the vertex data layout
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0); // Position
+    // Each frame's satellite and ephemeris points, impostor instances and View block are
+    // written into a slice of the stream; 64 KiB covers all but the satellites
+    StreamBuffer stream;
+    stream.init(satelliteCount * 3 * sizeof(float) + 65536);
+    // Points are read from the start of the stream, so a slice at offset o begins at
+    // vertex o / 12
+    GLuint satVAO;
+    glGenVertexArrays(1, &satVAO);
+    glBindVertexArray(satVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float))); // Texture coordinates
-    glEnableVertexAttribArray(1);
-
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    // Compile shaders
-    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
-    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+    // Each satellite trails its last 1000 positions, sampled every 6 simulated seconds
+    // (at most once per frame), which covers a low Earth orbit
+    const double trailSampleSeconds = 6.0;
+    OrbitTrails trails;
+    std::vector<float> trailSample(satelliteCount * 3);
+    if (satelliteCount > 0) {
+        trails.init(satelliteCount, 1000);
+    }
+    // O toggles each satellite's osculating orbit, refreshed from its state every frame;
+    // replays store no velocities, so they have none
+    OrbitCurves orbits;
+    std::vector<float> orbitElements(satelliteCount * orbitElementCount);
+    bool showOrbits = false, orbitKeyWasDown = false;
+    if (satelliteCount > 0 && !replaying) {
+        orbits.init(satelliteCount);
+    }
+
+    // The Earth when small on screen and the ephemeris bodies, refilled every frame
+    SphereImpostors impostors;
+    std::vector<SphereImpostor> impostorList;
+    impostors.init(1 + sizeof(ephemerisMarkers) / sizeof(ephemerisMarkers[0]));
 
-    // Create shader program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+    // Debris about the Earth and, with an ephemeris, Saturn's rings. Both orbit on the GPU;
+    // F moves the camera between the Earth and Saturn
+    OrbitalParticles debris, saturnRings;
+    std::vector<ParticleOrbit> particleOrbits;
+    if (debrisCount > 0) {
+        // Nine tenths between 400 and 2000 km up, the rest around geostationary altitude
+        generateDebrisParticles(particleOrbits, debrisCount - debrisCount / 10, 6778.0f, 8378.0f, 0.05f, 3.14159265f, 1);
+        generateDebrisParticles(particleOrbits, debrisCount / 10, 42064.0f, 42264.0f, 0.002f, 0.26f, 2);
+        debris.mu = sgp4Mu;
+        debris.j2 = 1.08262998e-3;
+        debris.referenceRadius = sgp4EarthRadiusKm;
+        debris.init(particleOrbits.data(), particleOrbits.size());
+    }
+    if (ephemeris.isOpen()) {
+        // C ring, B ring, Cassini division and A ring
+        const float saturnBands[][3] = {
+            {74658.0f, 92000.0f, 0.15f}, {92000.0f, 117580.0f, 1.0f}, {117580.0f, 122170.0f, 0.05f}, {122170.0f, 136775.0f, 0.6f}};
+        particleOrbits.clear();
+        generateRingParticles(particleOrbits, 1 << 20, saturnBands, 4, 3);
+        saturnRings.mu = 37931207.7;
+        saturnRings.j2 = 16290.71e-6;
+        saturnRings.referenceRadius = 60330.0;
+        saturnRings.init(particleOrbits.data(), particleOrbits.size());
+    }
+    particleOrbits = std::vector<ParticleOrbit>();
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    bool followSaturn = false, followKeyWasDown = false;
 
-    // Cleanup shaders as they are now linked
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // The moonlet swarm: the Earth plus moonlets on near-circular orbits 15000 to 45000 km
+    // out, tilted up to 10 degrees, with masses over a factor 500 that set their radii.
+    // Units are km, s and G = 1, so the Earth's mass is its mu. Positions never leave the
+    // GPU: GpuGravity steps them and IndirectSpheres culls and draws them from its buffer,
+    // so the CPU's frame cost does not depend on the count (GL 4.3). The same buffer is
+    // also a vertex array's positions, drawn as points so moonlets too small on screen for
+    // a sphere still show.
+    GpuGravity swarm;
+    IndirectSpheres swarmSpheres;
+    GLuint swarmVAO = 0;
+    bool swarmActive = false;
+    if (gpuBodyCount > 0 && swarm.init() && swarmSpheres.init(gpuBodyCount)) {
+        BodySystem moonlets;
+        moonlets.addBody(sgp4Mu, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+        std::mt19937 rng(5);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        for (size_t i = 0; i < gpuBodyCount; ++i) {
+            const double r = 15000.0 + 30000.0 * unit(rng);
+            const double node = 2.0 * M_PI * unit(rng), inclination = glm::radians(10.0) * unit(rng);
+            const double u = 2.0 * M_PI * unit(rng), speed = std::sqrt(sgp4Mu / r);
+            // Equatorial (z to the pole) position and velocity, then to scene axes
+            const double ex = std::cos(node) * std::cos(u) - std::sin(node) * std::sin(u) * std::cos(inclination);
+            const double ey = std::sin(node) * std::cos(u) + std::cos(node) * std::sin(u) * std::cos(inclination);
+            const double ez = std::sin(u) * std::sin(inclination);
+            const double vx = -std::cos(node) * std::sin(u) - std::sin(node) * std::cos(u) * std::cos(inclination);
+            const double vy = -std::sin(node) * std::sin(u) + std::cos(node) * std::cos(u) * std::cos(inclination);
+            const double vz = std::cos(u) * std::sin(inclination);
+            moonlets.addBody(1.0e-6 * std::pow(500.0, unit(rng)), -r * ex, r * ez, r * ey, -speed * vx, speed * vz, speed * vy);
+        }
+        swarm.softening = 1.0;
+        swarm.upload(moonlets);
+        swarmSpheres.radiusScale = 1.0e4f;
+        swarmSpheres.radiusPower = 1.0f / 3.0f;
+        swarmSpheres.setOccluder(glm::dvec3(0.0), sgp4EarthRadiusKm);
+        glGenVertexArrays(1, &swarmVAO);
+        swarm.bindPositionAttribute(swarmVAO, 0);
+        swarmActive = true;
+    }
 
-    // Load texture
-    GLuint earthTexture = loadTexture("earth_texture.jpg"); // Ensure you have the Earth texture image in the same directory
+    // TEME and ICRF axes to the scene's (y up)
+    const glm::dmat4 temeToScene(-1.0, 0.0, 0.0, 0.0,
+                                 0.0, 0.0, 1.0, 0.0,
+                                 0.0, 1.0, 0.0, 0.0,
+                                 0.0, 0.0, 0.0, 1.0);
+    // Saturn's equator in ICRF: the IAU pole at right ascension 40.589, declination 83.537
+    // degrees, with x along the equator's ascending node
+    const double poleRa = glm::radians(40.589), poleDec = glm::radians(83.537);
+    const glm::dvec3 saturnX(-std::sin(poleRa), std::cos(poleRa), 0.0);
+    const glm::dvec3 saturnZ(std::cos(poleDec) * std::cos(poleRa), std::cos(poleDec) * std::sin(poleRa), std::sin(poleDec));
+    const glm::dvec3 saturnY = glm::cross(saturnZ, saturnX);
+    const glm::dmat4 saturnEquatorToScene = temeToScene * glm::dmat4(saturnX.x, saturnX.y, saturnX.z, 0.0,
+                                                                     saturnY.x, saturnY.y, saturnY.z, 0.0,
+                                                                     saturnZ.x, saturnZ.y, saturnZ.z, 0.0,
+                                                                     0.0, 0.0, 0.0, 1.0);
+
+    SimClock simClock;
+    simClock.jd = replaying ? replay.epoch() + replay.startTime() / 86400.0 : catalog.latestEpoch();
+    double lastFrameTime = glfwGetTime();
+    double lastTrailJd = simClock.jd - 1.0;
+    double lastParticleJd = simClock.jd;
+    // Keep geostationary orbits (6.6 earth radii) in view when satellites are shown
+    Camera camera;
+    camera.pitch = 0.0;
+    camera.distance = (satelliteCount > 0 ? 18.0 : 5.0) * sgp4EarthRadiusKm;
+    glfwSetWindowUserPointer(window, &camera);
+    glfwSetScrollCallback(window, scrollCallback);
+
+    // Upload the texture once decoding has finished
+    TaskScheduler::instance().wait(textureTask);
+    GLuint earthTexture = loadTexture(earthImage);
 
         // Generate stars with their original positions
     std::vector<glm::vec3> stars;
     generateStars(300, stars); // Generate 300 stars within a range of 10.0 units
 
+    // The Earth, stars and satellites are culled each frame against the view frustum and
+    // the bodies that can hide them; the counts go in the window title twice a second
+    SphereCuller culler;
+    BoundingSpheres cullSpheres;
+    std::vector<std::uint32_t> visibleIndices, visibleStars;
+    std::vector<glm::dvec3> starPositions;
+    double lastTitleTime = 0.0;
+
+    // Every draw of a frame is queued and issued at its end, sorted by state; the state
+    // calls made and skipped go in the title with the culling counts
+    RenderQueue renderQueue;
+
     // Main loop
     while (!glfwWindowShouldClose(window)) {
+        double now = glfwGetTime();
+        simClock.update(window, now - lastFrameTime);
+        if (replaying) {
+            simClock.jd = std::min(std::max(simClock.jd, replay.epoch() + replay.startTime() / 86400.0),
+                                   replay.epoch() + replay.endTime() / 86400.0);
+        }
+        // Saturn's centre in the scene, for its rings and the camera when following it
+        glm::dvec3 saturnPosition(0.0);
+        double saturnState[3];
+        if (saturnRings.size() > 0 &&
+            ephemeris.state(EphemerisBody::Saturn, EphemerisBody::Earth, simClock.jd + 69.184 / 86400.0, saturnState, nullptr)) {
+            saturnPosition = glm::dvec3(-saturnState[0], saturnState[2], saturnState[1]);
+        }
+        bool followKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+        if (followKey && !followKeyWasDown && saturnRings.size() > 0) {
+            followSaturn = !followSaturn;
+            camera.distance = followSaturn ? 500000.0 : 18.0 * sgp4EarthRadiusKm;
+        }
+        followKeyWasDown = followKey;
+        camera.target = followSaturn ? saturnPosition : glm::dvec3(0.0);
+        updateCamera(window, camera, now - lastFrameTime);
+        lastFrameTime = now;
+
+        // Particles move on by the simulated time since the last frame, backwards when scrubbing back
+        const double particleDt = (simClock.jd - lastParticleJd) * 86400.0;
+        lastParticleJd = simClock.jd;
+        debris.update(particleDt);
+        saturnRings.update(particleDt);
+        // Leapfrog steps of at most 20 s; capped so time warp cannot stall the frame, at
+        // the cost of the swarm falling behind the clock
+        const int swarmSteps = swarmActive ? std::min(64, (int)std::ceil(std::fabs(particleDt) / 20.0)) : 0;
+        if (swarmSteps > 0) {
+            swarm.step(particleDt / swarmSteps, swarmSteps);
+            swarm.memoryBarrier();
+        }
+
         // Clear the screen
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        depth.beginFrame();
 
-        // Use shader program
-        glUseProgram(shaderProgram);
+        // Create transformation matrices. World units are km; model-view matrices are
+        // composed in double relative to the camera, so only the projection is float.
+        // The projection has no far plane and a 1 cm near plane (1e-5 km).
+        glm::mat4 projection = depth.projection(glm::radians(45.0f), (float)800 / (float)600, 1.0e-5f);
+        stream.beginFrame();
+        GLintptr viewOffset;
+        if (float* view = static_cast<float*>(stream.allocateUniforms(32 * sizeof(float), viewOffset))) {
+            std::memcpy(view, glm::value_ptr(projection), 16 * sizeof(float));
+            std::memcpy(view + 16, glm::value_ptr(glm::mat4(camera.viewRotation())), 16 * sizeof(float));
+            glBindBufferRange(GL_UNIFORM_BUFFER, viewBlockBinding, stream.buffer(), viewOffset, 32 * sizeof(float));
+        }
+        culler.beginFrame();
+        culler.setFrustum(projection * glm::mat4(camera.viewRotation()), depth.mode() == DepthMode::ReverseZ);
+        // The Earth hides whatever is behind it; the ephemeris bodies join it once placed
+        const glm::dvec3 earthOffset = -camera.position();
+        culler.clearOccluders();
+        culler.addOccluder((float)earthOffset.x, (float)earthOffset.y, (float)earthOffset.z, (float)sgp4EarthRadiusKm);
+        // With a catalog or an ephemeris the Earth turns with sidereal time so the ground track and Sun line up
+        double earthAngle = satelliteCount > 0 || ephemeris.isOpen() ? greenwichSiderealTime(simClock.jd) : glfwGetTime();
+        glm::dmat4 earthLocal = glm::scale(glm::rotate(glm::dmat4(1.0), earthAngle, glm::dvec3(0.0, 1.0, 0.0)),
+                                           glm::dvec3(sgp4EarthRadiusKm));
+        glm::mat4 mvp = projection * cameraRelativeModelView(camera, glm::dvec3(0.0), earthLocal);
 
-        // Create transformation matrices
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)800 / (float)600, 0.1f, 100.0f);
-        glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f));
-        glm::mat4 model = glm::rotate(glm::mat4(1.0f), (float)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 mvp = projection * view * model;
+        // Draw the sphere, tessellated for its size on screen (300 px is the 45 degree half-height).
+        // Below impostorPixels it joins the impostors instead, which are exact at any size.
+        const double impostorPixels = 200.0;
+        const double earthDistance = glm::length(camera.position());
+        const double earthPixels = 300.0 / std::tan(glm::radians(22.5)) * sgp4EarthRadiusKm /
+                                   std::sqrt(std::max(earthDistance * earthDistance - sgp4EarthRadiusKm * sgp4EarthRadiusKm, 1.0));
+        int sphereSegments, sphereRings;
+        sphereTessellation(earthPixels, sphereSegments, sphereRings);
+        // The Earth's program with the texture on unit 0 and the grid set, shared with the stars
+        auto setSphereUniforms = [&]() {
+            glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), 0);
+            glUniform1i(glGetUniformLocation(shaderProgram, "segments"), sphereSegments);
+            glUniform1i(glGetUniformLocation(shaderProgram, "rings"), sphereRings);
+        };
+        impostorList.clear();
+        const bool earthVisible =
+            culler.visible((float)earthOffset.x, (float)earthOffset.y, (float)earthOffset.z, (float)sgp4EarthRadiusKm);
+        if (earthVisible && earthPixels < impostorPixels) {
+            impostorList.push_back({{(float)earthOffset.x, (float)earthOffset.y, (float)earthOffset.z}, (float)sgp4EarthRadiusKm,
+                                    {1.0f, 1.0f, 1.0f}, 1.0f, (float)std::fmod(earthAngle, 2.0 * M_PI)});
+        } else if (earthVisible) {
+            renderQueue.submit(RenderLayer::Opaque, shaderProgram, earthTexture, VAO, (float)earthDistance, [&]() {
+                setSphereUniforms();
+                glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(mvp));
+                glDrawArrays(GL_TRIANGLES, 0, 6 * sphereSegments * sphereRings);
+            });
+        }
+        
+        // Stars are culled as spheres of their drawn size, off screen or behind the Earth;
+        // only the visible ones are drawn
+        const double starDistance = 3.0 * sgp4EarthRadiusKm; // Adjust star distance if necessary
+        const double starRadius = 0.05 * sgp4EarthRadiusKm;
+        const glm::dvec3 eye = camera.position();
+        starPositions.resize(stars.size());
+        cullSpheres.clear();
+        for (size_t i = 0; i < stars.size(); ++i) {
+            // Calculate angle for revolution
+            double angle = glfwGetTime() + (i * (2.0 * M_PI / stars.size())); // Offset each star's angle
 
-        // Set the MVP uniform
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(mvp));
+            // Position stars in a circular path around the sphere, keeping each star's original y
+            starPositions[i] = glm::dvec3(starDistance * cos(angle), stars[i].y * sgp4EarthRadiusKm, starDistance * sin(angle));
+            const glm::dvec3 offset = starPositions[i] - eye;
+            cullSpheres.add((float)offset.x, (float)offset.y, (float)offset.z, (float)starRadius);
+        }
+        culler.cull(cullSpheres, visibleStars);
+        if (!visibleStars.empty()) {
+            renderQueue.submit(RenderLayer::Opaque, shaderProgram, earthTexture, VAO, (float)starDistance, [&]() {
+                setSphereUniforms();
+                for (std::uint32_t i : visibleStars) {
+                    // Create the star model matrix
+                    glm::dmat4 starLocal = glm::scale(glm::dmat4(1.0), glm::dvec3(starRadius)); // Scale stars down
+                    glm::mat4 starMVP = projection * cameraRelativeModelView(camera, starPositions[i], starLocal);
 
-        // Bind texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, earthTexture);
-        glUniform1i(glGetUniformLocation(shaderProgram, "texture1"), 0); // Use texture unit 0
+                    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(starMVP));
 
-        // Draw the sphere
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        
-       float starDistance = 3.0f; // Adjust star distance if necessary
-       for (size_t i = 0; i < stars.size(); ++i) {
-	   // Calculate angle for revolution
-	   float angle = glfwGetTime() + (i * (2.0f * M_PI / stars.size())); // Offset each star's angle
-	   
-	   // Position stars in a circular path around the sphere
-	   float x = starDistance * cos(angle); // Circular motion on x-axis
-	   float z = starDistance * sin(angle); // Circular motion on z-axis
-	   glm::vec3 starPosition(x, stars[i].y, z); // Keep the original y position of the star
-
-	   // Create the star model matrix
-	   glm::mat4 starModel = glm::translate(glm::mat4(1.0f), starPosition);
-	   starModel = glm::scale(starModel, glm::vec3(0.05f)); // Scale stars down
-	   glm::mat4 starMVP = projection * view * starModel;
-
-	   glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(starMVP));
-
-	   // Draw a point for the star
-	   glDrawArrays(GL_POINTS, 0, 1); // Drawing a single point
-       }
+                    // Draw a point for the star
+                    glDrawArrays(GL_POINTS, 0, 1); // Drawing a single point
+                }
+            });
+        }
+
+        // The swarm, skipping the Earth at index 0
+        if (swarmActive) {
+            const glm::mat4 swarmViewProjection = projection * glm::mat4(camera.viewRotation());
+            swarmSpheres.cull(swarm.positionBuffer(), 1, gpuBodyCount, swarmViewProjection,
+                              depth.mode() == DepthMode::ReverseZ, camera.position(), (float)(300.0 / std::tan(glm::radians(22.5))));
+            renderQueue.submit(RenderLayer::Opaque, instancedSphereProgram, 0, 0, 0.0f, [&]() {
+                glUniform3f(glGetUniformLocation(instancedSphereProgram, "sphereColor"), 0.75f, 0.7f, 0.65f);
+                swarmSpheres.draw(instancedSphereProgram);
+            });
+            // Points at the centres, hidden inside any sphere big enough to draw
+            const glm::mat4 swarmMVP =
+                projection * glm::mat4(camera.viewRotation() * glm::translate(glm::dmat4(1.0), -camera.position()));
+            renderQueue.submit(RenderLayer::Opaque, pointProgram, 0, swarmVAO, 0.0f, [&, swarmMVP]() {
+                glUniformMatrix4fv(glGetUniformLocation(pointProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(swarmMVP));
+                glUniform3f(glGetUniformLocation(pointProgram, "pointColor"), 0.75f, 0.7f, 0.65f);
+                glPointSize(1.0f);
+                glDrawArrays(GL_POINTS, 1, GLsizei(gpuBodyCount));
+            });
+        }
+
+        if (ephemeris.isOpen()) {
+            const size_t firstBody = impostorList.size();
+            submitEphemerisBodies(ephemeris, simClock.jd, camera, projection, pointProgram, satVAO, stream, renderQueue,
+                                  impostorList);
+            for (size_t i = firstBody; i < impostorList.size(); ++i) {
+                const SphereImpostor& body = impostorList[i];
+                culler.addOccluder(body.center[0], body.center[1], body.center[2], body.radius);
+            }
+        }
+
+        // Every impostor sphere in one draw, textured with the Earth on unit 0
+        impostors.update(stream, impostorList.data(), impostorList.size());
+        renderQueue.submit(RenderLayer::Opaque, impostorProgram, earthTexture, 0, 0.0f, [&]() {
+            glUniform1i(glGetUniformLocation(impostorProgram, "texture1"), 0);
+            impostors.draw(impostorProgram);
+        });
+
+        // Particles add light without writing depth, so behind a sphere they are hidden
+        // and in front of it they brighten it
+        if (debris.size() > 0) {
+            const glm::mat4 debrisMVP = projection * cameraRelativeModelView(camera, glm::dvec3(0.0), temeToScene);
+            renderQueue.submit(RenderLayer::Additive, particleProgram, 0, 0, 0.0f, [&, debrisMVP]() {
+                glUniform1f(glGetUniformLocation(particleProgram, "pointSize"), 2.0f);
+                glUniformMatrix4fv(glGetUniformLocation(particleProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(debrisMVP));
+                glUniform3f(glGetUniformLocation(particleProgram, "particleColor"), 0.5f, 0.3f, 0.25f);
+                debris.draw(particleProgram);
+            });
+        }
+        if (saturnRings.size() > 0) {
+            const glm::mat4 ringMVP = projection * cameraRelativeModelView(camera, saturnPosition, saturnEquatorToScene);
+            renderQueue.submit(RenderLayer::Additive, particleProgram, 0, 0, 0.0f, [&, ringMVP]() {
+                glUniform1f(glGetUniformLocation(particleProgram, "pointSize"), 2.0f);
+                glUniformMatrix4fv(glGetUniformLocation(particleProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(ringMVP));
+                glUniform3f(glGetUniformLocation(particleProgram, "particleColor"), 0.25f, 0.22f, 0.17f);
+                saturnRings.draw(particleProgram);
+            });
+        }
+
+        if (satelliteCount > 0) {
+            if (replaying) {
+                // Satellites that failed while recording come back as NaN
+                replay.positionsAt((simClock.jd - replay.epoch()) * 86400.0, satX.data(), satY.data(), satZ.data());
+                for (size_t i = 0; i < satelliteCount; ++i) {
+                    satErrors[i] = std::isnan(satX[i]) ? Sgp4Decayed : Sgp4Ok;
+                }
+            } else {
+                catalog.propagateParallel(simClock.jd, satX.data(), satY.data(), satZ.data(), satVx.data(),
+                                          satVy.data(), satVz.data(), satErrors.data());
+            }
+            // TEME (z to the pole) to scene (y up), made camera-relative in double before
+            // rounding to float. Failed satellites are NaN, which the culler drops along
+            // with everything off screen or behind the Earth, Moon and planets.
+            cullSpheres.clear();
+            for (size_t i = 0; i < satelliteCount; ++i) {
+                const bool ok = satErrors[i] == Sgp4Ok;
+                cullSpheres.add(ok ? (float)(-satX[i] - eye.x) : NAN, (float)(satZ[i] - eye.y), (float)(satY[i] - eye.z), 0.0f);
+            }
+            culler.cull(cullSpheres, visibleIndices);
+            // The visible points go straight into the stream
+            const size_t satBytes = visibleIndices.size() * 3 * sizeof(float);
+            GLintptr satOffset;
+            float* satPoints = static_cast<float*>(stream.allocate(satBytes, 3 * sizeof(float), satOffset));
+            if (satPoints && satBytes > 0) {
+                for (size_t k = 0; k < visibleIndices.size(); ++k) {
+                    const std::uint32_t i = visibleIndices[k];
+                    satPoints[3 * k] = cullSpheres.x[i];
+                    satPoints[3 * k + 1] = cullSpheres.y[i];
+                    satPoints[3 * k + 2] = cullSpheres.z[i];
+                }
+                const GLint first = GLint(satOffset / GLintptr(3 * sizeof(float)));
+                const GLsizei count = GLsizei(visibleIndices.size());
+                renderQueue.submit(RenderLayer::Opaque, pointProgram, 0, satVAO, 0.0f, [&, first, count]() {
+                    glm::mat4 satMVP = projection * glm::mat4(camera.viewRotation());
+                    glUniformMatrix4fv(glGetUniformLocation(pointProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(satMVP));
+                    glUniform3f(glGetUniformLocation(pointProgram, "pointColor"), 1.0f, 0.85f, 0.3f);
+                    glPointSize(2.0f);
+                    glDrawArrays(GL_POINTS, first, count);
+                });
+            }
+
+            // Trails are positions about the Earth's centre, so their model-view is the
+            // Earth's without rotation or scale; failed satellites break their trail
+            if (simClock.jd < lastTrailJd) {
+                trails.clear();
+                lastTrailJd = simClock.jd - 1.0;
+            }
+            if ((simClock.jd - lastTrailJd) * 86400.0 >= trailSampleSeconds) {
+                for (size_t i = 0; i < satelliteCount; ++i) {
+                    const bool ok = satErrors[i] == Sgp4Ok;
+                    trailSample[3 * i] = ok ? (float)-satX[i] : NAN;
+                    trailSample[3 * i + 1] = ok ? (float)satZ[i] : NAN;
+                    trailSample[3 * i + 2] = ok ? (float)satY[i] : NAN;
+                }
+                trails.append(trailSample.data());
+                lastTrailJd = simClock.jd;
+            }
+            const glm::mat4 trailMVP = projection * cameraRelativeModelView(camera, glm::dvec3(0.0), glm::dmat4(1.0));
+            renderQueue.submit(RenderLayer::Translucent, trailProgram, 0, 0, 0.0f, [&, trailMVP]() {
+                glUniformMatrix4fv(glGetUniformLocation(trailProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(trailMVP));
+                glUniform3f(glGetUniformLocation(trailProgram, "trailColor"), 1.0f, 0.85f, 0.3f);
+                trails.draw(trailProgram);
+            });
+
+            bool orbitKey = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+            if (orbitKey && !orbitKeyWasDown) {
+                showOrbits = !showOrbits;
+            }
+            orbitKeyWasDown = orbitKey;
+            if (showOrbits && orbits.capacity() > 0) {
+                TaskScheduler::instance().parallelFor(0, satelliteCount, 1024, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        float* out = &orbitElements[i * orbitElementCount];
+                        if (satErrors[i] != Sgp4Ok) {
+                            std::fill(out, out + orbitElementCount, 0.0f);
+                            continue;
+                        }
+                        double elements[orbitElementCount];
+                        stateToElements(sgp4Mu, satX[i], satY[i], satZ[i], satVx[i], satVy[i], satVz[i], elements);
+                        std::copy(elements, elements + orbitElementCount, out);
+                    }
+                });
+                orbits.update(orbitElements.data(), satelliteCount);
+                // Elements are in TEME; the model maps TEME axes to the scene's
+                const glm::mat4 orbitMVP = projection * cameraRelativeModelView(camera, glm::dvec3(0.0), temeToScene);
+                renderQueue.submit(RenderLayer::Translucent, orbitProgram, 0, 0, 0.0f, [&, orbitMVP]() {
+                    glUniformMatrix4fv(glGetUniformLocation(orbitProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(orbitMVP));
+                    glUniform3f(glGetUniformLocation(orbitProgram, "orbitColor"), 0.4f, 0.7f, 1.0f);
+                    orbits.draw(orbitProgram);
+                });
+            }
+        }
+
+        stream.commit();
+        renderQueue.flush();
+
+        if (now - lastTitleTime >= 0.5) {
+            std::string title = "OpenGL Textured Sphere with Stars - " + std::to_string(culler.stats.visible) + " visible, " +
+                                std::to_string(culler.stats.culled) + " culled, " + std::to_string(culler.stats.occluded) +
+                                " occluded - " + std::to_string(renderQueue.stats.draws) + " draws, " +
+                                std::to_string(renderQueue.stats.stateCalls) + " binds, " +
+                                std::to_string(renderQueue.stats.redundantCalls) + " skipped";
+            if (swarmActive) {
+                // Reading the counts back waits for the GPU, so only here
+                GLuint lods[IndirectSpheres::lodCount];
+                swarmSpheres.lodCounts(lods);
+                title += " - swarm " + std::to_string(lods[0]) + "/" + std::to_string(lods[1]) + "/" +
+                         std::to_string(lods[2]) + "/" + std::to_string(lods[3]) + " by detail";
+            }
+            glfwSetWindowTitle(window, title.c_str());
+            lastTitleTime = now;
+        }
 
         // Swap buffers and poll events
+        depth.endFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -265,9 +1742,24 @@ int main() {
 
     // Cleanup
     glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &satVAO);
     glDeleteProgram(shaderProgram);
+    glDeleteProgram(pointProgram);
+    glDeleteProgram(trailProgram);
+    glDeleteProgram(orbitProgram);
+    glDeleteProgram(impostorProgram);
+    glDeleteProgram(particleProgram);
+    glDeleteProgram(instancedSphereProgram);
+    trails.destroy();
+    orbits.destroy();
+    impostors.destroy();
+    debris.destroy();
+    saturnRings.destroy();
+    glDeleteVertexArrays(1, &swarmVAO);
+    swarmSpheres.destroy();
+    swarm.destroy();
+    stream.destroy();
+    depth.destroy();
     glfwTerminate();
 
     return 0;
@@ -0,0 +1,276 @@
+#include "nbody.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <cmath>
+
+// Below this many pair interactions a scheduler round trip costs more than it saves
+static const size_t parallelInteractionThreshold = 16384;
+
+void BodySystem::reserve(size_t n) {
+    x.reserve(n); y.reserve(n); z.reserve(n);
+    vx.reserve(n); vy.reserve(n); vz.reserve(n);
+    ax.reserve(n); ay.reserve(n); az.reserve(n);
+    mass.reserve(n);
+}
+
+size_t BodySystem::addBody(double m, double px, double py, double pz, double pvx, double pvy, double pvz) {
+    x.push_back(px); y.push_back(py); z.push_back(pz);
+    vx.push_back(pvx); vy.push_back(pvy); vz.push_back(pvz);
+    ax.push_back(0.0); ay.push_back(0.0); az.push_back(0.0);
+    mass.push_back(m);
+    accelerationsValid = false;
+    return mass.size() - 1;
+}
+
+// Accumulate the pull of bodies [begin, end) on body i
+static inline void accumulateRange(size_t i, size_t begin, size_t end, const double* x, const double* y, const double* z,
+                                   const double* m, double eps2, double& sx, double& sy, double& sz) {
+    const double xi = x[i], yi = y[i], zi = z[i];
+    for (size_t j = begin; j < end; ++j) {
+        double dx = x[j] - xi;
+        double dy = y[j] - yi;
+        double dz = z[j] - zi;
+        double r2 = dx * dx + dy * dy + dz * dz + eps2;
+        double invR = 1.0 / std::sqrt(r2);
+        double s = m[j] * invR * invR * invR;
+        sx += s * dx;
+        sy += s * dy;
+        sz += s * dz;
+    }
+}
+
+// Pair-symmetric rows for the fast mode. Task k takes rows k and n-1-k so every task
+// covers about n pairs; the pull on j is accumulated into the calling thread's buffer.
+static void symmetricRow(size_t i, size_t n, const double* x, const double* y, const double* z, const double* m,
+                         double eps2, double* bx, double* by, double* bz) {
+    const double xi = x[i], yi = y[i], zi = z[i], mi = m[i];
+    double sx = 0.0, sy = 0.0, sz = 0.0;
+    for (size_t j = i + 1; j < n; ++j) {
+        double dx = x[j] - xi;
+        double dy = y[j] - yi;
+        double dz = z[j] - zi;
+        double r2 = dx * dx + dy * dy + dz * dz + eps2;
+        double invR = 1.0 / std::sqrt(r2);
+        double invR3 = invR * invR * invR;
+        sx += m[j] * invR3 * dx;
+        sy += m[j] * invR3 * dy;
+        sz += m[j] * invR3 * dz;
+        bx[j] -= mi * invR3 * dx;
+        by[j] -= mi * invR3 * dy;
+        bz[j] -= mi * invR3 * dz;
+    }
+    bx[i] += sx;
+    by[i] += sy;
+    bz[i] += sz;
+}
+
+static inline void neumaierAdd(double& sum, double& compensation, double value) {
+    double t = sum + value;
+    if (std::fabs(sum) >= std::fabs(value)) {
+        compensation += (sum - t) + value;
+    } else {
+        compensation += (value - t) + sum;
+    }
+    sum = t;
+}
+
+static BlockSum sumBlock(size_t i, size_t begin, size_t end, const double* x, const double* y, const double* z,
+                         const double* m, double eps2, bool compensated) {
+    BlockSum b;
+    if (!compensated) {
+        if (i >= begin && i < end) {
+            accumulateRange(i, begin, i, x, y, z, m, eps2, b.x, b.y, b.z);
+            accumulateRange(i, i + 1, end, x, y, z, m, eps2, b.x, b.y, b.z);
+        } else {
+            accumulateRange(i, begin, end, x, y, z, m, eps2, b.x, b.y, b.z);
+        }
+        return b;
+    }
+    const double xi = x[i], yi = y[i], zi = z[i];
+    for (size_t j = begin; j < end; ++j) {
+        if (j == i) {
+            continue;
+        }
+        double dx = x[j] - xi;
+        double dy = y[j] - yi;
+        double dz = z[j] - zi;
+        double r2 = dx * dx + dy * dy + dz * dz + eps2;
+        double invR = 1.0 / std::sqrt(r2);
+        double s = m[j] * invR * invR * invR;
+        neumaierAdd(b.x, b.cx, s * dx);
+        neumaierAdd(b.y, b.cy, s * dy);
+        neumaierAdd(b.z, b.cz, s * dz);
+    }
+    return b;
+}
+
+// Fixed pairwise tree over the block sums; the shape depends only on the block count
+static BlockSum reduceBlocks(const BlockSum* sums, size_t count, bool compensated) {
+    if (count == 1) {
+        return sums[0];
+    }
+    const size_t half = count / 2;
+    BlockSum a = reduceBlocks(sums, half, compensated);
+    BlockSum b = reduceBlocks(sums + half, count - half, compensated);
+    if (!compensated) {
+        a.x += b.x; a.y += b.y; a.z += b.z;
+        return a;
+    }
+    a.cx += b.cx; a.cy += b.cy; a.cz += b.cz;
+    neumaierAdd(a.x, a.cx, b.x);
+    neumaierAdd(a.y, a.cy, b.y);
+    neumaierAdd(a.z, a.cz, b.z);
+    return a;
+}
+
+// Sources per block in the deterministic modes; fixed so results never depend on the thread count
+static const size_t reductionBlock = 256;
+
+void DirectGravity::operator()(size_t nTargets, size_t n, const double* x, const double* y, const double* z,
+                               const double* m, double* ax, double* ay, double* az) const {
+    const double eps2 = softening * softening;
+    const bool parallel = grain != 0 && nTargets * n >= parallelInteractionThreshold;
+    TaskScheduler& scheduler = TaskScheduler::instance();
+
+    if (reduction != ReductionMode::Fast) {
+        const bool compensated = reduction == ReductionMode::Compensated;
+        const size_t blocks = (n + reductionBlock - 1) / reductionBlock;
+        auto finish = [&](size_t i, const BlockSum* sums) {
+            BlockSum total = reduceBlocks(sums, blocks, compensated);
+            ax[i] = G * (total.x + total.cx);
+            ay[i] = G * (total.y + total.cy);
+            az[i] = G * (total.z + total.cz);
+        };
+        if (n == 0) {
+            return;
+        }
+        if (parallel && nTargets < 4 * size_t(scheduler.concurrency())) {
+            // Too few targets to keep every thread busy: spread (target, block) pairs instead
+            if (blockSums.size() < nTargets * blocks) {
+                blockSums.resize(nTargets * blocks);
+            }
+            BlockSum* sums = blockSums.data();
+            scheduler.parallelFor(0, nTargets * blocks, 16, [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; ++k) {
+                    const size_t i = k / blocks, b = k % blocks;
+                    sums[k] = sumBlock(i, b * reductionBlock, std::min(n, (b + 1) * reductionBlock), x, y, z, m,
+                                       eps2, compensated);
+                }
+            });
+            for (size_t i = 0; i < nTargets; ++i) {
+                finish(i, &sums[i * blocks]);
+            }
+            return;
+        }
+        // Each thread keeps its block sums in its own slot of the scratch
+        const size_t slots = scheduler.concurrency();
+        if (blockSums.size() < slots * blocks) {
+            blockSums.resize(slots * blocks);
+        }
+        auto targets = [&](size_t begin, size_t end) {
+            BlockSum* sums = &blockSums[size_t(scheduler.currentSlot()) * blocks];
+            for (size_t i = begin; i < end; ++i) {
+                for (size_t b = 0; b < blocks; ++b) {
+                    sums[b] = sumBlock(i, b * reductionBlock, std::min(n, (b + 1) * reductionBlock), x, y, z, m, eps2,
+                                       compensated);
+                }
+                finish(i, sums);
+            }
+        };
+        if (parallel) {
+            scheduler.parallelFor(0, nTargets, grain, targets);
+        } else {
+            targets(0, nTargets);
+        }
+        return;
+    }
+
+    if (parallel && nTargets == n) {
+        // Every pair once, each thread scattering into its own buffer; the buffers are
+        // then summed, so the grouping of terms depends on which thread ran which rows
+        const unsigned slots = scheduler.concurrency();
+        if (pullBuffers.size() < size_t(slots) * 3 * n) {
+            pullBuffers.assign(size_t(slots) * 3 * n, 0.0);
+        }
+        double* buffers = pullBuffers.data();
+        scheduler.parallelFor(0, (n + 1) / 2, std::max<size_t>(1, grain / 2), [&](size_t begin, size_t end) {
+            double* bx = &buffers[size_t(scheduler.currentSlot()) * 3 * n];
+            double* by = bx + n;
+            double* bz = by + n;
+            for (size_t k = begin; k < end; ++k) {
+                symmetricRow(k, n, x, y, z, m, eps2, bx, by, bz);
+                if (n - 1 - k != k) {
+                    symmetricRow(n - 1 - k, n, x, y, z, m, eps2, bx, by, bz);
+                }
+            }
+        });
+        scheduler.parallelFor(0, n, 4096, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                double sx = 0.0, sy = 0.0, sz = 0.0;
+                // Clear each entry as it is read, so the next call starts from zeroed buffers
+                for (unsigned w = 0; w < slots; ++w) {
+                    double* b = &buffers[size_t(w) * 3 * n];
+                    sx += b[i];
+                    sy += b[n + i];
+                    sz += b[2 * n + i];
+                    b[i] = b[n + i] = b[2 * n + i] = 0.0;
+                }
+                ax[i] = G * sx;
+                ay[i] = G * sy;
+                az[i] = G * sz;
+            }
+        });
+        return;
+    }
+
+    // Each target sums over all sources on its own, so slices of targets are independent
+    auto targets = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            double sx = 0.0, sy = 0.0, sz = 0.0;
+            // Split around i so the inner loops stay branch-free
+            accumulateRange(i, 0, i, x, y, z, m, eps2, sx, sy, sz);
+            accumulateRange(i, i + 1, n, x, y, z, m, eps2, sx, sy, sz);
+            ax[i] = G * sx;
+            ay[i] = G * sy;
+            az[i] = G * sz;
+        }
+    };
+    if (parallel) {
+        scheduler.parallelFor(0, nTargets, grain, targets);
+    } else {
+        targets(0, nTargets);
+    }
+}
+
+double totalEnergy(const BodySystem& s, double G, double softening) {
+    const size_t n = s.size();
+    const double eps2 = softening * softening;
+    double kinetic = 0.0, potential = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        kinetic += 0.5 * s.mass[i] * (s.vx[i] * s.vx[i] + s.vy[i] * s.vy[i] + s.vz[i] * s.vz[i]);
+        for (size_t j = i + 1; j < n; ++j) {
+            double dx = s.x[j] - s.x[i];
+            double dy = s.y[j] - s.y[i];
+            double dz = s.z[j] - s.z[i];
+            potential -= G * s.mass[i] * s.mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+        }
+    }
+    return kinetic + potential;
+}
+
+void moveToCenterOfMass(BodySystem& s) {
+    double m = 0.0, cx = 0.0, cy = 0.0, cz = 0.0, cvx = 0.0, cvy = 0.0, cvz = 0.0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        m += s.mass[i];
+        cx += s.mass[i] * s.x[i]; cy += s.mass[i] * s.y[i]; cz += s.mass[i] * s.z[i];
+        cvx += s.mass[i] * s.vx[i]; cvy += s.mass[i] * s.vy[i]; cvz += s.mass[i] * s.vz[i];
+    }
+    if (m <= 0.0) {
+        return;
+    }
+    for (size_t i = 0; i < s.size(); ++i) {
+        s.x[i] -= cx / m; s.y[i] -= cy / m; s.z[i] -= cz / m;
+        s.vx[i] -= cvx / m; s.vy[i] -= cvy / m; s.vz[i] -= cvz / m;
+    }
+    s.accelerationsValid = false;
+}
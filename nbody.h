@@ -0,0 +1,74 @@
+#ifndef NBODY_H
+#define NBODY_H
+
+#include <cstddef>
+#include <vector>
+
+// Structure-of-arrays body storage shared by all integrators
+struct BodySystem {
+    std::vector<double> x, y, z;    // Positions
+    std::vector<double> vx, vy, vz; // Velocities
+    std::vector<double> ax, ay, az; // Accelerations from the last force evaluation
+    std::vector<double> mass;
+    double time = 0.0;
+    bool accelerationsValid = false; // Cleared whenever positions change outside an integrator
+
+    size_t size() const { return mass.size(); }
+    void reserve(size_t n);
+    size_t addBody(double m, double px, double py, double pz, double pvx, double pvy, double pvz);
+};
+
+// How parallel force sums are reduced.
+// Fast lets each thread accumulate wherever it happens to run, using both halves of
+// every pair (Newton's third law); results can differ in the last bits from run to run.
+// Deterministic sums fixed blocks of sources in order and combines the block sums
+// with a fixed pairwise tree, so results are bit-identical for any thread count or
+// schedule. Compensated is Deterministic with Neumaier summation in the blocks and the tree.
+enum class ReductionMode { Fast, Deterministic, Compensated };
+
+// Sum of one fixed block of sources on one target, plus Neumaier compensation terms
+struct BlockSum {
+    double x = 0.0, y = 0.0, z = 0.0;
+    double cx = 0.0, cy = 0.0, cz = 0.0;
+};
+
+// Direct-summation Newtonian gravity.
+// A force backend is any type with a public `G` and a const call operator over raw SoA spans;
+// the integrators are templated on it so the call is bound at compile time. This kernel
+// itself lives in nbody.cpp, where it splits the work over the task scheduler.
+struct DirectGravity {
+    double G = 1.0;
+    double softening = 0.0; // Plummer softening length
+    size_t grain = 64;      // Targets per scheduler task; 0 keeps the evaluation on the calling thread
+    ReductionMode reduction = ReductionMode::Fast;
+
+    void operator()(size_t n, const double* x, const double* y, const double* z, const double* m,
+                    double* ax, double* ay, double* az) const {
+        (*this)(n, n, x, y, z, m, ax, ay, az);
+    }
+
+    // Accelerations on the first nTargets bodies due to all n bodies
+    void operator()(size_t nTargets, size_t n, const double* x, const double* y, const double* z, const double* m,
+                    double* ax, double* ay, double* az) const;
+
+private:
+    // Scratch kept between evaluations so integrators calling every substep never
+    // allocate; it only grows. An instance must not be evaluated from two threads at once.
+    mutable std::vector<double> pullBuffers;  // Fast mode, one 3n block per scheduler slot, left zeroed
+    mutable std::vector<BlockSum> blockSums;  // Deterministic modes, per target or per slot
+};
+
+// Evaluate the force backend over the whole system and cache the result
+template <class Force>
+inline void computeAccelerations(BodySystem& s, const Force& force) {
+    force(s.size(), s.x.data(), s.y.data(), s.z.data(), s.mass.data(), s.ax.data(), s.ay.data(), s.az.data());
+    s.accelerationsValid = true;
+}
+
+// Total kinetic plus potential energy, used to monitor integrator drift
+double totalEnergy(const BodySystem& s, double G, double softening = 0.0);
+
+// Shift positions and velocities so the barycenter sits at rest at the origin
+void moveToCenterOfMass(BodySystem& s);
+
+#endif
@@ -0,0 +1,57 @@
+#include "orbit_curves.h"
+#include <algorithm>
+
+bool OrbitCurves::init(size_t capacity) {
+    destroy();
+    if (capacity == 0) {
+        return false;
+    }
+    maxOrbits = capacity;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &buffer);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, maxOrbits * orbitElementCount * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    // Shape (q, e, inclination) and orientation plus phase (node, periapsis, anomaly)
+    const GLsizei stride = orbitElementCount * sizeof(float);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribDivisor(1, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return true;
+}
+
+void OrbitCurves::destroy() {
+    if (vao) {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &buffer);
+        vao = buffer = 0;
+    }
+    orbits = maxOrbits = 0;
+}
+
+void OrbitCurves::update(const float* elements, size_t count) {
+    orbits = std::min(count, maxOrbits);
+    if (orbits == 0) {
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, orbits * orbitElementCount * sizeof(float), elements);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void OrbitCurves::draw(GLuint program) const {
+    if (orbits == 0) {
+        return;
+    }
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "segments"), segments);
+    glUniform1f(glGetUniformLocation(program, "maxRadius"), maxRadius);
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_LINE_STRIP, 0, segments + 1, GLsizei(orbits));
+    glBindVertexArray(0);
+}
@@ -0,0 +1,50 @@
+#ifndef ORBIT_CURVES_H
+#define ORBIT_CURVES_H
+
+#include <GL/glew.h>
+#include <cstddef>
+
+// Floats per orbit: q, e, inclination, ascending node, argument of periapsis and the
+// body's current true anomaly, as written by stateToElements
+const int orbitElementCount = 6;
+
+// Conic orbit curves generated entirely in the vertex shader.
+//
+// Each orbit is six floats in an instanced attribute buffer; nothing else is uploaded.
+// One instanced line-strip draw covers every orbit, and the shader places vertex
+// gl_VertexID on instance gl_InstanceID's conic. Vertices are spaced uniformly in the
+// direction of the tangent rather than in anomaly, so each segment turns by the same
+// angle: eccentric orbits get their vertices bunched at periapsis where the curve
+// bends, and no polyline corner is sharper than any other. Ellipses close on
+// themselves; open orbits run out to maxRadius on both sides.
+//
+// Positions are relative to the central body in the elements' frame, drawn with a
+// camera-relative model-view of the body. Orbits with q <= 0 are not drawn.
+class OrbitCurves {
+public:
+    int segments = 256;         // Line segments per orbit
+    float maxRadius = 1.0e6f;   // Extent of open orbits, in the units of q
+
+    OrbitCurves() = default;
+    OrbitCurves(const OrbitCurves&) = delete;
+    OrbitCurves& operator=(const OrbitCurves&) = delete;
+    ~OrbitCurves() { destroy(); }
+
+    bool init(size_t capacity);
+    void destroy();
+
+    // Replace the elements of the first count orbits; only those are drawn
+    void update(const float* elements, size_t count);
+    // Draw with a program built from the orbit shaders; the caller has set its mvp,
+    // colour and depth uniforms
+    void draw(GLuint program) const;
+
+    size_t size() const { return orbits; }
+    size_t capacity() const { return maxOrbits; }
+
+private:
+    GLuint vao = 0, buffer = 0;
+    size_t orbits = 0, maxOrbits = 0;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "orbit_trails.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+bool OrbitTrails::init(size_t bodyCount, size_t pointsPerTrail) {
+    destroy();
+    if (bodyCount == 0 || pointsPerTrail < 2) {
+        return false;
+    }
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    const size_t slotLimit = size_t(maxTexels) / (3 * bodyCount);
+    if (slotLimit < slack + 2) {
+        std::cerr << "Too many bodies for orbit trails: " << bodyCount << std::endl;
+        return false;
+    }
+    bodies = bodyCount;
+    points = std::min(pointsPerTrail, slotLimit - slack);
+    if (points < pointsPerTrail) {
+        std::cerr << "Orbit trails shortened to " << points << " points" << std::endl;
+    }
+    ringSlots = points + slack;
+    const GLsizeiptr bytes = GLsizeiptr(ringSlots * bodies * 3 * sizeof(float));
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    const bool immutable = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    if (immutable) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_TEXTURE_BUFFER, bytes, NULL, flags);
+        mapped = static_cast<float*>(glMapBufferRange(GL_TEXTURE_BUFFER, 0, bytes, flags));
+    }
+    if (!mapped) {
+        // Plain buffer; immutable storage that failed to map cannot be respecified
+        if (immutable) {
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        }
+        glBufferData(GL_TEXTURE_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    // Core profiles need a vertex array even when the shader reads no attributes
+    glGenVertexArrays(1, &vao);
+
+    // Trail b covers vertex indices [b * ringSlots, b * ringSlots + count)
+    firsts.resize(bodies);
+    counts.assign(bodies, 0);
+    for (size_t b = 0; b < bodies; ++b) {
+        firsts[b] = GLint(b * ringSlots);
+    }
+    appended = validFrom = 0;
+    return true;
+}
+
+void OrbitTrails::destroy() {
+    for (GLsync& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+    if (buffer) {
+        if (mapped) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glUnmapBuffer(GL_TEXTURE_BUFFER);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            mapped = nullptr;
+        }
+        glDeleteTextures(1, &texture);
+        glDeleteBuffers(1, &buffer);
+        glDeleteVertexArrays(1, &vao);
+        buffer = texture = vao = 0;
+    }
+    bodies = points = ringSlots = 0;
+}
+
+size_t OrbitTrails::samplesShown() const {
+    return size_t(std::min<unsigned long long>(appended - validFrom, points));
+}
+
+void OrbitTrails::append(const float* xyz) {
+    if (!buffer) {
+        return;
+    }
+    const size_t slot = size_t(appended % ringSlots);
+    const size_t blockBytes = bodies * 3 * sizeof(float);
+    if (mapped) {
+        // This slot was last visible while the newest sample was appended - slack - 1,
+        // whose fence shares this entry
+        GLsync& fence = fences[appended % (slack + 1)];
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+            glDeleteSync(fence);
+            fence = 0;
+        }
+        std::memcpy(mapped + slot * bodies * 3, xyz, blockBytes);
+    } else {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, GLintptr(slot * blockBytes), GLsizeiptr(blockBytes), xyz);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+    ++appended;
+}
+
+void OrbitTrails::draw(GLuint program) {
+    const size_t shown = samplesShown();
+    if (shown < 2) {
+        return;
+    }
+    if (counts[0] != GLsizei(shown)) {
+        std::fill(counts.begin(), counts.end(), GLsizei(shown));
+    }
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glUniform1i(glGetUniformLocation(program, "trailPoints"), 0);
+    glUniform1i(glGetUniformLocation(program, "bodyCount"), GLint(bodies));
+    glUniform1i(glGetUniformLocation(program, "ringSlots"), GLint(ringSlots));
+    glUniform1i(glGetUniformLocation(program, "oldestSlot"), GLint((appended - shown) % ringSlots));
+    glUniform1i(glGetUniformLocation(program, "trailCount"), GLint(shown));
+
+    glBindVertexArray(vao);
+    glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(), GLsizei(bodies));
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    if (mapped) {
+        // Replace the fence for the newest sample with one after this draw
+        GLsync& fence = fences[(appended - 1) % (slack + 1)];
+        if (fence) {
+            glDeleteSync(fence);
+        }
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
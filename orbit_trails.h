@@ -0,0 +1,63 @@
+#ifndef ORBIT_TRAILS_H
+#define ORBIT_TRAILS_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// Fading trails of each body's recent positions, kept entirely on the GPU.
+//
+// Samples live in one buffer laid out [ring slot][body], so appending a sample for
+// every body writes a single contiguous block and nothing already written is touched
+// again. With GL 4.4 or ARB_buffer_storage the buffer is persistently mapped and
+// appends are a plain copy into it; otherwise the block goes up with one
+// glBufferSubData. The vertex shader pulls positions through a buffer texture: each
+// body's trail is one line strip whose vertex index selects the ring slot, oldest to
+// newest, and the fade follows from that index. All trails draw with one
+// glMultiDrawArrays.
+//
+// The ring holds a few more slots than are drawn, and a fence per appended sample
+// ensures the GPU has finished every draw that could still read a slot before it is
+// overwritten; in practice those fences have long signalled.
+//
+// Positions are floats relative to a caller-chosen origin (km from the Earth's centre
+// in the scene), drawn with a camera-relative model-view of that origin. Non-finite
+// positions break the trail: segments touching them are discarded.
+class OrbitTrails {
+public:
+    OrbitTrails() = default;
+    OrbitTrails(const OrbitTrails&) = delete;
+    OrbitTrails& operator=(const OrbitTrails&) = delete;
+    ~OrbitTrails() { destroy(); }
+
+    // Allocate trails for bodyCount bodies of up to pointsPerTrail samples each; the
+    // length is reduced if the buffer texture would exceed the implementation's limit
+    bool init(size_t bodyCount, size_t pointsPerTrail);
+    void destroy();
+
+    // Forget every trail, e.g. after the clock jumps backwards
+    void clear() { validFrom = appended; }
+    // Append one sample for every body, 3 floats per body
+    void append(const float* xyz);
+    // Draw every trail with a program built from the trail shaders; the caller has set
+    // its mvp, colour and depth uniforms
+    void draw(GLuint program);
+
+    size_t bodyCount() const { return bodies; }
+    size_t trailLength() const { return points; }
+    size_t samplesShown() const;
+    bool persistentlyMapped() const { return mapped != nullptr; }
+
+private:
+    static const size_t slack = 3; // Ring slots beyond the drawn length
+
+    GLuint buffer = 0, texture = 0, vao = 0;
+    float* mapped = nullptr;
+    size_t bodies = 0, points = 0, ringSlots = 0;
+    unsigned long long appended = 0, validFrom = 0;
+    GLsync fences[slack + 1] = {};
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+};
+
+#endif
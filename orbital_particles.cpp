@@ -0,0 +1,211 @@
+#include "orbital_particles.h"
+#include "shader.h"
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// Places the particle at its epoch's mean anomaly plus the time since, and moves the
+// epoch up to now when asked. Rates are the secular J2 drifts of the node, periapsis and
+// mean anomaly; mod() keeps every angle in [0, 2 pi) in either direction of time. Six
+// Newton steps solve Kepler's equation to float precision for the eccentricities
+// generated here.
+static const char* updateShaderSource = R"(
+#version 330 core
+layout(location = 0) in vec4 shape;       // a, e, i, brightness
+layout(location = 1) in vec2 orientation; // Node and periapsis at the start
+layout(location = 2) in float epochAnomaly;
+out float nextEpochAnomaly;
+out vec3 position;
+uniform float mu;
+uniform float j2r2;       // J2 times the reference radius squared
+uniform float elapsed;    // Since the start
+uniform float sinceEpoch; // Since the epoch of the mean anomalies read
+uniform bool rebase;      // Write the current mean anomalies as the new epoch's
+
+const float twoPi = 6.28318531;
+
+void main() {
+    float a = shape.x;
+    float e = shape.y;
+    float cosI = cos(shape.z);
+    float sinI = sin(shape.z);
+    float n = sqrt(mu / a) / a;
+    float p = a * (1.0 - e * e);
+    float k = 1.5 * n * j2r2 / (p * p);
+    float eta = sqrt(1.0 - e * e);
+    vec3 rates = vec3(-k * cosI, k * (2.0 - 2.5 * sinI * sinI), n + k * eta * (1.0 - 1.5 * sinI * sinI));
+    float M = mod(epochAnomaly + rates.z * sinceEpoch, twoPi);
+    nextEpochAnomaly = rebase ? M : epochAnomaly;
+    vec2 angles = mod(orientation + rates.xy * elapsed, twoPi);
+
+    float E = e < 0.8 ? M : 3.14159265;
+    for (int iteration = 0; iteration < 6; ++iteration) {
+        E -= (E - e * sin(E) - M) / (1.0 - e * cos(E));
+    }
+    vec2 perifocal = a * vec2(cos(E) - e, eta * sin(E));
+
+    float cosNode = cos(angles.x), sinNode = sin(angles.x);
+    float cosArg = cos(angles.y), sinArg = sin(angles.y);
+    vec3 P = vec3(cosNode * cosArg - sinNode * sinArg * cosI, sinNode * cosArg + cosNode * sinArg * cosI, sinArg * sinI);
+    vec3 Q = vec3(-cosNode * sinArg - sinNode * cosArg * cosI, -sinNode * sinArg + cosNode * cosArg * cosI, cosArg * sinI);
+    position = perifocal.x * P + perifocal.y * Q;
+}
+)";
+
+bool OrbitalParticles::init(const ParticleOrbit* orbits, size_t count) {
+    destroy();
+    if (count == 0) {
+        return false;
+    }
+    // Captured interleaved, matching the state buffer layout
+    const char* const varyings[] = {"nextEpochAnomaly", "position"};
+    updateProgram = createTransformFeedbackProgram(updateShaderSource, varyings, 2);
+    if (!updateProgram) {
+        return false;
+    }
+    particles = count;
+
+    // Shapes are (a, e, i, brightness, node, periapsis); state is (epoch mean anomaly, x, y, z)
+    std::vector<float> shapes(count * 6), state(count * 4, 0.0f);
+    for (size_t i = 0; i < count; ++i) {
+        shapes[6 * i] = orbits[i].semiMajorAxis;
+        shapes[6 * i + 1] = orbits[i].eccentricity;
+        shapes[6 * i + 2] = orbits[i].inclination;
+        shapes[6 * i + 3] = orbits[i].brightness;
+        shapes[6 * i + 4] = orbits[i].node;
+        shapes[6 * i + 5] = orbits[i].periapsis;
+        state[4 * i] = orbits[i].meanAnomaly;
+    }
+    glGenBuffers(1, &shapeBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, shapeBuffer);
+    glBufferData(GL_ARRAY_BUFFER, shapes.size() * sizeof(float), shapes.data(), GL_STATIC_DRAW);
+    glGenBuffers(2, stateBuffers);
+    for (GLuint buffer : stateBuffers) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, state.size() * sizeof(float), state.data(), GL_DYNAMIC_COPY);
+    }
+
+    // The update reads shape, orientation and mean anomaly; drawing reads position and brightness
+    glGenVertexArrays(2, updateVaos);
+    glGenVertexArrays(2, drawVaos);
+    const GLsizei shapeStride = 6 * sizeof(float), stateStride = 4 * sizeof(float);
+    for (int k = 0; k < 2; ++k) {
+        glBindVertexArray(updateVaos[k]);
+        glBindBuffer(GL_ARRAY_BUFFER, shapeBuffer);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, shapeStride, (void*)0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, shapeStride, (void*)(4 * sizeof(float)));
+        glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[k]);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stateStride, (void*)0);
+        for (GLuint attribute = 0; attribute < 3; ++attribute) {
+            glEnableVertexAttribArray(attribute);
+        }
+
+        glBindVertexArray(drawVaos[k]);
+        glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[k]);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stateStride, (void*)sizeof(float));
+        glBindBuffer(GL_ARRAY_BUFFER, shapeBuffer);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, shapeStride, (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    // Fill in the starting positions
+    current = 0;
+    elapsed = sinceEpoch = 0.0;
+    update(0.0);
+    return true;
+}
+
+void OrbitalParticles::destroy() {
+    if (updateProgram) {
+        glDeleteProgram(updateProgram);
+    }
+    if (shapeBuffer) {
+        glDeleteVertexArrays(2, updateVaos);
+        glDeleteVertexArrays(2, drawVaos);
+        glDeleteBuffers(2, stateBuffers);
+        glDeleteBuffers(1, &shapeBuffer);
+    }
+    updateProgram = shapeBuffer = 0;
+    for (int k = 0; k < 2; ++k) {
+        stateBuffers[k] = updateVaos[k] = drawVaos[k] = 0;
+    }
+    particles = 0;
+    current = 0;
+}
+
+void OrbitalParticles::update(double dt) {
+    if (particles == 0) {
+        return;
+    }
+    glUseProgram(updateProgram);
+    glUniform1f(glGetUniformLocation(updateProgram, "mu"), (float)mu);
+    glUniform1f(glGetUniformLocation(updateProgram, "j2r2"), (float)(j2 * referenceRadius * referenceRadius));
+    elapsed += dt;
+    sinceEpoch += dt;
+    const bool rebase = std::fabs(sinceEpoch) >= rebaseSeconds;
+    glUniform1f(glGetUniformLocation(updateProgram, "elapsed"), (float)elapsed);
+    glUniform1f(glGetUniformLocation(updateProgram, "sinceEpoch"), (float)sinceEpoch);
+    glUniform1i(glGetUniformLocation(updateProgram, "rebase"), rebase);
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(updateVaos[current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, stateBuffers[1 - current]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, GLsizei(particles));
+    glEndTransformFeedback();
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    current = 1 - current;
+    if (rebase) {
+        sinceEpoch = 0.0;
+    }
+}
+
+void OrbitalParticles::draw(GLuint program) const {
+    if (particles == 0) {
+        return;
+    }
+    glUseProgram(program);
+    glBindVertexArray(drawVaos[current]);
+    glDrawArrays(GL_POINTS, 0, GLsizei(particles));
+    glBindVertexArray(0);
+}
+
+void generateRingParticles(std::vector<ParticleOrbit>& out, size_t count, const float (*bands)[3], size_t bandCount,
+                           unsigned seed) {
+    std::vector<double> weights(bandCount);
+    for (size_t b = 0; b < bandCount; ++b) {
+        weights[b] = bands[b][2] * (bands[b][1] * bands[b][1] - bands[b][0] * bands[b][0]);
+    }
+    std::mt19937 rng(seed);
+    std::discrete_distribution<size_t> band(weights.begin(), weights.end());
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> scatter(0.0f, 1.0f);
+    out.reserve(out.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+        const float* b = bands[band(rng)];
+        // Uniform over the band's area, on near-circular, near-equatorial orbits
+        float r = std::sqrt(b[0] * b[0] + unit(rng) * (b[1] * b[1] - b[0] * b[0]));
+        out.push_back({r, 1.0e-4f * unit(rng), 1.0e-5f * std::fabs(scatter(rng)), 6.2831853f * unit(rng),
+                       6.2831853f * unit(rng), 6.2831853f * unit(rng), 0.5f + 0.5f * unit(rng)});
+    }
+}
+
+void generateDebrisParticles(std::vector<ParticleOrbit>& out, size_t count, float minPerigee, float maxPerigee,
+                             float maxEccentricity, float maxInclination, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float cosMax = std::cos(maxInclination);
+    out.reserve(out.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+        float perigee = minPerigee + unit(rng) * (maxPerigee - minPerigee);
+        float e = maxEccentricity * unit(rng);
+        // Orbit normals uniform over the cap of the sphere within maxInclination of the pole
+        float inclination = std::acos(1.0f - unit(rng) * (1.0f - cosMax));
+        out.push_back({perigee / (1.0f - e), e, inclination, 6.2831853f * unit(rng), 6.2831853f * unit(rng),
+                       6.2831853f * unit(rng), 0.3f + 0.7f * unit(rng)});
+    }
+}
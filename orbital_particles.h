@@ -0,0 +1,79 @@
+#ifndef ORBITAL_PARTICLES_H
+#define ORBITAL_PARTICLES_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// One particle's starting orbit about its parent. Angles are radians; distances are km
+// in the parent's equatorial frame (z to the pole).
+struct ParticleOrbit {
+    float semiMajorAxis;
+    float eccentricity;
+    float inclination;
+    float node;
+    float periapsis;
+    float meanAnomaly;
+    float brightness; // Sprite intensity, 0 to 1
+};
+
+// Ring and debris particles that orbit their parent analytically on the GPU (GL 3.3).
+//
+// The fixed part of each orbit (a, e, i, brightness and the starting node and periapsis)
+// sits in one buffer. The mean anomaly at an epoch and the current position sit in two
+// state buffers used in turn: an update is a point draw with rasterization off that
+// reads one state buffer, takes the mean anomaly n t past the epoch, solves Kepler's
+// equation and captures the position into the other with transform feedback.
+//
+// Single precision decides the layout. Adding n dt to a wrapped anomaly every frame
+// rounds the same way each time and the error builds into a drift, so the epoch only
+// moves up to the current anomaly about once a simulated hour, and every other frame
+// starts from it afresh. The node and periapsis drift at the parent's secular J2 rates,
+// too slowly to survive even that, so they come from their starting values and the
+// time since init. Drawing reads the latest state buffer as point sprites, so the CPU
+// does no work per particle after init.
+class OrbitalParticles {
+public:
+    double mu = 398600.8;         // Parent's gravitational parameter, km^3 / s^2
+    double j2 = 0.0;              // Parent's oblateness
+    double referenceRadius = 0.0; // Radius J2 is given for, km
+
+    OrbitalParticles() = default;
+    OrbitalParticles(const OrbitalParticles&) = delete;
+    OrbitalParticles& operator=(const OrbitalParticles&) = delete;
+    ~OrbitalParticles() { destroy(); }
+
+    // Upload the particles and compute their first positions; set mu and J2 first
+    bool init(const ParticleOrbit* particles, size_t count);
+    void destroy();
+
+    // Move every particle on by dt seconds, which may be negative
+    void update(double dt);
+    // Draw as points with a program built from the particle shaders; the caller has
+    // set its uniforms and enabled GL_PROGRAM_POINT_SIZE
+    void draw(GLuint program) const;
+
+    size_t size() const { return particles; }
+
+private:
+    static constexpr double rebaseSeconds = 3600.0; // Simulated time between epochs
+
+    GLuint updateProgram = 0;
+    GLuint shapeBuffer = 0;
+    GLuint stateBuffers[2] = {0, 0};
+    GLuint updateVaos[2] = {0, 0}, drawVaos[2] = {0, 0}; // Indexed by the state buffer read
+    int current = 0;                                     // State buffer holding the latest positions
+    size_t particles = 0;
+    double elapsed = 0.0, sinceEpoch = 0.0;              // Seconds since init and since the epoch
+};
+
+// A flat ring of bands about the parent's equator. Each band is {inner km, outer km,
+// relative surface density}; particles are shared out by density times area.
+void generateRingParticles(std::vector<ParticleOrbit>& out, size_t count, const float (*bands)[3], size_t bandCount,
+                           unsigned seed);
+// A debris cloud with perigees between two radii, eccentricities up to maxEccentricity and
+// inclinations spread evenly over the sphere up to maxInclination
+void generateDebrisParticles(std::vector<ParticleOrbit>& out, size_t count, float minPerigee, float maxPerigee,
+                             float maxEccentricity, float maxInclination, unsigned seed);
+
+#endif
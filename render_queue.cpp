@@ -0,0 +1,106 @@
+#include "render_queue.h"
+#include <algorithm>
+#include <cstring>
+
+// Stands for a binding the queue has not made itself; no GL name reaches it
+static const GLuint unknownBinding = ~GLuint(0);
+
+// Distance as an orderable integer: the bits of a non-negative float sort like its value
+static std::uint64_t depthBits(float depth) {
+    if (!(depth > 0.0f)) {
+        depth = 0.0f;
+    }
+    std::uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits;
+}
+
+void RenderQueue::submit(RenderLayer layer, GLuint program, GLuint texture, GLuint vertexArray, float depth,
+                         std::function<void()> draw) {
+    const std::uint64_t state = std::uint64_t(program & 0x3ff) << 20 | std::uint64_t(texture & 0x3ff) << 10 |
+                                std::uint64_t(vertexArray & 0x3ff);
+    std::uint64_t key = std::uint64_t(layer) << 62;
+    if (layer == RenderLayer::Translucent) {
+        key |= (0xffffffffu - depthBits(depth)) << 30 | state;
+    } else {
+        key |= state << 32 | depthBits(depth);
+    }
+    order.push_back({key, std::uint32_t(commands.size())});
+    commands.push_back({program, texture, vertexArray, std::move(draw)});
+}
+
+void RenderQueue::useProgram(GLuint program) {
+    if (program == boundProgram) {
+        ++stats.redundantCalls;
+        return;
+    }
+    glUseProgram(program);
+    boundProgram = program;
+    ++stats.stateCalls;
+}
+
+void RenderQueue::bindTexture(GLuint texture) {
+    if (texture == boundTexture) {
+        ++stats.redundantCalls;
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    boundTexture = texture;
+    ++stats.stateCalls;
+}
+
+void RenderQueue::bindVertexArray(GLuint vertexArray) {
+    if (vertexArray == boundVertexArray) {
+        ++stats.redundantCalls;
+        return;
+    }
+    glBindVertexArray(vertexArray);
+    boundVertexArray = vertexArray;
+    ++stats.stateCalls;
+}
+
+void RenderQueue::flush() {
+    stats = RenderStats();
+    boundProgram = boundTexture = boundVertexArray = unknownBinding;
+    std::stable_sort(order.begin(), order.end(),
+                     [](const std::pair<std::uint64_t, std::uint32_t>& a, const std::pair<std::uint64_t, std::uint32_t>& b) {
+                         return a.first < b.first;
+                     });
+
+    glActiveTexture(GL_TEXTURE0);
+    int layer = int(RenderLayer::Opaque);
+    for (const std::pair<std::uint64_t, std::uint32_t>& entry : order) {
+        const Command& command = commands[entry.second];
+        const int commandLayer = int(entry.first >> 62);
+        if (commandLayer != layer) {
+            glEnable(GL_BLEND);
+            glDepthMask(GL_FALSE);
+            if (commandLayer == int(RenderLayer::Additive)) {
+                glBlendFunc(GL_ONE, GL_ONE);
+            } else {
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            }
+            layer = commandLayer;
+        }
+        useProgram(command.program);
+        if (command.texture) {
+            bindTexture(command.texture);
+        }
+        if (command.vertexArray) {
+            bindVertexArray(command.vertexArray);
+        }
+        command.draw();
+        // Drawing classes bind their own vertex array and unbind it when done
+        if (!command.vertexArray) {
+            boundVertexArray = 0;
+        }
+        ++stats.draws;
+    }
+    if (layer != int(RenderLayer::Opaque)) {
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+
+    commands.clear();
+    order.clear();
+}
@@ -0,0 +1,66 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Passes in the order they are drawn, each with its own blending
+enum class RenderLayer {
+    Opaque,     // Depth tested and written, front to back
+    Additive,   // Light added without depth writes
+    Translucent // Alpha blended without depth writes, back to front
+};
+
+struct RenderStats {
+    long long draws = 0;          // Commands issued
+    long long stateCalls = 0;     // glUseProgram, glBindTexture and glBindVertexArray calls made
+    long long redundantCalls = 0; // Calls skipped because the object was already bound
+};
+
+// Draws recorded over a frame and issued together, sorted to bind as little as possible.
+//
+// Each command names the program, 2D texture and vertex array it draws with, a layer
+// and its distance from the eye, and a function that sets its uniforms and makes the
+// draw calls. These pack into a 64-bit key: the layer first, then for opaque and
+// additive layers the program, texture and vertex array with distance last, so
+// commands sharing state end up together and the nearest draw first within a group;
+// translucent layers sort by distance, farthest first, before state. A stable sort
+// keeps submission order among equal keys. Issuing tracks what is bound and skips
+// binding an object again. Objects are 10 bits of their GL name in the key; two names
+// sharing them only group less well.
+class RenderQueue {
+public:
+    RenderStats stats; // For the last flush()
+
+    // Record a draw. texture is bound to unit 0 as GL_TEXTURE_2D, or left alone when 0.
+    // vertexArray is bound likewise, or 0 for a draw that binds its own and leaves none
+    // bound, as the drawing classes do. draw runs with the program bound.
+    void submit(RenderLayer layer, GLuint program, GLuint texture, GLuint vertexArray, float depth,
+                std::function<void()> draw);
+
+    // Sort and issue the recorded draws and clear them. Bindings made outside the queue
+    // are unknown, so the first of each is always made; blending ends off and depth
+    // writes on.
+    void flush();
+
+    size_t size() const { return commands.size(); }
+
+private:
+    struct Command {
+        GLuint program, texture, vertexArray;
+        std::function<void()> draw;
+    };
+    std::vector<Command> commands;
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> order; // Key and command index
+    GLuint boundProgram = 0, boundTexture = 0, boundVertexArray = 0;
+
+    void useProgram(GLuint program);
+    void bindTexture(GLuint texture);
+    void bindVertexArray(GLuint vertexArray);
+};
+
+#endif
@@ -0,0 +1,917 @@
+#include "sgp4.h"
+#include "task_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+// Derived WGS-72 constants in SGP4's internal units (earth radii, minutes)
+static const double twoPi = 2.0 * M_PI;
+static const double x2o3 = 2.0 / 3.0;
+static const double xke = 60.0 / std::sqrt(sgp4EarthRadiusKm * sgp4EarthRadiusKm * sgp4EarthRadiusKm / sgp4Mu);
+static const double j2 = 0.001082616;
+static const double j3 = -0.00000253881;
+static const double j4 = -0.00000165597;
+static const double j3oj2 = j3 / j2;
+static const double velocityKmPerSec = sgp4EarthRadiusKm * xke / 60.0;
+
+double julianDate(int year, int month, int day, int hour, int minute, double second) {
+    return 367.0 * year - std::floor((7 * (year + std::floor((month + 9) / 12.0))) * 0.25) +
+           std::floor(275 * month / 9.0) + day + 1721013.5 + ((second / 60.0 + minute) / 60.0 + hour) / 24.0;
+}
+
+double greenwichSiderealTime(double jdUt1) {
+    const double tut1 = (jdUt1 - 2451545.0) / 36525.0;
+    double seconds = -6.2e-6 * tut1 * tut1 * tut1 + 0.093104 * tut1 * tut1 +
+                     (876600.0 * 3600 + 8640184.812866) * tut1 + 67310.54841;
+    double angle = std::fmod(seconds * (M_PI / 180.0) / 240.0, twoPi);
+    if (angle < 0.0) {
+        angle += twoPi;
+    }
+    return angle;
+}
+
+// Read a fixed-width numeric field
+static double field(const std::string& line, size_t start, size_t length) {
+    std::string s = line.substr(start, length);
+    return std::strtod(s.c_str(), nullptr);
+}
+
+// Fields such as " 12345-3" carry an implied leading decimal point and an exponent
+static double impliedDecimalField(const std::string& line, size_t start) {
+    std::string s = line.substr(start, 8);
+    double sign = s[0] == '-' ? -1.0 : 1.0;
+    double mantissa = std::strtod(("0." + s.substr(1, 5)).c_str(), nullptr);
+    int exponent = std::atoi(s.substr(6, 2).c_str());
+    return sign * mantissa * std::pow(10.0, exponent);
+}
+
+bool parseTle(const std::string& line0, const std::string& line1, const std::string& line2, TleElements& tle) {
+    if (line1.size() < 64 || line2.size() < 63 || line1[0] != '1' || line2[0] != '2') {
+        return false;
+    }
+    const double xpdotp = 1440.0 / twoPi;
+    const double deg2rad = M_PI / 180.0;
+
+    tle.name = line0;
+    while (!tle.name.empty() && (tle.name.back() == ' ' || tle.name.back() == '\r')) {
+        tle.name.pop_back();
+    }
+    tle.satelliteNumber = std::atoi(line1.substr(2, 5).c_str());
+
+    int year = std::atoi(line1.substr(18, 2).c_str());
+    year += year < 57 ? 2000 : 1900;
+    double days = field(line1, 20, 12);
+    tle.epochJd = julianDate(year, 1, 1, 0, 0, 0.0) - 1.0 + days;
+
+    tle.ndot = field(line1, 33, 10) / (xpdotp * 1440.0);
+    tle.nddot = impliedDecimalField(line1, 44) / (xpdotp * 1440.0 * 1440.0);
+    tle.bstar = impliedDecimalField(line1, 53);
+
+    tle.inclination = field(line2, 8, 8) * deg2rad;
+    tle.raan = field(line2, 17, 8) * deg2rad;
+    tle.eccentricity = std::strtod(("0." + line2.substr(26, 7)).c_str(), nullptr);
+    tle.argPerigee = field(line2, 34, 8) * deg2rad;
+    tle.meanAnomaly = field(line2, 43, 8) * deg2rad;
+    tle.meanMotion = field(line2, 52, 11) / xpdotp;
+    return tle.meanMotion > 0.0;
+}
+
+bool Sgp4Catalog::loadTleFile(const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open TLE catalog " << path << std::endl;
+        return false;
+    }
+    std::string name, line, previous;
+    size_t rejected = 0;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.size() > 1 && line[0] == '1' && line[1] == ' ') {
+            std::string line2;
+            if (!std::getline(file, line2)) {
+                break;
+            }
+            if (!line2.empty() && line2.back() == '\r') {
+                line2.pop_back();
+            }
+            TleElements tle;
+            if (!parseTle(previous, line, line2, tle) || !add(tle)) {
+                ++rejected;
+            }
+            previous.clear();
+        } else {
+            // Optional name line of the three-line format
+            previous = line.size() > 2 && line[0] == '0' && line[1] == ' ' ? line.substr(2) : line;
+        }
+    }
+    if (rejected > 0) {
+        std::cerr << "Skipped " << rejected << " unusable TLEs in " << path << std::endl;
+    }
+    return size() > 0;
+}
+
+double Sgp4Catalog::latestEpoch() const {
+    double latest = 0.0;
+    for (double jd : epochJd) {
+        latest = std::max(latest, jd);
+    }
+    return latest;
+}
+
+// Lunar-solar secular and periodic coefficients for deep-space orbits
+struct Sgp4DeepCommon {
+    double snodm, cnodm, sinim, cosim, sinomm, cosomm, day, em, emsq, gam, rtemsq, nm;
+    double s1, s2, s3, s4, s5, s6, s7, ss1, ss2, ss3, ss4, ss5, ss6, ss7;
+    double sz1, sz2, sz3, sz11, sz12, sz13, sz21, sz22, sz23, sz31, sz32, sz33;
+    double z1, z2, z3, z11, z12, z13, z21, z22, z23, z31, z32, z33;
+};
+
+static void deepSpaceCommon(double epoch, double ep, double argpp, double tc, double inclp, double nodep, double np,
+                            Sgp4DeepCommon& c, Sgp4DeepSpace& d) {
+    const double zes = 0.01675, zel = 0.05490, c1ss = 2.9864797e-6, c1l = 4.7968065e-7;
+    const double zsinis = 0.39785416, zcosis = 0.91744867, zcosgs = 0.1945905, zsings = -0.98088458;
+
+    c.nm = np;
+    c.em = ep;
+    c.snodm = std::sin(nodep); c.cnodm = std::cos(nodep);
+    c.sinomm = std::sin(argpp); c.cosomm = std::cos(argpp);
+    c.sinim = std::sin(inclp); c.cosim = std::cos(inclp);
+    c.emsq = c.em * c.em;
+    const double betasq = 1.0 - c.emsq;
+    c.rtemsq = std::sqrt(betasq);
+
+    d.peo = 0.0; d.pinco = 0.0; d.plo = 0.0; d.pgho = 0.0; d.pho = 0.0;
+    c.day = epoch + 18261.5 + tc / 1440.0;
+    const double xnodce = std::fmod(4.5236020 - 9.2422029e-4 * c.day, twoPi);
+    const double stem = std::sin(xnodce), ctem = std::cos(xnodce);
+    const double zcosil = 0.91375164 - 0.03568096 * ctem;
+    const double zsinil = std::sqrt(1.0 - zcosil * zcosil);
+    const double zsinhl = 0.089683511 * stem / zsinil;
+    const double zcoshl = std::sqrt(1.0 - zsinhl * zsinhl);
+    c.gam = 5.8351514 + 0.0019443680 * c.day;
+    double zx = 0.39785416 * stem / zsinil;
+    const double zy = zcoshl * ctem + 0.91744867 * zsinhl * stem;
+    zx = std::atan2(zx, zy);
+    zx = c.gam + zx - xnodce;
+    const double zcosgl = std::cos(zx), zsingl = std::sin(zx);
+
+    // Solar terms first, then the same expansion for the moon
+    double zcosg = zcosgs, zsing = zsings, zcosi = zcosis, zsini = zsinis;
+    double zcosh = c.cnodm, zsinh = c.snodm, cc = c1ss;
+    const double xnoi = 1.0 / c.nm;
+    for (int lsflg = 1; lsflg <= 2; ++lsflg) {
+        const double a1 = zcosg * zcosh + zsing * zcosi * zsinh;
+        const double a3 = -zsing * zcosh + zcosg * zcosi * zsinh;
+        const double a7 = -zcosg * zsinh + zsing * zcosi * zcosh;
+        const double a8 = zsing * zsini;
+        const double a9 = zsing * zsinh + zcosg * zcosi * zcosh;
+        const double a10 = zcosg * zsini;
+        const double a2 = c.cosim * a7 + c.sinim * a8;
+        const double a4 = c.cosim * a9 + c.sinim * a10;
+        const double a5 = -c.sinim * a7 + c.cosim * a8;
+        const double a6 = -c.sinim * a9 + c.cosim * a10;
+
+        const double x1 = a1 * c.cosomm + a2 * c.sinomm;
+        const double x2 = a3 * c.cosomm + a4 * c.sinomm;
+        const double x3 = -a1 * c.sinomm + a2 * c.cosomm;
+        const double x4 = -a3 * c.sinomm + a4 * c.cosomm;
+        const double x5 = a5 * c.sinomm;
+        const double x6 = a6 * c.sinomm;
+        const double x7 = a5 * c.cosomm;
+        const double x8 = a6 * c.cosomm;
+
+        c.z31 = 12.0 * x1 * x1 - 3.0 * x3 * x3;
+        c.z32 = 24.0 * x1 * x2 - 6.0 * x3 * x4;
+        c.z33 = 12.0 * x2 * x2 - 3.0 * x4 * x4;
+        c.z1 = 3.0 * (a1 * a1 + a2 * a2) + c.z31 * c.emsq;
+        c.z2 = 6.0 * (a1 * a3 + a2 * a4) + c.z32 * c.emsq;
+        c.z3 = 3.0 * (a3 * a3 + a4 * a4) + c.z33 * c.emsq;
+        c.z11 = -6.0 * a1 * a5 + c.emsq * (-24.0 * x1 * x7 - 6.0 * x3 * x5);
+        c.z12 = -6.0 * (a1 * a6 + a3 * a5) + c.emsq * (-24.0 * (x2 * x7 + x1 * x8) - 6.0 * (x3 * x6 + x4 * x5));
+        c.z13 = -6.0 * a3 * a6 + c.emsq * (-24.0 * x2 * x8 - 6.0 * x4 * x6);
+        c.z21 = 6.0 * a2 * a5 + c.emsq * (24.0 * x1 * x5 - 6.0 * x3 * x7);
+        c.z22 = 6.0 * (a4 * a5 + a2 * a6) + c.emsq * (24.0 * (x2 * x5 + x1 * x6) - 6.0 * (x4 * x7 + x3 * x8));
+        c.z23 = 6.0 * a4 * a6 + c.emsq * (24.0 * x2 * x6 - 6.0 * x4 * x8);
+        c.z1 = c.z1 + c.z1 + betasq * c.z31;
+        c.z2 = c.z2 + c.z2 + betasq * c.z32;
+        c.z3 = c.z3 + c.z3 + betasq * c.z33;
+        c.s3 = cc * xnoi;
+        c.s2 = -0.5 * c.s3 / c.rtemsq;
+        c.s4 = c.s3 * c.rtemsq;
+        c.s1 = -15.0 * c.em * c.s4;
+        c.s5 = x1 * x3 + x2 * x4;
+        c.s6 = x2 * x3 + x1 * x4;
+        c.s7 = x2 * x4 - x1 * x3;
+
+        if (lsflg == 1) {
+            c.ss1 = c.s1; c.ss2 = c.s2; c.ss3 = c.s3; c.ss4 = c.s4; c.ss5 = c.s5; c.ss6 = c.s6; c.ss7 = c.s7;
+            c.sz1 = c.z1; c.sz2 = c.z2; c.sz3 = c.z3;
+            c.sz11 = c.z11; c.sz12 = c.z12; c.sz13 = c.z13;
+            c.sz21 = c.z21; c.sz22 = c.z22; c.sz23 = c.z23;
+            c.sz31 = c.z31; c.sz32 = c.z32; c.sz33 = c.z33;
+            zcosg = zcosgl; zsing = zsingl; zcosi = zcosil; zsini = zsinil;
+            zcosh = zcoshl * c.cnodm + zsinhl * c.snodm;
+            zsinh = c.snodm * zcoshl - c.cnodm * zsinhl;
+            cc = c1l;
+        }
+    }
+
+    d.zmol = std::fmod(4.7199672 + 0.22997150 * c.day - c.gam, twoPi);
+    d.zmos = std::fmod(6.2565837 + 0.017201977 * c.day, twoPi);
+
+    // Solar periodic coefficients
+    d.se2 = 2.0 * c.ss1 * c.ss6;
+    d.se3 = 2.0 * c.ss1 * c.ss7;
+    d.si2 = 2.0 * c.ss2 * c.sz12;
+    d.si3 = 2.0 * c.ss2 * (c.sz13 - c.sz11);
+    d.sl2 = -2.0 * c.ss3 * c.sz2;
+    d.sl3 = -2.0 * c.ss3 * (c.sz3 - c.sz1);
+    d.sl4 = -2.0 * c.ss3 * (-21.0 - 9.0 * c.emsq) * zes;
+    d.sgh2 = 2.0 * c.ss4 * c.sz32;
+    d.sgh3 = 2.0 * c.ss4 * (c.sz33 - c.sz31);
+    d.sgh4 = -18.0 * c.ss4 * zes;
+    d.sh2 = -2.0 * c.ss2 * c.sz22;
+    d.sh3 = -2.0 * c.ss2 * (c.sz23 - c.sz21);
+
+    // Lunar periodic coefficients
+    d.ee2 = 2.0 * c.s1 * c.s6;
+    d.e3 = 2.0 * c.s1 * c.s7;
+    d.xi2 = 2.0 * c.s2 * c.z12;
+    d.xi3 = 2.0 * c.s2 * (c.z13 - c.z11);
+    d.xl2 = -2.0 * c.s3 * c.z2;
+    d.xl3 = -2.0 * c.s3 * (c.z3 - c.z1);
+    d.xl4 = -2.0 * c.s3 * (-21.0 - 9.0 * c.emsq) * zel;
+    d.xgh2 = 2.0 * c.s4 * c.z32;
+    d.xgh3 = 2.0 * c.s4 * (c.z33 - c.z31);
+    d.xgh4 = -18.0 * c.s4 * zel;
+    d.xh2 = -2.0 * c.s2 * c.z22;
+    d.xh3 = -2.0 * c.s2 * (c.z23 - c.z21);
+}
+
+// Lunar-solar periodics applied to the mean elements at time t (minutes since epoch)
+static void deepSpacePeriodics(const Sgp4DeepSpace& d, double t, double& ep, double& inclp, double& nodep,
+                               double& argpp, double& mp) {
+    const double zns = 1.19459e-5, zes = 0.01675, znl = 1.5835218e-4, zel = 0.05490;
+
+    double zm = d.zmos + zns * t;
+    double zf = zm + 2.0 * zes * std::sin(zm);
+    double sinzf = std::sin(zf);
+    double f2 = 0.5 * sinzf * sinzf - 0.25;
+    double f3 = -0.5 * sinzf * std::cos(zf);
+    const double ses = d.se2 * f2 + d.se3 * f3;
+    const double sis = d.si2 * f2 + d.si3 * f3;
+    const double sls = d.sl2 * f2 + d.sl3 * f3 + d.sl4 * sinzf;
+    const double sghs = d.sgh2 * f2 + d.sgh3 * f3 + d.sgh4 * sinzf;
+    const double shs = d.sh2 * f2 + d.sh3 * f3;
+
+    zm = d.zmol + znl * t;
+    zf = zm + 2.0 * zel * std::sin(zm);
+    sinzf = std::sin(zf);
+    f2 = 0.5 * sinzf * sinzf - 0.25;
+    f3 = -0.5 * sinzf * std::cos(zf);
+    const double sel = d.ee2 * f2 + d.e3 * f3;
+    const double sil = d.xi2 * f2 + d.xi3 * f3;
+    const double sll = d.xl2 * f2 + d.xl3 * f3 + d.xl4 * sinzf;
+    const double sghl = d.xgh2 * f2 + d.xgh3 * f3 + d.xgh4 * sinzf;
+    const double shll = d.xh2 * f2 + d.xh3 * f3;
+
+    const double pe = ses + sel - d.peo;
+    const double pinc = sis + sil - d.pinco;
+    const double pl = sls + sll - d.plo;
+    double pgh = sghs + sghl - d.pgho;
+    double ph = shs + shll - d.pho;
+
+    inclp += pinc;
+    ep += pe;
+    const double sinip = std::sin(inclp);
+    const double cosip = std::cos(inclp);
+
+    if (inclp >= 0.2) {
+        ph /= sinip;
+        pgh -= cosip * ph;
+        argpp += pgh;
+        nodep += ph;
+        mp += pl;
+    } else {
+        // Lyddane modification for low inclinations
+        const double sinop = std::sin(nodep);
+        const double cosop = std::cos(nodep);
+        double alfdp = sinip * sinop;
+        double betdp = sinip * cosop;
+        const double dalf = ph * cosop + pinc * cosip * sinop;
+        const double dbet = -ph * sinop + pinc * cosip * cosop;
+        alfdp += dalf;
+        betdp += dbet;
+        nodep = std::fmod(nodep, twoPi);
+        double xls = mp + argpp + cosip * nodep;
+        const double dls = pl + pgh - pinc * nodep * sinip;
+        xls += dls;
+        const double xnoh = nodep;
+        nodep = std::atan2(alfdp, betdp);
+        if (std::fabs(xnoh - nodep) > M_PI) {
+            nodep += nodep < xnoh ? twoPi : -twoPi;
+        }
+        mp += pl;
+        argpp = xls - mp - cosip * nodep;
+    }
+}
+
+static const double rptim = 4.37526908801129966e-3; // Earth rotation, rad/min
+
+// Secular lunar-solar rates and geopotential resonance setup
+static void deepSpaceInit(const Sgp4DeepCommon& c, double argpo, double mo, double mdot, double no, double nodeo,
+                          double nodedot, double xpidot, double ecco, double eccsq, double inclm,
+                          Sgp4DeepSpace& d) {
+    const double q22 = 1.7891679e-6, q31 = 2.1460748e-6, q33 = 2.2123015e-7;
+    const double root22 = 1.7891679e-6, root44 = 7.3636953e-9, root54 = 2.1765803e-9;
+    const double root32 = 3.7393792e-7, root52 = 1.1428639e-7;
+    const double znl = 1.5835218e-4, zns = 1.19459e-5;
+
+    const double nm = c.nm;
+    double em = c.em;
+    double emsq = c.emsq;
+    const double sinim = c.sinim, cosim = c.cosim;
+
+    d.irez = 0;
+    if (nm < 0.0052359877 && nm > 0.0034906585) {
+        d.irez = 1; // One-day synchronous
+    }
+    if (nm >= 8.26e-3 && nm <= 9.24e-3 && em >= 0.5) {
+        d.irez = 2; // Half-day (Molniya-type)
+    }
+
+    // Solar secular terms
+    const double ses = c.ss1 * zns * c.ss5;
+    const double sis = c.ss2 * zns * (c.sz11 + c.sz13);
+    const double sls = -zns * c.ss3 * (c.sz1 + c.sz3 - 14.0 - 6.0 * emsq);
+    const double sghs = c.ss4 * zns * (c.sz31 + c.sz33 - 6.0);
+    double shs = -zns * c.ss2 * (c.sz21 + c.sz23);
+    if (inclm < 5.2359877e-2 || inclm > M_PI - 5.2359877e-2) {
+        shs = 0.0;
+    }
+    if (sinim != 0.0) {
+        shs /= sinim;
+    }
+    const double sgs = sghs - cosim * shs;
+
+    // Lunar secular terms
+    d.dedt = ses + c.s1 * znl * c.s5;
+    d.didt = sis + c.s2 * znl * (c.z11 + c.z13);
+    d.dmdt = sls - znl * c.s3 * (c.z1 + c.z3 - 14.0 - 6.0 * emsq);
+    const double sghl = c.s4 * znl * (c.z31 + c.z33 - 6.0);
+    double shll = -znl * c.s2 * (c.z21 + c.z23);
+    if (inclm < 5.2359877e-2 || inclm > M_PI - 5.2359877e-2) {
+        shll = 0.0;
+    }
+    d.domdt = sgs + sghl;
+    d.dnodt = shs;
+    if (sinim != 0.0) {
+        d.domdt -= cosim / sinim * shll;
+        d.dnodt += shll / sinim;
+    }
+
+    const double theta = std::fmod(d.gsto, twoPi);
+    if (d.irez == 0) {
+        return;
+    }
+    const double aonv = std::pow(nm / xke, x2o3);
+
+    if (d.irez == 2) {
+        // Geopotential resonance for 12 hour orbits
+        const double cosisq = cosim * cosim;
+        const double emo = em;
+        em = ecco;
+        const double emsqo = emsq;
+        emsq = eccsq;
+        const double eoc = em * emsq;
+        const double g201 = -0.306 - (em - 0.64) * 0.440;
+        double g211, g310, g322, g410, g422, g520, g521, g532, g533;
+        if (em <= 0.65) {
+            g211 = 3.616 - 13.2470 * em + 16.2900 * emsq;
+            g310 = -19.302 + 117.3900 * em - 228.4190 * emsq + 156.5910 * eoc;
+            g322 = -18.9068 + 109.7927 * em - 214.6334 * emsq + 146.5816 * eoc;
+            g410 = -41.122 + 242.6940 * em - 471.0940 * emsq + 313.9530 * eoc;
+            g422 = -146.407 + 841.8800 * em - 1629.014 * emsq + 1083.4350 * eoc;
+            g520 = -532.114 + 3017.977 * em - 5740.032 * emsq + 3708.2760 * eoc;
+        } else {
+            g211 = -72.099 + 331.819 * em - 508.738 * emsq + 266.724 * eoc;
+            g310 = -346.844 + 1582.851 * em - 2415.925 * emsq + 1246.113 * eoc;
+            g322 = -342.585 + 1554.908 * em - 2366.899 * emsq + 1215.972 * eoc;
+            g410 = -1052.797 + 4758.686 * em - 7193.992 * emsq + 3651.957 * eoc;
+            g422 = -3581.690 + 16178.110 * em - 24462.770 * emsq + 12422.520 * eoc;
+            if (em > 0.715) {
+                g520 = -5149.66 + 29936.92 * em - 54087.36 * emsq + 31324.56 * eoc;
+            } else {
+                g520 = 1464.74 - 4664.75 * em + 3763.64 * emsq;
+            }
+        }
+        if (em < 0.7) {
+            g533 = -919.22770 + 4988.6100 * em - 9064.7700 * emsq + 5542.21 * eoc;
+            g521 = -822.71072 + 4568.6173 * em - 8491.4146 * emsq + 5337.524 * eoc;
+            g532 = -853.66600 + 4690.2500 * em - 8624.7700 * emsq + 5341.4 * eoc;
+        } else {
+            g533 = -37995.780 + 161616.52 * em - 229838.20 * emsq + 109377.94 * eoc;
+            g521 = -51752.104 + 218913.95 * em - 309468.16 * emsq + 146349.42 * eoc;
+            g532 = -40023.880 + 170470.89 * em - 242699.48 * emsq + 115605.82 * eoc;
+        }
+
+        const double sini2 = sinim * sinim;
+        const double f220 = 0.75 * (1.0 + 2.0 * cosim + cosisq);
+        const double f221 = 1.5 * sini2;
+        const double f321 = 1.875 * sinim * (1.0 - 2.0 * cosim - 3.0 * cosisq);
+        const double f322 = -1.875 * sinim * (1.0 + 2.0 * cosim - 3.0 * cosisq);
+        const double f441 = 35.0 * sini2 * f220;
+        const double f442 = 39.3750 * sini2 * sini2;
+        const double f522 = 9.84375 * sinim * (sini2 * (1.0 - 2.0 * cosim - 5.0 * cosisq) +
+                                               0.33333333 * (-2.0 + 4.0 * cosim + 6.0 * cosisq));
+        const double f523 = sinim * (4.92187512 * sini2 * (-2.0 - 4.0 * cosim + 10.0 * cosisq) +
+                                     6.56250012 * (1.0 + 2.0 * cosim - 3.0 * cosisq));
+        const double f542 = 29.53125 * sinim * (2.0 - 8.0 * cosim + cosisq * (-12.0 + 8.0 * cosim + 10.0 * cosisq));
+        const double f543 = 29.53125 * sinim * (-2.0 - 8.0 * cosim + cosisq * (12.0 + 8.0 * cosim - 10.0 * cosisq));
+        const double xno2 = nm * nm;
+        const double ainv2 = aonv * aonv;
+        double temp1 = 3.0 * xno2 * ainv2;
+        double temp = temp1 * root22;
+        d.d2201 = temp * f220 * g201;
+        d.d2211 = temp * f221 * g211;
+        temp1 *= aonv;
+        temp = temp1 * root32;
+        d.d3210 = temp * f321 * g310;
+        d.d3222 = temp * f322 * g322;
+        temp1 *= aonv;
+        temp = 2.0 * temp1 * root44;
+        d.d4410 = temp * f441 * g410;
+        d.d4422 = temp * f442 * g422;
+        temp1 *= aonv;
+        temp = temp1 * root52;
+        d.d5220 = temp * f522 * g520;
+        d.d5232 = temp * f523 * g532;
+        temp = 2.0 * temp1 * root54;
+        d.d5421 = temp * f542 * g521;
+        d.d5433 = temp * f543 * g533;
+        d.xlamo = std::fmod(mo + nodeo + nodeo - theta - theta, twoPi);
+        d.xfact = mdot + d.dmdt + 2.0 * (nodedot + d.dnodt - rptim) - no;
+        em = emo;
+        emsq = emsqo;
+    }
+
+    if (d.irez == 1) {
+        // Synchronous resonance terms
+        const double g200 = 1.0 + emsq * (-2.5 + 0.8125 * emsq);
+        const double g310 = 1.0 + 2.0 * emsq;
+        const double g300 = 1.0 + emsq * (-6.0 + 6.60937 * emsq);
+        const double f220 = 0.75 * (1.0 + cosim) * (1.0 + cosim);
+        const double f311 = 0.9375 * sinim * sinim * (1.0 + 3.0 * cosim) - 0.75 * (1.0 + cosim);
+        double f330 = 1.0 + cosim;
+        f330 = 1.875 * f330 * f330 * f330;
+        d.del1 = 3.0 * nm * nm * aonv * aonv;
+        d.del2 = 2.0 * d.del1 * f220 * g200 * q22;
+        d.del3 = 3.0 * d.del1 * f330 * g300 * q33 * aonv;
+        d.del1 = d.del1 * f311 * g310 * q31 * aonv;
+        d.xlamo = std::fmod(mo + nodeo + argpo - theta, twoPi);
+        d.xfact = mdot + xpidot - rptim + d.dmdt + d.domdt + d.dnodt - no;
+    }
+
+    d.xli = d.xlamo;
+    d.xni = no;
+    d.atime = 0.0;
+}
+
+// Secular lunar-solar drift plus the resonance integration (Euler-Maclaurin, 720 min steps)
+static void deepSpaceSecular(Sgp4DeepSpace& d, double argpo, double argpdot, double t, double no, double& em,
+                             double& argpm, double& inclm, double& mm, double& nodem, double& nm) {
+    const double fasx2 = 0.13130908, fasx4 = 2.8843198, fasx6 = 0.37448087;
+    const double g22 = 5.7686396, g32 = 0.95240898, g44 = 1.8014998, g52 = 1.0508330, g54 = 4.4108898;
+    const double stepp = 720.0, stepn = -720.0, step2 = 259200.0;
+
+    const double theta = std::fmod(d.gsto + t * rptim, twoPi);
+    em += d.dedt * t;
+    inclm += d.didt * t;
+    argpm += d.domdt * t;
+    nodem += d.dnodt * t;
+    mm += d.dmdt * t;
+
+    if (d.irez == 0) {
+        return;
+    }
+    // Restart from epoch unless the cached step lies between epoch and t
+    if (d.atime == 0.0 || t * d.atime <= 0.0 || std::fabs(t) < std::fabs(d.atime)) {
+        d.atime = 0.0;
+        d.xni = no;
+        d.xli = d.xlamo;
+    }
+    const double delt = t > 0.0 ? stepp : stepn;
+    double xndt = 0.0, xldot = 0.0, xnddt = 0.0, ft = 0.0;
+    for (;;) {
+        if (d.irez != 2) {
+            xndt = d.del1 * std::sin(d.xli - fasx2) + d.del2 * std::sin(2.0 * (d.xli - fasx4)) +
+                   d.del3 * std::sin(3.0 * (d.xli - fasx6));
+            xldot = d.xni + d.xfact;
+            xnddt = d.del1 * std::cos(d.xli - fasx2) + 2.0 * d.del2 * std::cos(2.0 * (d.xli - fasx4)) +
+                    3.0 * d.del3 * std::cos(3.0 * (d.xli - fasx6));
+            xnddt *= xldot;
+        } else {
+            const double xomi = argpo + argpdot * d.atime;
+            const double x2omi = xomi + xomi;
+            const double x2li = d.xli + d.xli;
+            xndt = d.d2201 * std::sin(x2omi + d.xli - g22) + d.d2211 * std::sin(d.xli - g22) +
+                   d.d3210 * std::sin(xomi + d.xli - g32) + d.d3222 * std::sin(-xomi + d.xli - g32) +
+                   d.d4410 * std::sin(x2omi + x2li - g44) + d.d4422 * std::sin(x2li - g44) +
+                   d.d5220 * std::sin(xomi + d.xli - g52) + d.d5232 * std::sin(-xomi + d.xli - g52) +
+                   d.d5421 * std::sin(xomi + x2li - g54) + d.d5433 * std::sin(-xomi + x2li - g54);
+            xldot = d.xni + d.xfact;
+            xnddt = d.d2201 * std::cos(x2omi + d.xli - g22) + d.d2211 * std::cos(d.xli - g22) +
+                    d.d3210 * std::cos(xomi + d.xli - g32) + d.d3222 * std::cos(-xomi + d.xli - g32) +
+                    d.d5220 * std::cos(xomi + d.xli - g52) + d.d5232 * std::cos(-xomi + d.xli - g52) +
+                    2.0 * (d.d4410 * std::cos(x2omi + x2li - g44) + d.d4422 * std::cos(x2li - g44) +
+                           d.d5421 * std::cos(xomi + x2li - g54) + d.d5433 * std::cos(-xomi + x2li - g54));
+            xnddt *= xldot;
+        }
+        if (std::fabs(t - d.atime) < stepp) {
+            ft = t - d.atime;
+            break;
+        }
+        d.xli += xldot * delt + xndt * step2;
+        d.xni += xndt * delt + xnddt * step2;
+        d.atime += delt;
+    }
+
+    nm = d.xni + xndt * ft + xnddt * ft * ft * 0.5;
+    const double xl = d.xli + xldot * ft + xndt * ft * ft * 0.5;
+    if (d.irez != 1) {
+        mm = xl - 2.0 * nodem + 2.0 * theta;
+    } else {
+        mm = xl - nodem - argpm + theta;
+    }
+}
+
+bool Sgp4Catalog::add(const TleElements& tle) {
+    const double epoch = tle.epochJd - 2433281.5; // Days since 1949 December 31 00:00 UT
+    const double e0 = tle.eccentricity;
+    const double i0 = tle.inclination;
+    const double temp4 = 1.5e-12;
+
+    // Recover the original (Brouwer) mean motion from the Kozai value
+    const double eccsq = e0 * e0;
+    const double omeosq = 1.0 - eccsq;
+    const double rteosq = std::sqrt(omeosq);
+    const double cosio = std::cos(i0);
+    const double cosio2 = cosio * cosio;
+    const double ak = std::pow(xke / tle.meanMotion, x2o3);
+    const double d1 = 0.75 * j2 * (3.0 * cosio2 - 1.0) / (rteosq * omeosq);
+    double del = d1 / (ak * ak);
+    const double adel = ak * (1.0 - del * del - del * (1.0 / 3.0 + 134.0 * del * del / 81.0));
+    del = d1 / (adel * adel);
+    const double n0 = tle.meanMotion / (1.0 + del);
+    if (!(omeosq > 0.0) || !(n0 > 0.0)) {
+        return false;
+    }
+
+    const double ao = std::pow(xke / n0, x2o3);
+    const double sinio = std::sin(i0);
+    const double po = ao * omeosq;
+    const double con42 = 1.0 - 5.0 * cosio2;
+    const double c41 = -con42 - cosio2 - cosio2;
+    const double posq = po * po;
+    const double rp = ao * (1.0 - e0);
+
+    std::uint8_t simple = rp < (220.0 / sgp4EarthRadiusKm + 1.0) ? 1 : 0;
+
+    // Atmospheric density parameters, adjusted for perigees below 156 km
+    double sfour = 78.0 / sgp4EarthRadiusKm + 1.0;
+    double qzms24 = std::pow((120.0 - 78.0) / sgp4EarthRadiusKm, 4.0);
+    const double perige = (rp - 1.0) * sgp4EarthRadiusKm;
+    if (perige < 156.0) {
+        sfour = perige < 98.0 ? 20.0 : perige - 78.0;
+        qzms24 = std::pow((120.0 - sfour) / sgp4EarthRadiusKm, 4.0);
+        sfour = sfour / sgp4EarthRadiusKm + 1.0;
+    }
+    const double pinvsq = 1.0 / posq;
+    const double tsi = 1.0 / (ao - sfour);
+    const double etaV = ao * e0 * tsi;
+    const double etasq = etaV * etaV;
+    const double eeta = e0 * etaV;
+    const double psisq = std::fabs(1.0 - etasq);
+    const double coef = qzms24 * std::pow(tsi, 4.0);
+    const double coef1 = coef / std::pow(psisq, 3.5);
+    const double cc2 = coef1 * n0 * (ao * (1.0 + 1.5 * etasq + eeta * (4.0 + etasq)) +
+                                     0.375 * j2 * tsi / psisq * c41 * (8.0 + 3.0 * etasq * (8.0 + etasq)));
+    const double c1 = tle.bstar * cc2;
+    double cc3 = 0.0;
+    if (e0 > 1.0e-4) {
+        cc3 = -2.0 * coef * tsi * j3oj2 * n0 * sinio / e0;
+    }
+    const double x1m = 1.0 - cosio2;
+    const double c4 = 2.0 * n0 * coef1 * ao * omeosq *
+                      (etaV * (2.0 + 0.5 * etasq) + e0 * (0.5 + 2.0 * etasq) -
+                       j2 * tsi / (ao * psisq) *
+                           (-3.0 * c41 * (1.0 - 2.0 * eeta + etasq * (1.5 - 0.5 * eeta)) +
+                            0.75 * x1m * (2.0 * etasq - eeta * (1.0 + etasq)) * std::cos(2.0 * tle.argPerigee)));
+    const double c5 = 2.0 * coef1 * ao * omeosq * (1.0 + 2.75 * (etasq + eeta) + eeta * etasq);
+    const double cosio4 = cosio2 * cosio2;
+    const double temp1 = 1.5 * j2 * pinvsq * n0;
+    const double temp2 = 0.5 * temp1 * j2 * pinvsq;
+    const double temp3 = -0.46875 * j4 * pinvsq * pinvsq * n0;
+    const double md = n0 + 0.5 * temp1 * rteosq * c41 + 0.0625 * temp2 * rteosq * (13.0 - 78.0 * cosio2 + 137.0 * cosio4);
+    const double ad = -0.5 * temp1 * con42 + 0.0625 * temp2 * (7.0 - 114.0 * cosio2 + 395.0 * cosio4) +
+                      temp3 * (3.0 - 36.0 * cosio2 + 49.0 * cosio4);
+    const double xhdot1 = -temp1 * cosio;
+    const double nd = xhdot1 + (0.5 * temp2 * (4.0 - 19.0 * cosio2) + 2.0 * temp3 * (3.0 - 7.0 * cosio2)) * cosio;
+    const double xpidot = ad + nd;
+    const double delmotemp = 1.0 + etaV * std::cos(tle.meanAnomaly);
+
+    const size_t index = epochJd.size();
+    names.push_back(tle.name);
+    epochJd.push_back(tle.epochJd);
+    bstar.push_back(tle.bstar);
+    ecco.push_back(e0);
+    argpo.push_back(tle.argPerigee);
+    inclo.push_back(i0);
+    mo.push_back(tle.meanAnomaly);
+    no.push_back(n0);
+    nodeo.push_back(tle.raan);
+    mdot.push_back(md);
+    argpdot.push_back(ad);
+    nodedot.push_back(nd);
+    nodecf.push_back(3.5 * omeosq * xhdot1 * c1);
+    cc1.push_back(c1);
+    cc4.push_back(c4);
+    cc5.push_back(c5);
+    t2cof.push_back(1.5 * c1);
+    delmo.push_back(delmotemp * delmotemp * delmotemp);
+    eta.push_back(etaV);
+    omgcof.push_back(tle.bstar * cc3 * std::cos(tle.argPerigee));
+    sinmao.push_back(std::sin(tle.meanAnomaly));
+    xmcof.push_back(e0 > 1.0e-4 ? -x2o3 * coef * tle.bstar / eeta : 0.0);
+    xlcof.push_back(-0.25 * j3oj2 * sinio * (3.0 + 5.0 * cosio) /
+                    (std::fabs(cosio + 1.0) > 1.5e-12 ? 1.0 + cosio : temp4));
+    aycof.push_back(-0.5 * j3oj2 * sinio);
+    con41.push_back(c41);
+    x1mth2.push_back(x1m);
+    x7thm1.push_back(7.0 * cosio2 - 1.0);
+
+    if (twoPi / n0 >= 225.0) {
+        // Deep-space (SDP4) initialisation
+        simple = 1;
+        Sgp4DeepSpace d{};
+        d.gsto = greenwichSiderealTime(tle.epochJd);
+        Sgp4DeepCommon c{};
+        deepSpaceCommon(epoch, e0, tle.argPerigee, 0.0, i0, tle.raan, n0, c, d);
+        deepSpaceInit(c, tle.argPerigee, tle.meanAnomaly, md, n0, tle.raan, nd, xpidot, e0, eccsq, i0, d);
+        deepIndex.push_back(int(deep.size()));
+        deep.push_back(d);
+        deepList.push_back(index);
+    } else {
+        deepIndex.push_back(-1);
+        nearList.push_back(index);
+    }
+    isimp.push_back(simple);
+
+    double dd2 = 0.0, dd3 = 0.0, dd4 = 0.0, t3 = 0.0, t4 = 0.0, t5 = 0.0;
+    if (!simple) {
+        const double cc1sq = c1 * c1;
+        dd2 = 4.0 * ao * tsi * cc1sq;
+        const double temp = dd2 * tsi * c1 / 3.0;
+        dd3 = (17.0 * ao + sfour) * temp;
+        dd4 = 0.5 * temp * ao * tsi * (221.0 * ao + 31.0 * sfour) * c1;
+        t3 = dd2 + 2.0 * cc1sq;
+        t4 = 0.25 * (3.0 * dd3 + c1 * (12.0 * dd2 + 10.0 * cc1sq));
+        t5 = 0.2 * (3.0 * dd4 + 12.0 * c1 * dd3 + 6.0 * dd2 * dd2 + 15.0 * cc1sq * (2.0 * dd2 + cc1sq));
+    }
+    d2.push_back(dd2);
+    d3.push_back(dd3);
+    d4.push_back(dd4);
+    t3cof.push_back(t3);
+    t4cof.push_back(t4);
+    t5cof.push_back(t5);
+    return true;
+}
+
+template <bool Deep>
+std::uint8_t Sgp4Catalog::propagateOne(size_t i, double t, Sgp4DeepSpace* d, double r[3], double v[3]) const {
+    // Secular gravity and atmospheric drag
+    const double xmdf = mo[i] + mdot[i] * t;
+    const double argpdf = argpo[i] + argpdot[i] * t;
+    const double nodedf = nodeo[i] + nodedot[i] * t;
+    double argpm = argpdf;
+    double mm = xmdf;
+    const double t2 = t * t;
+    double nodem = nodedf + nodecf[i] * t2;
+    double tempa = 1.0 - cc1[i] * t;
+    double tempe = bstar[i] * cc4[i] * t;
+    double templ = t2cof[i] * t2;
+    if (!isimp[i]) {
+        const double delomg = omgcof[i] * t;
+        const double delmtemp = 1.0 + eta[i] * std::cos(xmdf);
+        const double delm = xmcof[i] * (delmtemp * delmtemp * delmtemp - delmo[i]);
+        const double temp = delomg + delm;
+        mm = xmdf + temp;
+        argpm = argpdf - temp;
+        const double t3 = t2 * t;
+        const double t4 = t3 * t;
+        tempa = tempa - d2[i] * t2 - d3[i] * t3 - d4[i] * t4;
+        tempe = tempe + bstar[i] * cc5[i] * (std::sin(mm) - sinmao[i]);
+        templ = templ + t3cof[i] * t3 + t4 * (t4cof[i] + t * t5cof[i]);
+    }
+
+    double nm = no[i];
+    double em = ecco[i];
+    double inclm = inclo[i];
+    if (Deep) {
+        deepSpaceSecular(*d, argpo[i], argpdot[i], t, no[i], em, argpm, inclm, mm, nodem, nm);
+    }
+    if (nm <= 0.0) {
+        return Sgp4BadMeanMotion;
+    }
+    const double am = std::pow(xke / nm, x2o3) * tempa * tempa;
+    nm = xke / std::pow(am, 1.5);
+    em -= tempe;
+    if (em >= 1.0 || em < -0.001) {
+        return Sgp4BadEccentricity;
+    }
+    if (em < 1.0e-6) {
+        em = 1.0e-6;
+    }
+    mm += no[i] * templ;
+    double xlm = mm + argpm + nodem;
+    nodem = std::fmod(nodem, twoPi);
+    argpm = std::fmod(argpm, twoPi);
+    xlm = std::fmod(xlm, twoPi);
+    mm = std::fmod(xlm - argpm - nodem, twoPi);
+
+    // Lunar-solar periodics
+    double ep = em, xincp = inclm, argpp = argpm, nodep = nodem, mp = mm;
+    double sinip = std::sin(inclm), cosip = std::cos(inclm);
+    double aycofV = aycof[i], xlcofV = xlcof[i];
+    double con41V = con41[i], x1mth2V = x1mth2[i], x7thm1V = x7thm1[i];
+    if (Deep) {
+        deepSpacePeriodics(*d, t, ep, xincp, nodep, argpp, mp);
+        if (xincp < 0.0) {
+            xincp = -xincp;
+            nodep += M_PI;
+            argpp -= M_PI;
+        }
+        if (ep < 0.0 || ep > 1.0) {
+            return Sgp4BadPerturbedEccentricity;
+        }
+        sinip = std::sin(xincp);
+        cosip = std::cos(xincp);
+        aycofV = -0.5 * j3oj2 * sinip;
+        xlcofV = -0.25 * j3oj2 * sinip * (3.0 + 5.0 * cosip) / (std::fabs(cosip + 1.0) > 1.5e-12 ? 1.0 + cosip : 1.5e-12);
+        const double cosisq = cosip * cosip;
+        con41V = 3.0 * cosisq - 1.0;
+        x1mth2V = 1.0 - cosisq;
+        x7thm1V = 7.0 * cosisq - 1.0;
+    }
+
+    // Long-period periodics
+    const double axnl = ep * std::cos(argpp);
+    double temp = 1.0 / (am * (1.0 - ep * ep));
+    const double aynl = ep * std::sin(argpp) + temp * aycofV;
+    const double xl = mp + argpp + nodep + temp * xlcofV * axnl;
+
+    // Kepler's equation in the equinoctial-like variables
+    const double u = std::fmod(xl - nodep, twoPi);
+    double eo1 = u, tem5 = 9999.9, sineo1 = 0.0, coseo1 = 0.0;
+    for (int ktr = 0; std::fabs(tem5) >= 1.0e-12 && ktr < 10; ++ktr) {
+        sineo1 = std::sin(eo1);
+        coseo1 = std::cos(eo1);
+        tem5 = 1.0 - coseo1 * axnl - sineo1 * aynl;
+        tem5 = (u - aynl * coseo1 + axnl * sineo1 - eo1) / tem5;
+        if (std::fabs(tem5) >= 0.95) {
+            tem5 = tem5 > 0.0 ? 0.95 : -0.95;
+        }
+        eo1 += tem5;
+    }
+
+    // Short-period preliminary quantities
+    const double ecose = axnl * coseo1 + aynl * sineo1;
+    const double esine = axnl * sineo1 - aynl * coseo1;
+    const double el2 = axnl * axnl + aynl * aynl;
+    const double pl = am * (1.0 - el2);
+    if (pl < 0.0) {
+        return Sgp4BadSemiLatusRectum;
+    }
+    const double rl = am * (1.0 - ecose);
+    const double rdotl = std::sqrt(am) * esine / rl;
+    const double rvdotl = std::sqrt(pl) / rl;
+    const double betal = std::sqrt(1.0 - el2);
+    temp = esine / (1.0 + betal);
+    const double sinu = am / rl * (sineo1 - aynl - axnl * temp);
+    const double cosu = am / rl * (coseo1 - axnl + aynl * temp);
+    double su = std::atan2(sinu, cosu);
+    const double sin2u = (cosu + cosu) * sinu;
+    const double cos2u = 1.0 - 2.0 * sinu * sinu;
+    temp = 1.0 / pl;
+    const double temp1 = 0.5 * j2 * temp;
+    const double temp2 = temp1 * temp;
+
+    // Short-period periodics
+    const double mrt = rl * (1.0 - 1.5 * temp2 * betal * con41V) + 0.5 * temp1 * x1mth2V * cos2u;
+    su -= 0.25 * temp2 * x7thm1V * sin2u;
+    const double xnode = nodep + 1.5 * temp2 * cosip * sin2u;
+    const double xinc = xincp + 1.5 * temp2 * cosip * sinip * cos2u;
+    const double mvt = rdotl - nm * temp1 * x1mth2V * sin2u / xke;
+    const double rvdot = rvdotl + nm * temp1 * (x1mth2V * cos2u + 1.5 * con41V) / xke;
+
+    // Orientation vectors
+    const double sinsu = std::sin(su), cossu = std::cos(su);
+    const double snod = std::sin(xnode), cnod = std::cos(xnode);
+    const double sini = std::sin(xinc), cosi = std::cos(xinc);
+    const double xmx = -snod * cosi;
+    const double xmy = cnod * cosi;
+    const double ux = xmx * sinsu + cnod * cossu;
+    const double uy = xmy * sinsu + snod * cossu;
+    const double uz = sini * sinsu;
+    const double vxu = xmx * cossu - cnod * sinsu;
+    const double vyu = xmy * cossu - snod * sinsu;
+    const double vzu = sini * cossu;
+
+    r[0] = mrt * ux * sgp4EarthRadiusKm;
+    r[1] = mrt * uy * sgp4EarthRadiusKm;
+    r[2] = mrt * uz * sgp4EarthRadiusKm;
+    v[0] = (mvt * ux + rvdot * vxu) * velocityKmPerSec;
+    v[1] = (mvt * uy + rvdot * vyu) * velocityKmPerSec;
+    v[2] = (mvt * uz + rvdot * vzu) * velocityKmPerSec;
+    return mrt < 1.0 ? Sgp4Decayed : Sgp4Ok;
+}
+
+std::uint8_t Sgp4Catalog::propagateSatellite(size_t i, double jd, double r[3], double v[3]) const {
+    const double tsince = (jd - epochJd[i]) * 1440.0;
+    if (deepIndex[i] < 0) {
+        return propagateOne<false>(i, tsince, nullptr, r, v);
+    }
+    // Private copy of the resonance state so concurrent callers never share it
+    Sgp4DeepSpace d = deep[deepIndex[i]];
+    return propagateOne<true>(i, tsince, &d, r, v);
+}
+
+void Sgp4Catalog::radiusRange(size_t i, double& perigeeKm, double& apogeeKm) const {
+    const double a = std::pow(xke / no[i], x2o3) * sgp4EarthRadiusKm;
+    perigeeKm = a * (1.0 - ecco[i]);
+    apogeeKm = a * (1.0 + ecco[i]);
+}
+
+static size_t sgp4ChunksFor(size_t count) {
+    return (count + Sgp4Catalog::chunkSize - 1) / Sgp4Catalog::chunkSize;
+}
+
+size_t Sgp4Catalog::chunkCount() const {
+    return sgp4ChunksFor(nearList.size()) + sgp4ChunksFor(deepList.size());
+}
+
+size_t Sgp4Catalog::propagateChunk(size_t chunk, double jd, double* x, double* y, double* z, double* vx, double* vy,
+                                   double* vz, std::uint8_t* errors) {
+    const size_t nearChunks = sgp4ChunksFor(nearList.size());
+    const bool isDeep = chunk >= nearChunks;
+    const std::vector<size_t>& list = isDeep ? deepList : nearList;
+    const size_t begin = (isDeep ? chunk - nearChunks : chunk) * chunkSize;
+    const size_t end = std::min(begin + chunkSize, list.size());
+    size_t ok = 0;
+    for (size_t k = begin; k < end; ++k) {
+        const size_t i = list[k];
+        const double tsince = (jd - epochJd[i]) * 1440.0;
+        double r[3], v[3];
+        std::uint8_t status = isDeep ? propagateOne<true>(i, tsince, &deep[deepIndex[i]], r, v)
+                                     : propagateOne<false>(i, tsince, nullptr, r, v);
+        if (status != Sgp4Ok) {
+            r[0] = r[1] = r[2] = v[0] = v[1] = v[2] = 0.0;
+        } else {
+            ++ok;
+        }
+        x[i] = r[0]; y[i] = r[1]; z[i] = r[2];
+        vx[i] = v[0]; vy[i] = v[1]; vz[i] = v[2];
+        if (errors) {
+            errors[i] = status;
+        }
+    }
+    return ok;
+}
+
+size_t Sgp4Catalog::propagate(double jd, double* x, double* y, double* z, double* vx, double* vy, double* vz,
+                              std::uint8_t* errors) {
+    size_t ok = 0;
+    const size_t chunks = chunkCount();
+    for (size_t c = 0; c < chunks; ++c) {
+        ok += propagateChunk(c, jd, x, y, z, vx, vy, vz, errors);
+    }
+    return ok;
+}
+
+size_t Sgp4Catalog::propagateParallel(double jd, double* x, double* y, double* z, double* vx, double* vy, double* vz,
+                                      std::uint8_t* errors) {
+    const size_t chunks = chunkCount();
+    std::atomic<size_t> ok{0};
+    // One chunk per task; deep-space chunks cost more and are balanced by stealing
+    TaskScheduler::instance().parallelFor(0, chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            ok += propagateChunk(c, jd, x, y, z, vx, vy, vz, errors);
+        }
+    });
+    return ok;
+}
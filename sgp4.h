@@ -0,0 +1,110 @@
+#ifndef SGP4_H
+#define SGP4_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// WGS-72 constants used by SGP4
+const double sgp4EarthRadiusKm = 6378.135;
+const double sgp4Mu = 398600.8; // km^3 / s^2
+
+// Julian date from a calendar date (UT)
+double julianDate(int year, int month, int day, int hour, int minute, double second);
+// Greenwich mean sidereal time in radians (IAU-82)
+double greenwichSiderealTime(double jdUt1);
+
+// Mean elements of one two-line element set, already converted to radians and rad/min
+struct TleElements {
+    std::string name;
+    int satelliteNumber = 0;
+    double epochJd = 0.0;
+    double bstar = 0.0;
+    double ndot = 0.0;
+    double nddot = 0.0;
+    double inclination = 0.0;
+    double raan = 0.0;
+    double eccentricity = 0.0;
+    double argPerigee = 0.0;
+    double meanAnomaly = 0.0;
+    double meanMotion = 0.0; // Kozai mean motion, rad/min
+};
+
+// Parse one TLE; line0 may be empty for two-line files without names
+bool parseTle(const std::string& line0, const std::string& line1, const std::string& line2, TleElements& tle);
+
+// Error codes reported per satellite by propagate()
+enum Sgp4Error : std::uint8_t {
+    Sgp4Ok = 0,
+    Sgp4BadEccentricity = 1,
+    Sgp4BadMeanMotion = 2,
+    Sgp4BadPerturbedEccentricity = 3,
+    Sgp4BadSemiLatusRectum = 4,
+    Sgp4Decayed = 6
+};
+
+// Deep-space (SDP4) constants of one satellite. The resonance integrator keeps its
+// last step (atime, xli, xni) so scrubbing near a previous time stays cheap.
+struct Sgp4DeepSpace {
+    int irez = 0;
+    double gsto = 0.0;
+    double e3, ee2, peo, pgho, pho, pinco, plo, se2, se3, sgh2, sgh3, sgh4, sh2, sh3, si2, si3, sl2, sl3, sl4;
+    double xgh2, xgh3, xgh4, xh2, xh3, xi2, xi3, xl2, xl3, xl4, zmol, zmos;
+    double d2201, d2211, d3210, d3222, d4410, d4422, d5220, d5232, d5421, d5433;
+    double dedt, didt, dmdt, dnodt, domdt, del1, del2, del3, xfact, xlamo;
+    double atime = 0.0, xli = 0.0, xni = 0.0;
+};
+
+// Catalog of satellites propagated with SGP4/SDP4 (Vallado et al. 2006 revision).
+// Per-satellite constants are computed once when the catalog is loaded and stored
+// one array per field; evaluating at a new time is then only the time-dependent part.
+// Satellites are grouped into near-earth and deep-space lists so the near-earth
+// loop carries no deep-space branches.
+class Sgp4Catalog {
+public:
+    static constexpr size_t chunkSize = 512;
+
+    bool loadTleFile(const char* path);
+    // Initialise one satellite; returns false if its elements are unusable
+    bool add(const TleElements& tle);
+
+    size_t size() const { return epochJd.size(); }
+    const std::string& name(size_t i) const { return names[i]; }
+    double latestEpoch() const;
+
+    // Position (km) and velocity (km/s) in the TEME frame at Julian date jd, written at
+    // each satellite's index. Returns the number of satellites that propagated cleanly.
+    size_t propagate(double jd, double* x, double* y, double* z, double* vx, double* vy, double* vz,
+                     std::uint8_t* errors);
+    // Same, with the chunks spread over the shared task scheduler
+    size_t propagateParallel(double jd, double* x, double* y, double* z, double* vx, double* vy, double* vz,
+                             std::uint8_t* errors);
+
+    // One satellite at an arbitrary time; safe to call from several threads at once
+    std::uint8_t propagateSatellite(size_t i, double jd, double r[3], double v[3]) const;
+    // Perigee and apogee radius (km) of the mean orbit at epoch
+    void radiusRange(size_t i, double& perigeeKm, double& apogeeKm) const;
+
+    // Independent work slices; different chunks never touch the same satellite
+    size_t chunkCount() const;
+    size_t propagateChunk(size_t chunk, double jd, double* x, double* y, double* z, double* vx, double* vy,
+                          double* vz, std::uint8_t* errors);
+
+private:
+    std::vector<std::string> names;
+    // Mean elements at epoch
+    std::vector<double> epochJd, bstar, ecco, argpo, inclo, mo, no, nodeo;
+    // Secular rates and drag coefficients
+    std::vector<double> mdot, argpdot, nodedot, nodecf, cc1, cc4, cc5, t2cof, t3cof, t4cof, t5cof;
+    std::vector<double> d2, d3, d4, delmo, eta, omgcof, sinmao, xmcof, xlcof, aycof, con41, x1mth2, x7thm1;
+    std::vector<std::uint8_t> isimp;
+    std::vector<int> deepIndex; // Index into deep, or -1
+    std::vector<Sgp4DeepSpace> deep;
+    std::vector<size_t> nearList, deepList;
+
+    template <bool Deep>
+    std::uint8_t propagateOne(size_t i, double tsince, Sgp4DeepSpace* d, double r[3], double v[3]) const;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "shader.h"
+#include <iostream>
+#include <string>
+
+GLuint compileShader(GLenum type, const char* source, const char* defines) {
+    std::string text(source);
+    if (defines && *defines) {
+        size_t versionEnd = text.find('\n', text.find("#version"));
+        text.insert(versionEnd + 1, defines);
+    }
+    const char* fullSource = text.c_str();
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &fullSource, NULL);
+    glCompileShader(shader);
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        GLchar infoLog[512];
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cerr << "Shader compilation failed: " << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Link compiled shaders, capturing varyings with transform feedback when given, and
+// delete the shaders
+static GLuint linkProgram(const GLuint* shaders, int count, const char* const* varyings = nullptr,
+                          GLsizei varyingCount = 0) {
+    bool compiled = true;
+    for (int i = 0; i < count; ++i) {
+        compiled = compiled && shaders[i] != 0;
+    }
+    GLuint program = 0;
+    if (compiled) {
+        program = glCreateProgram();
+        for (int i = 0; i < count; ++i) {
+            glAttachShader(program, shaders[i]);
+        }
+        if (varyingCount > 0) {
+            glTransformFeedbackVaryings(program, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+        }
+        glLinkProgram(program);
+    }
+    for (int i = 0; i < count; ++i) {
+        if (shaders[i]) {
+            glDeleteShader(shaders[i]);
+        }
+    }
+    if (!program) {
+        return 0;
+    }
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        GLchar infoLog[512];
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cerr << "Program linking failed: " << infoLog << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+GLuint createProgram(const char* vertexSource, const char* fragmentSource, const char* defines) {
+    const GLuint shaders[] = {compileShader(GL_VERTEX_SHADER, vertexSource, defines),
+                              compileShader(GL_FRAGMENT_SHADER, fragmentSource, defines)};
+    return linkProgram(shaders, 2);
+}
+
+GLuint createComputeProgram(const char* source, const char* defines) {
+    const GLuint shader = compileShader(GL_COMPUTE_SHADER, source, defines);
+    return linkProgram(&shader, 1);
+}
+
+GLuint createTransformFeedbackProgram(const char* vertexSource, const char* const* varyings, GLsizei varyingCount,
+                                      const char* defines) {
+    const GLuint shader = compileShader(GL_VERTEX_SHADER, vertexSource, defines);
+    return linkProgram(&shader, 1, varyings, varyingCount);
+}
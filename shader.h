@@ -0,0 +1,20 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <GL/glew.h>
+
+// Shader compilation and program linking shared by the renderer and the GPU passes.
+// defines is inserted after a source's #version line. Failures print the info log to
+// std::cerr and return 0, with nothing left allocated.
+
+GLuint compileShader(GLenum type, const char* source, const char* defines = "");
+// Link a vertex/fragment shader pair into a program
+GLuint createProgram(const char* vertexSource, const char* fragmentSource, const char* defines = "");
+// A program of one compute shader (GL 4.3)
+GLuint createComputeProgram(const char* source, const char* defines = "");
+// A vertex-only program whose outputs are captured by transform feedback, interleaved
+// in the order of varyings
+GLuint createTransformFeedbackProgram(const char* vertexSource, const char* const* varyings, GLsizei varyingCount,
+                                      const char* defines = "");
+
+#endif
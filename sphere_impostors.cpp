@@ -0,0 +1,89 @@
+#include "sphere_impostors.h"
+#include "stream_buffer.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// Centre and radius, colour and texture weight, spin from the instances at offset in
+// buffer; the quad corner comes from gl_VertexID
+static void pointAttributes(GLuint vao, GLuint buffer, GLintptr offset) {
+    const GLsizei stride = sizeof(SphereImpostor);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(SphereImpostor, center)));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(SphereImpostor, color)));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(SphereImpostor, spin)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool SphereImpostors::init(size_t capacity) {
+    destroy();
+    if (capacity == 0) {
+        return false;
+    }
+    maxSpheres = capacity;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, maxSpheres * sizeof(SphereImpostor), NULL, GL_DYNAMIC_DRAW);
+    glBindVertexArray(vao);
+    for (GLuint attribute = 0; attribute < 3; ++attribute) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+    pointAttributes(vao, buffer, 0);
+    glBindVertexArray(0);
+    source = buffer;
+    return true;
+}
+
+void SphereImpostors::destroy() {
+    if (vao) {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &buffer);
+        vao = buffer = source = 0;
+    }
+    spheres = maxSpheres = 0;
+}
+
+void SphereImpostors::update(const SphereImpostor* impostors, size_t count) {
+    spheres = std::min(count, maxSpheres);
+    if (spheres == 0) {
+        return;
+    }
+    if (source != buffer) {
+        pointAttributes(vao, buffer, 0);
+        glBindVertexArray(0);
+        source = buffer;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, spheres * sizeof(SphereImpostor), impostors);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SphereImpostors::update(StreamBuffer& stream, const SphereImpostor* impostors, size_t count) {
+    spheres = std::min(count, maxSpheres);
+    if (spheres == 0) {
+        return;
+    }
+    GLintptr offset;
+    void* slice = stream.allocate(spheres * sizeof(SphereImpostor), sizeof(SphereImpostor), offset);
+    if (!slice) {
+        spheres = 0;
+        return;
+    }
+    std::memcpy(slice, impostors, spheres * sizeof(SphereImpostor));
+    pointAttributes(vao, stream.buffer(), offset);
+    glBindVertexArray(0);
+    source = stream.buffer();
+}
+
+void SphereImpostors::draw(GLuint program) const {
+    if (spheres == 0) {
+        return;
+    }
+    glUseProgram(program);
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(spheres));
+    glBindVertexArray(0);
+}
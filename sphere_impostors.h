@@ -0,0 +1,57 @@
+#ifndef SPHERE_IMPOSTORS_H
+#define SPHERE_IMPOSTORS_H
+
+#include <GL/glew.h>
+#include <cstddef>
+
+class StreamBuffer;
+
+// One sphere to draw as an impostor. The centre is camera-relative in the scene frame,
+// so it stays precise however far away the body is; spin turns the body about the
+// scene's y axis, as the Earth's model matrix does.
+struct SphereImpostor {
+    float center[3];
+    float radius;
+    float color[3];
+    float textureWeight; // 0 for flat colour, 1 to multiply by the bound texture
+    float spin;
+};
+
+// Spheres drawn as screen-facing quads that the fragment shader ray-traces.
+//
+// Each instance expands to a quad through the sphere's centre, sized to the cone of
+// sight lines grazing the sphere so it covers exactly the silhouette. Every fragment
+// intersects its sight line with the sphere in coordinates relative to the centre,
+// which keeps the solve well conditioned at any distance, writes the hit point's depth
+// and takes texture coordinates from the hit normal with the same mapping as the
+// tessellated sphere. Silhouettes are exact per pixel, and every sphere goes through
+// one instanced draw regardless of its size on screen. Spheres containing the camera
+// are skipped.
+class SphereImpostors {
+public:
+    SphereImpostors() = default;
+    SphereImpostors(const SphereImpostors&) = delete;
+    SphereImpostors& operator=(const SphereImpostors&) = delete;
+    ~SphereImpostors() { destroy(); }
+
+    bool init(size_t capacity);
+    void destroy();
+
+    // Replace the spheres to draw; at most capacity are kept
+    void update(const SphereImpostor* impostors, size_t count);
+    // Replace them with a copy in this frame's stream region instead of the own buffer;
+    // none are drawn if the region is full
+    void update(StreamBuffer& stream, const SphereImpostor* impostors, size_t count);
+    // Draw with a program built from the impostor shaders; the caller has bound its View
+    // block and set its texture and depth uniforms
+    void draw(GLuint program) const;
+
+    size_t size() const { return spheres; }
+
+private:
+    GLuint vao = 0, buffer = 0;
+    GLuint source = 0; // Buffer the instance attributes read: the own one or a stream
+    size_t spheres = 0, maxSpheres = 0;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "stream_buffer.h"
+#include <algorithm>
+
+bool StreamBuffer::init(size_t bytesPerFrame) {
+    destroy();
+    if (bytesPerFrame == 0) {
+        return false;
+    }
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformAlignment = size_t(std::max(alignment, 1));
+    // Every region starts on a uniform offset boundary
+    regionBytes = (bytesPerFrame + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+    const GLsizeiptr bytes = GLsizeiptr(regionBytes * regionCount);
+
+    glGenBuffers(1, &storage);
+    glBindBuffer(GL_ARRAY_BUFFER, storage);
+    const bool immutable = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+    if (immutable) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, bytes, NULL, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags));
+    }
+    if (!mapped) {
+        // Plain buffer; immutable storage that failed to map cannot be respecified
+        if (immutable) {
+            glDeleteBuffers(1, &storage);
+            glGenBuffers(1, &storage);
+            glBindBuffer(GL_ARRAY_BUFFER, storage);
+        }
+        glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        staging.resize(size_t(bytes));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    region = -1;
+    used = committed = 0;
+    return true;
+}
+
+void StreamBuffer::destroy() {
+    for (GLsync& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+    if (storage) {
+        if (mapped) {
+            glBindBuffer(GL_ARRAY_BUFFER, storage);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            mapped = nullptr;
+        }
+        glDeleteBuffers(1, &storage);
+        storage = 0;
+    }
+    staging.clear();
+    regionBytes = used = committed = 0;
+    region = -1;
+}
+
+void StreamBuffer::beginFrame() {
+    if (!storage) {
+        return;
+    }
+    // Everything that reads the last frame's region has been issued by now
+    if (mapped && region >= 0) {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    region = (region + 1) % regionCount;
+    used = committed = 0;
+    GLsync& fence = fences[region];
+    if (fence) {
+        if (glClientWaitSync(fence, 0, 0) != GL_ALREADY_SIGNALED) {
+            ++stalls;
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+}
+
+void* StreamBuffer::allocate(size_t bytes, size_t alignment, GLintptr& offset) {
+    if (!storage || region < 0 || alignment == 0) {
+        return nullptr;
+    }
+    const size_t regionStart = size_t(region) * regionBytes;
+    const size_t start = (regionStart + used + alignment - 1) / alignment * alignment;
+    if (start + bytes > regionStart + regionBytes) {
+        return nullptr;
+    }
+    used = start + bytes - regionStart;
+    offset = GLintptr(start);
+    return (mapped ? mapped : staging.data()) + start;
+}
+
+void StreamBuffer::commit() {
+    if (mapped || used == committed) {
+        return;
+    }
+    const size_t regionStart = size_t(region) * regionBytes;
+    glBindBuffer(GL_ARRAY_BUFFER, storage);
+    glBufferSubData(GL_ARRAY_BUFFER, GLintptr(regionStart + committed), GLsizeiptr(used - committed),
+                    staging.data() + regionStart + committed);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    committed = used;
+}
@@ -0,0 +1,64 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// Per-frame dynamic data written straight into memory the GPU reads.
+//
+// One buffer holds three frame-sized regions used in turn, and each frame
+// bump-allocates from its own: vertex and instance data at their stride, uniform
+// block slices at the implementation's offset alignment. With GL 4.4 or
+// ARB_buffer_storage the buffer is immutable storage mapped once, persistent and
+// coherent, so writing data is a plain store into the mapping with no upload call and
+// no copy in the driver. When the next frame begins a fence goes in after the last
+// command that read the region, and the frame that reuses it three frames on waits for
+// that fence; by then it has nearly always signalled. Neither glBufferSubData into a
+// buffer still being drawn nor orphaning with glBufferData is involved, so nothing
+// waits on the driver's implicit synchronization.
+//
+// Without buffer storage each region is staged in memory and commit() sends the
+// frame's writes up in one glBufferSubData, which the rotation keeps clear of regions
+// still being drawn.
+class StreamBuffer {
+public:
+    static const int regionCount = 3;
+
+    long long stalls = 0; // Frames that had to wait for the GPU to release their region
+
+    StreamBuffer() = default;
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+    ~StreamBuffer() { destroy(); }
+
+    bool init(size_t bytesPerFrame);
+    void destroy();
+
+    // Move to the next region, fencing the last frame's and waiting until this one is free
+    void beginFrame();
+    // Reserve bytes in this frame's region at a multiple of alignment from the start of
+    // the buffer (any alignment, so a vertex stride turns offsets into first vertices).
+    // Returns where to write them and sets their offset in buffer(); nullptr when the
+    // region is full.
+    void* allocate(size_t bytes, size_t alignment, GLintptr& offset);
+    // A slice for glBindBufferRange(GL_UNIFORM_BUFFER, ...)
+    void* allocateUniforms(size_t bytes, GLintptr& offset) { return allocate(bytes, uniformAlignment, offset); }
+    // Make the frame's writes so far visible to the GPU; call before drawing with them
+    void commit();
+
+    GLuint buffer() const { return storage; }
+    size_t frameCapacity() const { return regionBytes; }
+    bool persistentlyMapped() const { return mapped != nullptr; }
+
+private:
+    GLuint storage = 0;
+    unsigned char* mapped = nullptr;
+    std::vector<unsigned char> staging; // Without a mapping
+    size_t regionBytes = 0, uniformAlignment = 256;
+    size_t used = 0, committed = 0; // Bytes of the region allocated and sent up
+    int region = -1;                // Before the first frame
+    GLsync fences[regionCount] = {};
+};
+
+#endif
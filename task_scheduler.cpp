@@ -0,0 +1,201 @@
+#include "task_scheduler.h"
+#include <algorithm>
+#include <cstdlib>
+
+// Index of the queue owned by the current thread; threads outside the pool use the shared one
+static thread_local int workerIndex = -1;
+static thread_local const TaskScheduler* workerOwner = nullptr;
+
+static unsigned defaultThreadCount() {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    if (const char* env = std::getenv("TASK_THREADS")) {
+        threads = unsigned(std::max(1, std::atoi(env)));
+    }
+    return threads;
+}
+
+TaskScheduler& TaskScheduler::instance() {
+    static TaskScheduler scheduler(defaultThreadCount() - 1);
+    return scheduler;
+}
+
+unsigned TaskScheduler::currentSlot() const {
+    return workerOwner == this && workerIndex >= 0 ? unsigned(workerIndex) : unsigned(workers.size());
+}
+
+TaskScheduler::TaskScheduler(unsigned threadCount) {
+    for (unsigned i = 0; i <= threadCount; ++i) {
+        queues.emplace_back(new WorkQueue());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+}
+
+TaskHandle TaskScheduler::submit(std::function<void()> work, std::initializer_list<TaskHandle> dependencies) {
+    TaskHandle task = std::make_shared<Task>();
+    task->work = std::move(work);
+    // Hold one extra count so the task cannot start while dependencies are still being registered
+    task->unfinishedDependencies = 1;
+    for (const TaskHandle& dependency : dependencies) {
+        if (!dependency) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(dependency->dependentsMutex);
+        if (!dependency->done) {
+            ++task->unfinishedDependencies;
+            dependency->dependents.push_back(task);
+        }
+    }
+    if (--task->unfinishedDependencies == 0) {
+        schedule(task);
+    }
+    return task;
+}
+
+void TaskScheduler::schedule(const TaskHandle& task) {
+    WorkQueue& queue = *queues[currentSlot()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    ++queuedCount;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+void TaskScheduler::execute(const TaskHandle& task) {
+    task->work();
+    task->work = nullptr;
+    std::vector<TaskHandle> ready;
+    {
+        std::lock_guard<std::mutex> lock(task->dependentsMutex);
+        task->done = true;
+        ready.swap(task->dependents);
+    }
+    for (const TaskHandle& dependent : ready) {
+        if (--dependent->unfinishedDependencies == 0) {
+            schedule(dependent);
+        }
+    }
+}
+
+TaskHandle TaskScheduler::popLocal(unsigned index) {
+    WorkQueue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return nullptr;
+    }
+    TaskHandle task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return task;
+}
+
+TaskHandle TaskScheduler::steal(unsigned thief) {
+    const size_t count = queues.size();
+    for (size_t k = 1; k <= count; ++k) {
+        WorkQueue& queue = *queues[(thief + k) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            TaskHandle task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+// Run one queued task if there is any; own queue first, then steal
+bool TaskScheduler::runOne() {
+    const unsigned index = currentSlot();
+    TaskHandle task = popLocal(index);
+    if (!task) {
+        task = steal(index);
+    }
+    if (!task) {
+        return false;
+    }
+    --queuedCount;
+    execute(task);
+    return true;
+}
+
+void TaskScheduler::workerLoop(unsigned index) {
+    workerIndex = int(index);
+    workerOwner = this;
+    while (!stopping) {
+        if (runOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queuedCount > 0; });
+    }
+}
+
+void TaskScheduler::wait(const TaskHandle& task) {
+    while (!task->done) {
+        if (!runOne()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// State shared by the pieces of one parallelFor. Every queued piece holds a reference,
+// so it outlives the caller's frame, and a piece touches nothing of the caller's after
+// reporting its items done.
+struct ParallelForRange {
+    const std::function<void(size_t, size_t)>* body;
+    size_t grain;
+    std::atomic<size_t> remaining;
+};
+
+static void runRange(TaskScheduler& scheduler, const std::shared_ptr<ParallelForRange>& range, size_t b, size_t e) {
+    while (e - b > range->grain) {
+        const size_t mid = b + (e - b) / 2;
+        scheduler.submit([&scheduler, range, mid, e] { runRange(scheduler, range, mid, e); });
+        e = mid;
+    }
+    (*range->body)(b, e);
+    // Last use of the body; once remaining reaches zero the caller may return
+    range->remaining -= e - b;
+}
+
+void TaskScheduler::parallelFor(size_t first, size_t last, size_t grain,
+                                const std::function<void(size_t, size_t)>& body) {
+    if (last <= first) {
+        return;
+    }
+    const size_t count = last - first;
+    if (grain == 0) {
+        grain = std::max<size_t>(1, count / (4 * size_t(concurrency())));
+    }
+    if (count <= grain || workers.empty()) {
+        body(first, last);
+        return;
+    }
+
+    // Items still to run; the waiting thread returns once every piece has been processed
+    auto range = std::make_shared<ParallelForRange>();
+    range->body = &body;
+    range->grain = grain;
+    range->remaining = count;
+    runRange(*this, range, first, last);
+    while (range->remaining > 0) {
+        if (!runOne()) {
+            std::this_thread::yield();
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Task;
+using TaskHandle = std::shared_ptr<Task>;
+
+// A unit of work plus the tasks waiting on it
+struct Task {
+    std::function<void()> work;
+    std::atomic<int> unfinishedDependencies{0};
+    std::atomic<bool> done{false};
+    std::mutex dependentsMutex;
+    std::vector<TaskHandle> dependents;
+};
+
+// Work-stealing task scheduler shared by the whole program.
+// Every worker owns a deque: it pushes and pops work at the back and idle workers
+// steal from the front, so recently split work stays hot in the owner's cache while
+// large early pieces are the ones that migrate. Threads outside the pool push into
+// an extra shared deque. Waiting threads run queued tasks instead of blocking, so
+// tasks may themselves submit and wait on nested work.
+class TaskScheduler {
+public:
+    // The process-wide instance, sized to the hardware on first use
+    // (or to TASK_THREADS total threads when that is set)
+    static TaskScheduler& instance();
+
+    explicit TaskScheduler(unsigned threadCount);
+    ~TaskScheduler();
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // Worker threads plus the calling thread, which helps while it waits
+    unsigned concurrency() const { return unsigned(workers.size()) + 1; }
+    // Slot of the calling thread in [0, concurrency()), for per-thread scratch buffers.
+    // Threads outside the pool all map to the last slot, so per-slot scratch is only
+    // safe while at most one such thread runs pool work at a time; in this program that
+    // is the main thread, and other threads must not call parallelFor or wait.
+    unsigned currentSlot() const;
+
+    // Queue work that starts once every dependency has finished
+    TaskHandle submit(std::function<void()> work, std::initializer_list<TaskHandle> dependencies = {});
+    // Run other tasks until this one has finished
+    void wait(const TaskHandle& task);
+
+    // Call body(begin, end) over [first, last) in pieces of at most grain items.
+    // The range is split in halves so idle workers steal large pieces first;
+    // grain 0 picks a size giving a few pieces per thread.
+    void parallelFor(size_t first, size_t last, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<TaskHandle> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues; // One per worker, then the shared queue
+    std::atomic<bool> stopping{false};
+    std::atomic<long> queuedCount{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    void workerLoop(unsigned index);
+    void schedule(const TaskHandle& task);
+    void execute(const TaskHandle& task);
+    bool runOne();
+    TaskHandle popLocal(unsigned index);
+    TaskHandle steal(unsigned thief);
+};
+
+#endif
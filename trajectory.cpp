@@ -0,0 +1,827 @@
+#include "trajectory.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char trajectoryMagic[8] = {'N', 'B', 'O', 'D', 'Y', 'T', 'R', 'J'};
+static const char trajectoryIndexMagic[8] = {'T', 'R', 'J', 'I', 'N', 'D', 'E', 'X'};
+
+// Quantized stand-in for values that are not finite or do not fit
+static const std::int64_t missingValue = std::numeric_limits<std::int64_t>::min();
+// Bodies per encode/decode task
+static const size_t codecGrain = 256;
+
+static std::int64_t quantize(double v, double quantum) {
+    double q = v / quantum;
+    if (!(std::fabs(q) < 9.0e18)) {
+        return missingValue;
+    }
+    return std::llround(q);
+}
+
+static double dequantize(std::int64_t q, double quantum) {
+    return q == missingValue ? std::numeric_limits<double>::quiet_NaN() : double(q) * quantum;
+}
+
+static std::uint64_t zigzag(std::uint64_t v) {
+    return (v << 1) ^ (0 - (v >> 63));
+}
+
+static std::uint64_t unzigzag(std::uint64_t v) {
+    return (v >> 1) ^ (0 - (v & 1));
+}
+
+static int bitWidth(std::uint64_t v) {
+    int w = 0;
+    while (v) {
+        ++w;
+        v >>= 1;
+    }
+    return w;
+}
+
+// LSB-first bit packing into a byte vector
+struct BitWriter {
+    std::vector<unsigned char>& out;
+    std::uint64_t buffer = 0;
+    int bits = 0;
+
+    explicit BitWriter(std::vector<unsigned char>& target) : out(target) {}
+
+    void put(std::uint64_t value, int width) {
+        if (width > 32) {
+            put(value & 0xffffffffu, 32);
+            put(value >> 32, width - 32);
+            return;
+        }
+        if (width < 64) {
+            value &= (std::uint64_t(1) << width) - 1;
+        }
+        buffer |= value << bits;
+        bits += width;
+        while (bits >= 8) {
+            out.push_back((unsigned char)buffer);
+            buffer >>= 8;
+            bits -= 8;
+        }
+    }
+
+    void alignToByte() {
+        if (bits > 0) {
+            out.push_back((unsigned char)buffer);
+            buffer = 0;
+            bits = 0;
+        }
+    }
+};
+
+struct BitReader {
+    const unsigned char* p;
+    const unsigned char* end;
+    std::uint64_t buffer = 0;
+    int bits = 0;
+    bool overrun = false;
+
+    BitReader(const unsigned char* begin, const unsigned char* stop) : p(begin), end(stop) {}
+
+    std::uint64_t get(int width) {
+        if (width > 32) {
+            std::uint64_t low = get(32);
+            return low | (get(width - 32) << 32);
+        }
+        while (bits < width) {
+            if (p == end) {
+                overrun = true;
+                return 0;
+            }
+            buffer |= std::uint64_t(*p++) << bits;
+            bits += 8;
+        }
+        std::uint64_t value = width == 0 ? 0 : buffer & ((std::uint64_t(1) << width) - 1);
+        buffer >>= width;
+        bits -= width;
+        return value;
+    }
+};
+
+// Extrapolation of q[t] from up to order previous values (fewer near the start)
+static std::uint64_t predict(const std::uint64_t* q, size_t t, int order) {
+    switch (order < int(t) ? order : int(t)) {
+    case 0: return 0;
+    case 1: return q[t - 1];
+    case 2: return 2 * q[t - 1] - q[t - 2];
+    default: return 3 * q[t - 1] - 3 * q[t - 2] + q[t - 3];
+    }
+}
+
+// Encode one series as residuals from the polynomial predictor (order 0-3) that keeps
+// them narrowest. The first `order` values cannot use the full predictor, so each carries
+// its own width; the rest share one. Unsigned arithmetic wraps, so decoding inverts it
+// exactly even for outliers.
+static void encodeSeries(BitWriter& writer, const std::uint64_t* q, size_t count) {
+    int bestOrder = 0, bestCost = 0;
+    for (int order = 0; order <= 3; ++order) {
+        std::uint64_t widest = 0;
+        int cost = 0;
+        for (size_t t = 0; t < count; ++t) {
+            const std::uint64_t r = zigzag(q[t] - predict(q, t, order));
+            if (int(t) < order) {
+                cost += 7 + bitWidth(r);
+            } else {
+                widest |= r;
+            }
+        }
+        if (size_t(order) < count) {
+            cost += 7 + int(count - order) * bitWidth(widest);
+        }
+        if (order == 0 || cost < bestCost) {
+            bestCost = cost;
+            bestOrder = order;
+        }
+    }
+    writer.put(std::uint64_t(bestOrder), 2);
+    std::uint64_t widest = 0;
+    for (size_t t = 0; t < count; ++t) {
+        const std::uint64_t r = zigzag(q[t] - predict(q, t, bestOrder));
+        if (int(t) < bestOrder) {
+            writer.put(std::uint64_t(bitWidth(r)), 7);
+            writer.put(r, bitWidth(r));
+        } else {
+            widest |= r;
+        }
+    }
+    const int width = bitWidth(widest);
+    writer.put(std::uint64_t(width), 7);
+    for (size_t t = bestOrder; t < count; ++t) {
+        writer.put(zigzag(q[t] - predict(q, t, bestOrder)), width);
+    }
+}
+
+static bool decodeSeries(BitReader& reader, std::uint64_t* q, size_t count) {
+    const int order = int(reader.get(2));
+    for (size_t t = 0; t < count && int(t) < order; ++t) {
+        const int width = int(reader.get(7));
+        if (width > 64) {
+            return false;
+        }
+        q[t] = predict(q, t, order) + unzigzag(reader.get(width));
+    }
+    const int width = int(reader.get(7));
+    if (width > 64) {
+        return false;
+    }
+    for (size_t t = order; t < count; ++t) {
+        q[t] = predict(q, t, order) + unzigzag(reader.get(width));
+    }
+    return !reader.overrun;
+}
+
+std::vector<unsigned char> encodeTrajectoryChunk(const double* times, const double* values, size_t sampleCount,
+                                                 size_t bodyCount, double positionQuantum, double velocityQuantum) {
+    // Bodies are encoded in blocks, each into its own buffer, then concatenated
+    const size_t blockCount = (bodyCount + codecGrain - 1) / codecGrain;
+    std::vector<std::vector<unsigned char>> blocks(blockCount);
+    std::vector<std::uint64_t> offsets(bodyCount + 1, 0);
+    TaskScheduler::instance().parallelFor(0, blockCount, 1, [&](size_t firstBlock, size_t lastBlock) {
+        std::vector<std::uint64_t> q(sampleCount);
+        for (size_t block = firstBlock; block < lastBlock; ++block) {
+            std::vector<unsigned char>& out = blocks[block];
+            BitWriter writer(out);
+            const size_t end = std::min(bodyCount, (block + 1) * codecGrain);
+            for (size_t b = block * codecGrain; b < end; ++b) {
+                offsets[b + 1] = out.size(); // Relative to the block until fixed up below
+                for (int c = 0; c < trajectoryComponents; ++c) {
+                    const double quantum = c < 3 ? positionQuantum : velocityQuantum;
+                    for (size_t t = 0; t < sampleCount; ++t) {
+                        q[t] = std::uint64_t(quantize(values[(t * trajectoryComponents + c) * bodyCount + b], quantum));
+                    }
+                    encodeSeries(writer, q.data(), sampleCount);
+                }
+                writer.alignToByte();
+            }
+        }
+    });
+
+    // offsets[b + 1] holds where body b starts within its block; shift everything down
+    // one slot and add the block bases so offsets[b]..offsets[b + 1] spans body b
+    std::uint64_t base = 0;
+    for (size_t block = 0; block < blockCount; ++block) {
+        const size_t begin = block * codecGrain;
+        const size_t end = std::min(bodyCount, begin + codecGrain);
+        for (size_t b = begin; b < end; ++b) {
+            offsets[b] = base + offsets[b + 1];
+        }
+        base += blocks[block].size();
+    }
+    offsets[bodyCount] = base;
+
+    const size_t timeBytes = sampleCount * sizeof(double);
+    const size_t offsetBytes = offsets.size() * sizeof(std::uint64_t);
+    std::vector<unsigned char> payload(timeBytes + offsetBytes + base);
+    std::memcpy(payload.data(), times, timeBytes);
+    std::memcpy(payload.data() + timeBytes, offsets.data(), offsetBytes);
+    unsigned char* bodyData = payload.data() + timeBytes + offsetBytes;
+    for (const std::vector<unsigned char>& block : blocks) {
+        if (!block.empty()) {
+            std::memcpy(bodyData, block.data(), block.size());
+            bodyData += block.size();
+        }
+    }
+    return payload;
+}
+
+bool decodeTrajectoryChunk(const unsigned char* payload, size_t payloadBytes, size_t sampleCount, size_t bodyCount,
+                           double positionQuantum, double velocityQuantum, TrajectoryChunk& out) {
+    const size_t timeBytes = sampleCount * sizeof(double);
+    const size_t offsetBytes = (bodyCount + 1) * sizeof(std::uint64_t);
+    if (sampleCount == 0 || payloadBytes < timeBytes + offsetBytes) {
+        return false;
+    }
+    std::vector<std::uint64_t> offsets(bodyCount + 1);
+    std::memcpy(offsets.data(), payload + timeBytes, offsetBytes);
+    const unsigned char* bodyData = payload + timeBytes + offsetBytes;
+    const size_t bodyBytes = payloadBytes - timeBytes - offsetBytes;
+    if (offsets[bodyCount] > bodyBytes) {
+        return false;
+    }
+
+    out.bodyCount = bodyCount;
+    out.times.resize(sampleCount);
+    std::memcpy(out.times.data(), payload, timeBytes);
+    out.values.resize(sampleCount * trajectoryComponents * bodyCount);
+    std::atomic<bool> ok{true};
+    TaskScheduler::instance().parallelFor(0, bodyCount, codecGrain, [&](size_t first, size_t last) {
+        std::vector<std::uint64_t> q(sampleCount);
+        for (size_t b = first; b < last; ++b) {
+            if (offsets[b] > offsets[b + 1] || offsets[b + 1] > bodyBytes) {
+                ok = false;
+                return;
+            }
+            BitReader reader(bodyData + offsets[b], bodyData + offsets[b + 1]);
+            for (int c = 0; c < trajectoryComponents; ++c) {
+                if (!decodeSeries(reader, q.data(), sampleCount)) {
+                    ok = false;
+                    return;
+                }
+                const double quantum = c < 3 ? positionQuantum : velocityQuantum;
+                for (size_t t = 0; t < sampleCount; ++t) {
+                    out.values[(t * trajectoryComponents + c) * bodyCount + b] = dequantize(std::int64_t(q[t]), quantum);
+                }
+            }
+        }
+    });
+    return ok;
+}
+
+// Read width bits, LSB first as BitWriter packs them, at a bit position; false past end
+static bool readBits(const unsigned char* data, std::uint64_t end, std::uint64_t& bit, int width, std::uint64_t& value) {
+    if (bit + std::uint64_t(width) > end) {
+        return false;
+    }
+    const std::uint64_t byte = bit >> 3;
+    if (width <= 56 && byte + 8 <= end >> 3) {
+        // One little-endian word covers the value; compilers fold this into a single load
+        const unsigned char* p = data + byte;
+        const std::uint64_t word = std::uint64_t(p[0]) | std::uint64_t(p[1]) << 8 | std::uint64_t(p[2]) << 16 |
+                                   std::uint64_t(p[3]) << 24 | std::uint64_t(p[4]) << 32 | std::uint64_t(p[5]) << 40 |
+                                   std::uint64_t(p[6]) << 48 | std::uint64_t(p[7]) << 56;
+        value = (word >> (bit & 7)) & ((std::uint64_t(1) << width) - 1);
+        bit += std::uint64_t(width);
+        return true;
+    }
+    value = 0;
+    for (int got = 0; got < width;) {
+        const int shift = int(bit & 7);
+        const int take = std::min(8 - shift, width - got);
+        value |= std::uint64_t((data[bit >> 3] >> shift) & ((1u << take) - 1)) << got;
+        got += take;
+        bit += std::uint64_t(take);
+    }
+    return true;
+}
+
+bool TrajectoryChunkCursor::open(const unsigned char* payload, size_t payloadBytes, size_t sampleCount,
+                                 size_t bodyCount, double positionQuantum, double velocityQuantum) {
+    const size_t timeBytes = sampleCount * sizeof(double);
+    const size_t offsetBytes = (bodyCount + 1) * sizeof(std::uint64_t);
+    first = size_t(-1);
+    if (sampleCount == 0 || payloadBytes < timeBytes + offsetBytes) {
+        return false;
+    }
+    bodies = bodyCount;
+    quantum[0] = positionQuantum;
+    quantum[1] = velocityQuantum;
+    times.resize(sampleCount);
+    std::memcpy(times.data(), payload, timeBytes);
+    offsets.resize(bodyCount + 1);
+    std::memcpy(offsets.data(), payload + timeBytes, offsetBytes);
+    bodyData = payload + timeBytes + offsetBytes;
+    bodyBytes = payloadBytes - timeBytes - offsetBytes;
+    series.resize(bodyCount * trajectoryComponents);
+    window.resize(2 * trajectoryComponents * bodyCount);
+    return offsets[bodyCount] <= bodyBytes;
+}
+
+// Locate each of a body's series, in the layout encodeSeries writes: the order, leading
+// values with their own widths, then one shared width and the fixed-width residuals
+bool TrajectoryChunkCursor::rewind(size_t body) {
+    if (offsets[body] > offsets[body + 1] || offsets[body + 1] > bodyBytes) {
+        return false;
+    }
+    const unsigned char* data = bodyData + offsets[body];
+    const std::uint64_t end = (offsets[body + 1] - offsets[body]) * 8;
+    const size_t count = times.size();
+    std::uint64_t bit = 0, value = 0;
+    for (int c = 0; c < trajectoryComponents; ++c) {
+        Series& cursor = series[body * trajectoryComponents + c];
+        if (!readBits(data, end, bit, 2, value)) {
+            return false;
+        }
+        cursor = Series();
+        cursor.order = std::uint8_t(value);
+        cursor.start = std::uint32_t(bit);
+        for (size_t t = 0; t < count && int(t) < cursor.order; ++t) {
+            if (!readBits(data, end, bit, 7, value) || value > 64) {
+                return false;
+            }
+            bit += value;
+        }
+        if (!readBits(data, end, bit, 7, value) || value > 64) {
+            return false;
+        }
+        cursor.width = std::uint8_t(value);
+        cursor.base = std::uint32_t(bit);
+        if (count > cursor.order) {
+            bit += (count - cursor.order) * value;
+        }
+        if (bit > end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Zigzagged residual of value t of a series
+static bool residualAt(const unsigned char* data, std::uint64_t end, std::uint32_t start, std::uint32_t base,
+                       int order, int width, size_t t, std::uint64_t& residual) {
+    if (int(t) >= order) {
+        std::uint64_t bit = base + std::uint64_t(t - order) * std::uint64_t(width);
+        return readBits(data, end, bit, width, residual);
+    }
+    // One of the leading values, each preceded by its width
+    std::uint64_t bit = start, w = 0;
+    for (size_t i = 0;; ++i) {
+        if (!readBits(data, end, bit, 7, w) || w > 64) {
+            return false;
+        }
+        if (i == t) {
+            return readBits(data, end, bit, int(w), residual);
+        }
+        bit += w;
+    }
+}
+
+bool TrajectoryChunkCursor::seek(size_t k) {
+    const size_t count = times.size();
+    if (count == 0) {
+        return false;
+    }
+    k = std::min(k, count - 1);
+    const size_t k1 = std::min(k + 1, count - 1);
+    if (k == first) {
+        return true;
+    }
+    // Leave every cursor about to decode k1 + 1, so its last two values are k and k1.
+    // Walk there from where the cursors are, or from the start when that is closer.
+    const size_t target = k1 + 1;
+    const bool restart = first == size_t(-1) || (target < position && target < position - target);
+    const size_t from = restart ? 0 : position;
+    first = size_t(-1);
+    std::atomic<bool> ok{true};
+    TaskScheduler::instance().parallelFor(0, bodies, codecGrain, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            if (restart && !rewind(b)) {
+                ok = false;
+                return;
+            }
+            const unsigned char* data = bodyData + offsets[b];
+            const std::uint64_t bitEnd = (offsets[b + 1] - offsets[b]) * 8;
+            for (int c = 0; c < trajectoryComponents; ++c) {
+                Series& cursor = series[b * trajectoryComponents + c];
+                const int order = cursor.order;
+                std::uint64_t q1 = cursor.q1, q2 = cursor.q2, q3 = cursor.q3, r = 0;
+                for (size_t t = from; t < target; ++t) {
+                    if (!residualAt(data, bitEnd, cursor.start, cursor.base, order, cursor.width, t, r)) {
+                        ok = false;
+                        return;
+                    }
+                    // predict() over the rolling history
+                    std::uint64_t q;
+                    switch (std::min<size_t>(order, t)) {
+                    case 0: q = 0; break;
+                    case 1: q = q1; break;
+                    case 2: q = 2 * q1 - q2; break;
+                    default: q = 3 * q1 - 3 * q2 + q3; break;
+                    }
+                    q3 = q2;
+                    q2 = q1;
+                    q1 = q + unzigzag(r);
+                }
+                for (size_t t = from; t > target; --t) {
+                    // Value t - 4 is the oldest term in the prediction of value t - 4 + order,
+                    // which the history holds along with the rest of its terms
+                    std::uint64_t oldest = 0;
+                    if (t >= 4) {
+                        if (!residualAt(data, bitEnd, cursor.start, cursor.base, order, cursor.width, t - 4 + order, r)) {
+                            ok = false;
+                            return;
+                        }
+                        const std::uint64_t u = unzigzag(r);
+                        switch (order) {
+                        case 0: oldest = u; break;
+                        case 1: oldest = q3 - u; break;
+                        case 2: oldest = 2 * q3 - q2 + u; break;
+                        default: oldest = q1 - u - 3 * q2 + 3 * q3; break;
+                        }
+                    }
+                    q1 = q2;
+                    q2 = q3;
+                    q3 = oldest;
+                }
+                cursor.q1 = q1;
+                cursor.q2 = q2;
+                cursor.q3 = q3;
+                const double q = quantum[c < 3 ? 0 : 1];
+                window[(trajectoryComponents + c) * bodies + b] = dequantize(std::int64_t(q1), q);
+                window[c * bodies + b] = dequantize(std::int64_t(k1 == k ? q1 : q2), q);
+            }
+        }
+    });
+    position = target;
+    if (ok) {
+        first = k;
+    }
+    return ok;
+}
+
+bool TrajectoryRecorder::open(const char* path, size_t bodyCount) {
+    close();
+    file = std::fopen(path, "wb");
+    if (!file) {
+        std::cerr << "Failed to create trajectory file " << path << std::endl;
+        return false;
+    }
+    if (samplesPerChunk < 2) {
+        samplesPerChunk = 2;
+    }
+    if (ringChunks < 1) {
+        ringChunks = 1;
+    }
+    bodies = bodyCount;
+    slots.clear();
+    for (size_t i = 0; i < ringChunks; ++i) {
+        slots.emplace_back(new Slot());
+        slots.back()->times.resize(samplesPerChunk);
+        slots.back()->values.resize(samplesPerChunk * trajectoryComponents * bodies);
+    }
+    seed.resize(trajectoryComponents * bodies);
+    current = filled = seeded = 0;
+    haveSeed = false;
+    index.clear();
+    recorded = dropped = chunks = raw = written = 0;
+    writeFailed = false;
+
+    TrajectoryFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, trajectoryMagic, sizeof(header.magic));
+    header.version = trajectoryVersion;
+    header.samplesPerChunk = std::uint32_t(samplesPerChunk);
+    header.bodyCount = bodies;
+    header.positionQuantum = positionQuantum;
+    header.velocityQuantum = velocityQuantum;
+    header.epoch = epoch;
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        writeFailed = true;
+    }
+    fileOffset = sizeof(header);
+    return true;
+}
+
+void TrajectoryRecorder::record(double time, const double* x, const double* y, const double* z,
+                                const double* vx, const double* vy, const double* vz) {
+    if (!file) {
+        return;
+    }
+    Slot& slot = *slots[current];
+    if (filled == 0) {
+        // Starting a buffer: it must be free, and it opens with the previous chunk's last sample
+        if (slot.busy) {
+            if (!blocking && TaskScheduler::instance().concurrency() > 1) {
+                ++dropped;
+                return;
+            }
+            // Asked to keep every sample, or nothing else would ever run the encode
+            TaskScheduler::instance().wait(slot.encoding);
+        }
+        if (haveSeed) {
+            slot.times[0] = seedTime;
+            std::memcpy(slot.values.data(), seed.data(), seed.size() * sizeof(double));
+            filled = seeded = 1;
+        }
+    }
+    const double* source[trajectoryComponents] = {x, y, z, vx, vy, vz};
+    double* sample = slot.values.data() + filled * trajectoryComponents * bodies;
+    for (int c = 0; c < trajectoryComponents; ++c) {
+        std::memcpy(sample + c * bodies, source[c], bodies * sizeof(double));
+    }
+    slot.times[filled] = time;
+    ++filled;
+    ++recorded;
+
+    if (filled == samplesPerChunk) {
+        std::memcpy(seed.data(), sample, seed.size() * sizeof(double));
+        seedTime = time;
+        haveSeed = true;
+        submitSlot();
+    }
+}
+
+// Hand the current buffer to an encode task and queue its write after the previous chunk's
+void TrajectoryRecorder::submitSlot() {
+    Slot* slot = slots[current].get();
+    const size_t count = filled;
+    slot->busy = true;
+    raw += (long long)((count - seeded) * trajectoryComponents * bodies * sizeof(double));
+    current = (current + 1) % slots.size();
+    filled = seeded = 0;
+
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    auto payload = std::make_shared<std::vector<unsigned char>>();
+    const size_t n = bodies;
+    const double pq = positionQuantum, vq = velocityQuantum;
+    const double startTime = slot->times[0], endTime = slot->times[count - 1];
+    slot->encoding = scheduler.submit([slot, payload, count, n, pq, vq] {
+        *payload = encodeTrajectoryChunk(slot->times.data(), slot->values.data(), count, n, pq, vq);
+        slot->busy = false;
+    });
+    lastWrite = scheduler.submit([this, payload, count, startTime, endTime] {
+        TrajectoryChunkHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = trajectoryChunkMagic;
+        header.sampleCount = std::uint32_t(count);
+        header.startTime = startTime;
+        header.endTime = endTime;
+        header.payloadBytes = payload->size();
+        if (std::fwrite(&header, sizeof(header), 1, file) != 1 ||
+            std::fwrite(payload->data(), 1, payload->size(), file) != payload->size()) {
+            writeFailed = true;
+            return;
+        }
+        const std::uint64_t bytes = sizeof(header) + payload->size();
+        index.push_back({startTime, endTime, fileOffset, bytes});
+        fileOffset += bytes;
+        written += (long long)bytes;
+        ++chunks;
+    }, {slot->encoding, lastWrite});
+}
+
+void TrajectoryRecorder::close() {
+    if (!file) {
+        return;
+    }
+    if (filled > seeded) {
+        submitSlot();
+    }
+    if (lastWrite) {
+        TaskScheduler::instance().wait(lastWrite);
+        lastWrite = nullptr;
+    }
+    TrajectoryTrailer trailer;
+    std::memset(&trailer, 0, sizeof(trailer));
+    trailer.indexOffset = fileOffset;
+    trailer.chunkCount = index.size();
+    std::memcpy(trailer.magic, trajectoryIndexMagic, sizeof(trailer.magic));
+    if ((!index.empty() && std::fwrite(index.data(), sizeof(TrajectoryIndexEntry), index.size(), file) != index.size()) ||
+        std::fwrite(&trailer, sizeof(trailer), 1, file) != 1) {
+        writeFailed = true;
+    }
+    if (std::fclose(file) != 0) {
+        writeFailed = true;
+    }
+    file = nullptr;
+    if (writeFailed) {
+        std::cerr << "Failed to write trajectory file" << std::endl;
+    }
+}
+
+bool TrajectoryReader::open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open trajectory file " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(TrajectoryFileHeader)) {
+        std::cerr << "Trajectory file " << path << " is truncated" << std::endl;
+        ::close(fd);
+        return false;
+    }
+    void* mapping = ::mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map trajectory file " << path << std::endl;
+        return false;
+    }
+    data = static_cast<const unsigned char*>(mapping);
+    length = size_t(info.st_size);
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, trajectoryMagic, sizeof(header.magic)) != 0 || header.version == 0 ||
+        header.version > trajectoryVersion) {
+        std::cerr << "Trajectory file " << path << " has an unknown format" << std::endl;
+        close();
+        return false;
+    }
+    bodies = size_t(header.bodyCount);
+    if (!readIndex()) {
+        std::cerr << "Trajectory file " << path << " holds no chunks" << std::endl;
+        close();
+        return false;
+    }
+    chunkStarts.resize(index.size());
+    for (size_t i = 0; i < index.size(); ++i) {
+        chunkStarts[i] = index[i].startTime;
+    }
+    // The current chunk, both neighbours and one spare
+    cache.clear();
+    for (size_t i = 0; i < std::max<size_t>(cacheChunks, 3); ++i) {
+        cache.emplace_back(new CacheEntry());
+    }
+    useCounter = 0;
+    lastTime = startTime();
+    decoded = 0;
+    return true;
+}
+
+// Use the trailer's index when the recording was closed, otherwise walk the chunk headers
+bool TrajectoryReader::readIndex() {
+    index.clear();
+    TrajectoryTrailer trailer;
+    if (length >= sizeof(TrajectoryFileHeader) + sizeof(trailer)) {
+        std::memcpy(&trailer, data + length - sizeof(trailer), sizeof(trailer));
+        const std::uint64_t indexEnd = length - sizeof(trailer);
+        if (std::memcmp(trailer.magic, trajectoryIndexMagic, sizeof(trailer.magic)) == 0 &&
+            trailer.indexOffset <= indexEnd &&
+            trailer.chunkCount == (indexEnd - trailer.indexOffset) / sizeof(TrajectoryIndexEntry)) {
+            index.resize(size_t(trailer.chunkCount));
+            if (!index.empty()) {
+                std::memcpy(index.data(), data + trailer.indexOffset, index.size() * sizeof(TrajectoryIndexEntry));
+            }
+            bool valid = true;
+            for (const TrajectoryIndexEntry& entry : index) {
+                valid = valid && entry.offset >= sizeof(TrajectoryFileHeader) && entry.bytes >= sizeof(TrajectoryChunkHeader) &&
+                        entry.offset + entry.bytes <= trailer.indexOffset;
+            }
+            if (valid) {
+                return !index.empty();
+            }
+            index.clear();
+        }
+    }
+
+    size_t offset = sizeof(TrajectoryFileHeader);
+    while (offset + sizeof(TrajectoryChunkHeader) <= length) {
+        TrajectoryChunkHeader chunk;
+        std::memcpy(&chunk, data + offset, sizeof(chunk));
+        if (chunk.magic != trajectoryChunkMagic || chunk.payloadBytes > length - offset - sizeof(chunk)) {
+            break;
+        }
+        const std::uint64_t bytes = sizeof(chunk) + chunk.payloadBytes;
+        index.push_back({chunk.startTime, chunk.endTime, offset, bytes});
+        offset += size_t(bytes);
+    }
+    if (!index.empty()) {
+        std::cerr << "Trajectory file has no index; recovered " << index.size() << " chunks" << std::endl;
+    }
+    return !index.empty();
+}
+
+void TrajectoryReader::close() {
+    for (std::unique_ptr<CacheEntry>& entry : cache) {
+        if (entry->decoding) {
+            TaskScheduler::instance().wait(entry->decoding);
+        }
+    }
+    cache.clear();
+    index.clear();
+    chunkStarts.clear();
+    if (data) {
+        ::munmap(const_cast<unsigned char*>(data), length);
+        data = nullptr;
+        length = 0;
+    }
+}
+
+size_t TrajectoryReader::findChunk(double t) const {
+    size_t k = size_t(std::upper_bound(chunkStarts.begin(), chunkStarts.end(), t) - chunkStarts.begin());
+    return k == 0 ? 0 : k - 1;
+}
+
+const unsigned char* TrajectoryReader::chunkPayload(size_t chunk, TrajectoryChunkHeader& chunkHeader,
+                                                    size_t& payloadBytes) const {
+    std::memcpy(&chunkHeader, data + index[chunk].offset, sizeof(chunkHeader));
+    payloadBytes = size_t(std::min<std::uint64_t>(chunkHeader.payloadBytes, index[chunk].bytes - sizeof(chunkHeader)));
+    return data + index[chunk].offset + sizeof(chunkHeader);
+}
+
+TrajectoryReader::CacheEntry& TrajectoryReader::request(size_t chunk, Seek seek) {
+    CacheEntry* victim = nullptr;
+    for (std::unique_ptr<CacheEntry>& entry : cache) {
+        if (entry->chunk == chunk) {
+            entry->lastUse = ++useCounter;
+            return *entry;
+        }
+        if (!victim || entry->lastUse < victim->lastUse) {
+            victim = entry.get();
+        }
+    }
+    if (victim->decoding) {
+        TaskScheduler::instance().wait(victim->decoding);
+    }
+    victim->chunk = chunk;
+    victim->lastUse = ++useCounter;
+    victim->ok = false;
+
+    TrajectoryChunkHeader chunkHeader;
+    size_t payloadBytes = 0;
+    const unsigned char* payload = chunkPayload(chunk, chunkHeader, payloadBytes);
+    const size_t samples = chunkHeader.sampleCount;
+    const size_t n = bodies;
+    const double pq = header.positionQuantum, vq = header.velocityQuantum;
+    // The last interval starts one sample before the end
+    const size_t sample = seek == SeekLast ? (samples > 1 ? samples - 2 : 0) : 0;
+    victim->decoding = TaskScheduler::instance().submit([this, victim, payload, payloadBytes, samples, n, pq, vq, seek, sample] {
+        victim->ok = victim->cursor.open(payload, payloadBytes, samples, n, pq, vq) &&
+                     (seek == SeekNone || victim->cursor.seek(sample));
+        ++decoded;
+    });
+    return *victim;
+}
+
+bool TrajectoryReader::positionsAt(double t, double* x, double* y, double* z) {
+    if (index.empty()) {
+        return false;
+    }
+    t = std::min(std::max(t, startTime()), endTime());
+    const size_t chunk = findChunk(t);
+    CacheEntry& entry = request(chunk, SeekNone);
+    TaskScheduler::instance().wait(entry.decoding);
+    TrajectoryChunkCursor& samples = entry.cursor;
+    const std::vector<double>& times = samples.sampleTimes();
+    const size_t count = times.size();
+    size_t k = entry.ok ? size_t(std::upper_bound(times.begin(), times.end(), t) - times.begin()) : 0;
+    k = k == 0 ? 0 : std::min(k - 1, count > 1 ? count - 2 : 0);
+    const bool ok = entry.ok && samples.seek(k);
+    // Ready the next chunk in the direction of play in the background, at the interval
+    // playback will enter it by; queued only now so a seek does not compete with it
+    if (t >= lastTime && chunk + 1 < index.size()) {
+        request(chunk + 1, SeekFirst);
+    } else if (t < lastTime && chunk > 0) {
+        request(chunk - 1, SeekLast);
+    }
+    lastTime = t;
+    if (!ok) {
+        std::cerr << "Corrupt trajectory chunk " << chunk << std::endl;
+        return false;
+    }
+
+    const size_t k1 = count > 1 ? k + 1 : k;
+    const double h = times[k1] - times[k];
+    const double s = h > 0.0 ? (t - times[k]) / h : 0.0;
+    // Cubic Hermite basis
+    const double s2 = s * s, s3 = s2 * s;
+    const double h00 = 2.0 * s3 - 3.0 * s2 + 1.0;
+    const double h10 = (s3 - 2.0 * s2 + s) * h;
+    const double h01 = -2.0 * s3 + 3.0 * s2;
+    const double h11 = (s3 - s2) * h;
+    double* out[3] = {x, y, z};
+    TaskScheduler::instance().parallelFor(0, bodies, 4096, [&](size_t first, size_t last) {
+        for (int c = 0; c < 3; ++c) {
+            const double* p0 = samples.component(0, c);
+            const double* p1 = samples.component(1, c);
+            const double* v0 = samples.component(0, c + 3);
+            const double* v1 = samples.component(1, c + 3);
+            double* o = out[c];
+            for (size_t i = first; i < last; ++i) {
+                o[i] = h00 * p0[i] + h10 * v0[i] + h01 * p1[i] + h11 * v1[i];
+            }
+        }
+    });
+    return true;
+}
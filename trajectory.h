@@ -0,0 +1,255 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "nbody.h"
+#include "task_scheduler.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Compressed trajectory files.
+//
+// A file is a header, a sequence of chunks and, once closed, a time index followed by a
+// fixed-size trailer. Each chunk holds samplesPerChunk consecutive samples of every
+// body's position and velocity; its first sample repeats the last one of the previous
+// chunk, so any time inside a chunk can be interpolated from that chunk alone.
+//
+// Inside a chunk every (body, component) series is quantized to an integer multiple of
+// its quantum and predicted from its previous values by whichever polynomial
+// extrapolation (order 0 to 3) fits it best; the zigzagged residuals are bit-packed at
+// the width of the largest one. For smooth orbits the residuals are a small fraction
+// of the raw values. Bodies are byte-aligned with an offset table, so chunks encode
+// and decode in parallel. Non-finite values round-trip as NaN.
+struct TrajectoryFileHeader {
+    char magic[8];                // "NBODYTRJ"
+    std::uint32_t version;
+    std::uint32_t samplesPerChunk;
+    std::uint64_t bodyCount;
+    double positionQuantum;
+    double velocityQuantum;
+    double epoch;                 // Caller-defined origin of the time axis, e.g. a Julian date
+};
+
+struct TrajectoryChunkHeader {
+    std::uint32_t magic;          // trajectoryChunkMagic
+    std::uint32_t sampleCount;
+    double startTime, endTime;
+    std::uint64_t payloadBytes;   // Sample times, body offsets and packed bodies
+};
+
+struct TrajectoryIndexEntry {
+    double startTime, endTime;
+    std::uint64_t offset;         // File offset of the chunk header
+    std::uint64_t bytes;          // Header plus payload
+};
+
+struct TrajectoryTrailer {
+    std::uint64_t indexOffset;
+    std::uint64_t chunkCount;
+    char magic[8];                // "TRJINDEX"
+};
+
+const std::uint32_t trajectoryVersion = 1;
+const std::uint32_t trajectoryChunkMagic = 0x4b484354; // "TCHK"
+const int trajectoryComponents = 6;                     // x, y, z, vx, vy, vz
+
+// Samples of every body, laid out [sample][component][body]
+struct TrajectoryChunk {
+    size_t bodyCount = 0;
+    std::vector<double> times;
+    std::vector<double> values;
+
+    size_t sampleCount() const { return times.size(); }
+    const double* component(size_t sample, int c) const {
+        return values.data() + (sample * trajectoryComponents + c) * bodyCount;
+    }
+};
+
+// Encode sampleCount samples laid out as in TrajectoryChunk into a chunk's payload
+std::vector<unsigned char> encodeTrajectoryChunk(const double* times, const double* values, size_t sampleCount,
+                                                 size_t bodyCount, double positionQuantum, double velocityQuantum);
+
+// Decode a chunk payload; returns false if it is malformed
+bool decodeTrajectoryChunk(const unsigned char* payload, size_t payloadBytes, size_t sampleCount, size_t bodyCount,
+                           double positionQuantum, double velocityQuantum, TrajectoryChunk& out);
+
+// Steps through one chunk keeping only two consecutive samples decoded.
+// Every (body, component) series has a cursor holding its last three values, enough to
+// predict the next one. Past the first few values residuals have a fixed width, so each
+// can be read directly and the prediction inverted, and the cursor moves a sample either
+// way for one residual per series. A distant sample is reached from the cursor or from
+// the chunk's start, whichever is closer. Memory is a few hundred bytes per body however
+// many samples the chunk holds.
+class TrajectoryChunkCursor {
+public:
+    // Index a chunk payload: copies the sample times and body offsets, decodes nothing yet
+    bool open(const unsigned char* payload, size_t payloadBytes, size_t sampleCount, size_t bodyCount,
+              double positionQuantum, double velocityQuantum);
+    // Decode samples k and k + 1 (k twice when it is the last); false if the chunk is malformed
+    bool seek(size_t k);
+
+    size_t sampleCount() const { return times.size(); }
+    const std::vector<double>& sampleTimes() const { return times; }
+    // After seek(k), component c of sample k (next = 0) or k + 1 (next = 1)
+    const double* component(int next, int c) const {
+        return window.data() + (next * trajectoryComponents + c) * bodies;
+    }
+
+private:
+    struct Series {
+        std::uint64_t q1 = 0, q2 = 0, q3 = 0; // Values t - 1, t - 2 and t - 3
+        std::uint32_t start = 0;              // Bit after the order field, from the start of the body
+        std::uint32_t base = 0;               // Bit of the first fixed-width residual
+        std::uint8_t order = 0, width = 0;
+    };
+
+    const unsigned char* bodyData = nullptr;
+    size_t bodyBytes = 0;
+    size_t bodies = 0;
+    double quantum[2] = {0.0, 0.0};  // Positions, velocities
+    std::vector<double> times;
+    std::vector<std::uint64_t> offsets;
+    std::vector<Series> series;      // [body][component]
+    std::vector<double> window;      // [sample k, k + 1][component][body]
+    size_t position = 0;             // Value every cursor decodes next
+    size_t first = size_t(-1);       // Sample in the window's first slot; -1 before any seek
+
+    bool rewind(size_t body);
+};
+
+// Records body states into a compressed trajectory file without stalling the caller.
+// record() copies a sample into a ring of chunk buffers; each full buffer is encoded
+// on the task scheduler and appended to the file by a write task chained after the
+// previous one, so chunks land in order while several encode at once. When every
+// buffer is still waiting to be encoded, samples are dropped and counted rather than
+// blocking the simulation, unless blocking is set: then record() waits (helping with the
+// encodes) so no sample is lost, for offline recording with no simulation to protect. A
+// scheduler without workers always makes record() encode.
+class TrajectoryRecorder {
+public:
+    double positionQuantum = 1.0e-6; // Absolute resolution of stored positions
+    double velocityQuantum = 1.0e-9;
+    size_t samplesPerChunk = 64;
+    size_t ringChunks = 4;           // Chunk buffers that can be in flight at once
+    bool blocking = false;           // Wait for a free buffer instead of dropping samples
+    double epoch = 0.0;
+
+    ~TrajectoryRecorder() { close(); }
+
+    bool open(const char* path, size_t bodyCount);
+    // Append a sample; times must increase
+    void record(double time, const double* x, const double* y, const double* z,
+                const double* vx, const double* vy, const double* vz);
+    void record(const BodySystem& s) {
+        record(s.time, s.x.data(), s.y.data(), s.z.data(), s.vx.data(), s.vy.data(), s.vz.data());
+    }
+    // Write out the partial chunk, the time index and the trailer
+    void close();
+
+    long long samplesRecorded() const { return recorded; }
+    long long samplesDropped() const { return dropped; }
+    long long chunksWritten() const { return chunks; }
+    long long rawBytes() const { return raw; }           // Samples as doubles
+    long long compressedBytes() const { return written; } // Chunk bytes written to disk
+    bool failed() const { return writeFailed; }
+
+private:
+    struct Slot {
+        std::vector<double> times;
+        std::vector<double> values;
+        std::atomic<bool> busy{false}; // Handed to an encode task
+        TaskHandle encoding;
+    };
+
+    std::FILE* file = nullptr;
+    size_t bodies = 0;
+    std::vector<std::unique_ptr<Slot>> slots;
+    size_t current = 0;      // Slot being filled
+    size_t filled = 0;       // Samples in the current slot
+    size_t seeded = 0;       // Of those, 1 if the slot starts with the previous chunk's last sample
+    bool haveSeed = false;   // The previous chunk's last sample is waiting to start the next
+    std::vector<double> seed;
+    double seedTime = 0.0;
+    std::uint64_t fileOffset = 0;
+    std::vector<TrajectoryIndexEntry> index;
+    TaskHandle lastWrite;
+    std::atomic<long long> recorded{0}, dropped{0}, chunks{0}, raw{0}, written{0};
+    std::atomic<bool> writeFailed{false};
+
+    void submitSlot();
+};
+
+// Random-access playback of a trajectory file.
+// The file is memory-mapped; seeking binary-searches the chunk time index (rebuilt by
+// scanning chunk headers if the recording was never closed), so any time is found in
+// O(log chunks). Chunks near the playhead get a TrajectoryChunkCursor in a small cache,
+// which decodes only as far as the samples around the playhead: playing either way costs
+// a few residuals per body per sample, and no whole chunk is ever held decoded. The
+// neighbour in the direction of play is opened and positioned ahead on the task
+// scheduler. Positions between samples come from cubic Hermite interpolation of the
+// stored positions and velocities, which matches the recorded state and its derivative
+// at every sample.
+class TrajectoryReader {
+public:
+    size_t cacheChunks = 4;
+
+    TrajectoryReader() = default;
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+    ~TrajectoryReader() { close(); }
+
+    bool open(const char* path);
+    void close();
+
+    size_t bodyCount() const { return bodies; }
+    size_t chunkCount() const { return index.size(); }
+    double epoch() const { return header.epoch; }
+    double positionQuantum() const { return header.positionQuantum; }
+    double velocityQuantum() const { return header.velocityQuantum; }
+    double startTime() const { return index.empty() ? 0.0 : index.front().startTime; }
+    double endTime() const { return index.empty() ? 0.0 : index.back().endTime; }
+
+    // Chunk covering time t, clamped to the recording
+    size_t findChunk(double t) const;
+
+    // Positions of every body at time t (clamped to the recording); bodies that were
+    // not finite when recorded come out as NaN. Returns false if a chunk is corrupt.
+    bool positionsAt(double t, double* x, double* y, double* z);
+
+    long long chunksDecoded() const { return decoded; }
+
+    // A chunk's header and its payload in the mapping, for callers decoding it themselves
+    const unsigned char* chunkPayload(size_t chunk, TrajectoryChunkHeader& chunkHeader, size_t& payloadBytes) const;
+
+private:
+    struct CacheEntry {
+        size_t chunk = size_t(-1);
+        unsigned long long lastUse = 0;
+        TaskHandle decoding;
+        std::atomic<bool> ok{false};
+        TrajectoryChunkCursor cursor;
+    };
+
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+    TrajectoryFileHeader header = {};
+    size_t bodies = 0;
+    std::vector<TrajectoryIndexEntry> index;
+    std::vector<double> chunkStarts; // index[i].startTime, for the binary search
+    std::vector<std::unique_ptr<CacheEntry>> cache;
+    unsigned long long useCounter = 0;
+    double lastTime = 0.0;
+    std::atomic<long long> decoded{0};
+
+    // Where request() leaves a newly opened chunk's cursor
+    enum Seek { SeekNone, SeekFirst, SeekLast };
+
+    bool readIndex();
+    // Cache entry holding the chunk, opening it on the scheduler if needed and then
+    // seeking to its first or last interval, or leaving that to the caller
+    CacheEntry& request(size_t chunk, Seek seek);
+};
+
+#endif